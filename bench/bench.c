@@ -0,0 +1,260 @@
+#include <float.h>
+#include <time.h>
+
+#include "binary.h"
+#include "corpus.h"
+#include "parser.h"
+#include "tokenizer.h"
+
+/*
+  Times tokenizing, parsing and converting to JSON separately, on a
+  generated corpus of every shape or on the given files:
+
+    bench [-n runs] [-s megabytes] [-j jobs] [-o results.json] [--label text] [file.sdf...]
+
+  Each stage keeps its fastest run. Throughput is input bytes per second
+  for every stage and time per token counts the tokens of the input, so
+  stages and commits compare directly. -o also writes the results as
+  JSON. Build it from bench.c, corpus.c and the sources in src other
+  than main.c and the ones that need it (batch.c, cache.c and stats.c):
+
+    gcc -std=gnu11 -O2 -pthread -Isrc -o sdf-bench bench/bench.c bench/corpus.c \
+      $(ls src/[a-z]*.c | grep -v 'main\|batch\|cache\|stats')
+*/
+
+#define BENCH_DEFAULT_RUNS 5
+#define BENCH_DEFAULT_SIZE 8
+#define BENCH_SEED 1
+
+enum BenchStage {
+  BS_TOKENIZE,
+  BS_PARSE,
+  BS_TO_STRING,
+  BS_TO_MSGPACK,
+  BS_TO_CBOR,
+  BS_COUNT,
+};
+
+static const char *BENCH_STAGE_NAMES[BS_COUNT] = {
+  [BS_TOKENIZE] = "tokenize",
+  [BS_PARSE] = "parse",
+  [BS_TO_STRING] = "to_string",
+  [BS_TO_MSGPACK] = "to_msgpack",
+  [BS_TO_CBOR] = "to_cbor",
+};
+
+struct BenchResult {
+  char *input;
+  enum BenchStage stage;
+  size_t bytes, tokens;
+  double seconds;
+};
+
+struct BenchOptions {
+  int runs, jobs;
+  size_t size;
+  const char *output, *label;
+};
+
+static inline double BenchNow(void) {
+  struct timespec t;
+#ifndef _WIN32
+  clock_gettime(CLOCK_MONOTONIC, &t);
+#else
+  timespec_get(&t, TIME_UTC);
+#endif
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static inline size_t BenchTokenize(char *data, size_t length) {
+  struct TokenIterator ti = CreateBufferTokenIterator(data, length);
+  struct Token t;
+  size_t tokens = 0;
+  while (GetNextToken(&ti, &t)) {
+    tokens++;
+  }
+  return tokens;
+}
+
+static inline struct SDF_Object BenchParse(char *data, size_t length, int jobs, struct Arena *a) {
+  struct TokenIterator ti = CreateBufferTokenIterator(data, length);
+  ti.jobs = jobs;
+  return ParseObject(&ti, a);
+}
+
+// Runs every stage on one input and appends a result per stage
+static void BenchInput(char *name, char *data, size_t length, struct BenchOptions *options, struct BenchResult *results) {
+  size_t tokens = 0;
+  double best[BS_COUNT];
+  for (int i = 0; i < BS_COUNT; i++) {
+    best[i] = DBL_MAX;
+  }
+
+  for (int run = 0; run < options->runs; run++) {
+    double start = BenchNow();
+    tokens = BenchTokenize(data, length);
+    double stop = BenchNow();
+    if (stop - start < best[BS_TOKENIZE]) {
+      best[BS_TOKENIZE] = stop - start;
+    }
+  }
+
+  struct Arena a;
+  struct SDF_Object o;
+  for (int run = 0; run < options->runs; run++) {
+    if (run > 0) {
+      FreeArena(&a);
+    }
+    a = CreateArena();
+    double start = BenchNow();
+    o = BenchParse(data, length, options->jobs, &a);
+    double stop = BenchNow();
+    if (stop - start < best[BS_PARSE]) {
+      best[BS_PARSE] = stop - start;
+    }
+  }
+
+  // The tree is written out once per output format
+  for (int stage = BS_TO_STRING; stage < BS_COUNT; stage++) {
+    for (int run = 0; run < options->runs; run++) {
+      struct StringBuilder sb = CreateStringBuilder();
+      double start = BenchNow();
+      if (stage == BS_TO_STRING) {
+        SDFObjectToString(&o, &sb);
+      }
+      else {
+        SDFObjectToBinary(&o, &sb, stage == BS_TO_MSGPACK ? OF_MSGPACK : OF_CBOR);
+      }
+      double stop = BenchNow();
+      if (stop - start < best[stage]) {
+        best[stage] = stop - start;
+      }
+      free(sb.string);
+    }
+  }
+  FreeArena(&a);
+
+  for (int i = 0; i < BS_COUNT; i++) {
+    results[i] = (struct BenchResult) {
+      .input = name,
+      .stage = i,
+      .bytes = length,
+      .tokens = tokens,
+      .seconds = best[i],
+    };
+    printf("%-12s %-10s %10.1f MB/s %10.2f ns/token\n", name, BENCH_STAGE_NAMES[i],
+      length / best[i] * 1e-6, best[i] * 1e9 / (tokens > 0 ? tokens : 1));
+  }
+}
+
+static void BenchWriteString(FILE *f, const char *s) {
+  fputc('"', f);
+  for (; *s != '\0'; s++) {
+    if (*s == '"' || *s == '\\') {
+      fprintf(f, "\\%c", *s);
+    }
+    else if ((unsigned char)*s < 0x20) {
+      fprintf(f, "\\u%04x", *s);
+    }
+    else {
+      fputc(*s, f);
+    }
+  }
+  fputc('"', f);
+}
+
+static int BenchWriteResults(struct BenchOptions *options, struct BenchResult *results, size_t count) {
+  FILE *f = fopen(options->output, "wb");
+  if (f == NULL) {
+    fprintf(stderr, "Error! Failed to open file: %s\n", options->output);
+    return 0;
+  }
+  fprintf(f, "{\n  \"label\": ");
+  BenchWriteString(f, options->label);
+  fprintf(f, ",\n  \"runs\": %d,\n  \"jobs\": %d,\n  \"results\": [\n", options->runs, options->jobs);
+  for (size_t i = 0; i < count; i++) {
+    struct BenchResult *r = &(results[i]);
+    fprintf(f, "    {\"input\": ");
+    BenchWriteString(f, r->input);
+    fprintf(f, ", \"stage\": \"%s\", \"bytes\": %zu, \"tokens\": %zu, \"seconds\": %.9f, \"mb_per_s\": %.3f, \"ns_per_token\": %.3f}%s\n",
+      BENCH_STAGE_NAMES[r->stage], r->bytes, r->tokens, r->seconds,
+      r->bytes / r->seconds * 1e-6, r->seconds * 1e9 / (r->tokens > 0 ? r->tokens : 1),
+      i + 1 < count ? "," : "");
+  }
+  fprintf(f, "  ]\n}\n");
+  fclose(f);
+  return 1;
+}
+
+int main(int argc, char **argv) {
+  struct BenchOptions options = {
+    .runs = BENCH_DEFAULT_RUNS,
+    .jobs = 1,
+    .size = BENCH_DEFAULT_SIZE,
+    .label = "",
+  };
+  char **paths = malloc(sizeof(char*) * argc);
+  size_t count = 0;
+  for (int i = 1; i < argc; i++) {
+    if (i + 1 < argc && strcmp(argv[i], "-n") == 0) {
+      options.runs = atoi(argv[++i]);
+    }
+    else if (i + 1 < argc && strcmp(argv[i], "-s") == 0) {
+      options.size = strtoull(argv[++i], NULL, 10);
+    }
+    else if (i + 1 < argc && strcmp(argv[i], "-j") == 0) {
+      options.jobs = atoi(argv[++i]);
+    }
+    else if (i + 1 < argc && strcmp(argv[i], "-o") == 0) {
+      options.output = argv[++i];
+    }
+    else if (i + 1 < argc && strcmp(argv[i], "--label") == 0) {
+      options.label = argv[++i];
+    }
+    else if (argv[i][0] == '-') {
+      fprintf(stderr, "Usage: %s [-n runs] [-s megabytes] [-j jobs] [-o results.json] [--label text] [file.sdf...]\n", argv[0]);
+      free(paths);
+      return 1;
+    }
+    else {
+      paths[count++] = argv[i];
+    }
+  }
+  if (options.runs < 1) {
+    options.runs = 1;
+  }
+
+  // Like the command line, every parse reuses the scratch buffers of the one before
+  struct SDF_ParserContext context = CreateSDFParserContext();
+  UseSDFParserContext(&context);
+  size_t inputs = count > 0 ? count : CS_COUNT;
+  struct BenchResult *results = malloc(sizeof(struct BenchResult) * inputs * BS_COUNT);
+  if (count > 0) {
+    for (size_t i = 0; i < count; i++) {
+      struct FileBuffer fb;
+      if (!OpenFileBuffer(paths[i], &fb)) {
+        fprintf(stderr, "Error! Failed to open file: %s\n", paths[i]);
+        return 1;
+      }
+      char *name = strrchr(paths[i], '/');
+      BenchInput(name != NULL ? name + 1 : paths[i], fb.data, fb.length, &options, &(results[i * BS_COUNT]));
+      CloseFileBuffer(&fb);
+    }
+  }
+  else {
+    struct StringBuilder sb = CreateStringBuilder();
+    for (int shape = 0; shape < CS_COUNT; shape++) {
+      StringBuilderClear(&sb);
+      GenerateCorpus(shape, options.size << 20, BENCH_SEED, &sb);
+      BenchInput((char*)CORPUS_SHAPE_NAMES[shape], sb.string, sb.length, &options, &(results[shape * BS_COUNT]));
+    }
+    free(sb.string);
+  }
+
+  int ok = options.output == NULL || BenchWriteResults(&options, results, inputs * BS_COUNT);
+  UseSDFParserContext(NULL);
+  FreeSDFParserContext(&context);
+  free(results);
+  free(paths);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,202 @@
+#include <stdarg.h>
+
+#include "corpus.h"
+
+const char *CORPUS_SHAPE_NAMES[CS_COUNT] = {
+  [CS_FLAT] = "flat",
+  [CS_DEEP] = "deep",
+  [CS_LIST] = "list",
+  [CS_OBJECTS] = "objects",
+  [CS_SCHEMA] = "schema",
+  [CS_STRINGS] = "strings",
+  [CS_NUMBERS] = "numbers",
+};
+
+static const char *CORPUS_WORDS[] = {
+  "alpha", "bravo", "charlie", "delta", "echo", "foxtrot", "golf", "hotel",
+  "india", "juliett", "kilo", "lima", "mike", "november", "oscar", "papa",
+};
+
+#define CORPUS_WORD_COUNT (sizeof(CORPUS_WORDS) / sizeof(CORPUS_WORDS[0]))
+
+inline int CorpusShapeFromName(const char *name) {
+  for (int i = 0; i < CS_COUNT; i++) {
+    if (strcmp(name, CORPUS_SHAPE_NAMES[i]) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// splitmix64
+static inline uint64_t CorpusRandom(uint64_t *state) {
+  uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+__attribute__((format(printf, 2, 3)))
+static inline void CorpusAddFormat(struct StringBuilder *sb, const char *format, ...) {
+  char buffer[128];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+  StringBuilderAddString(sb, buffer);
+}
+
+static inline void CorpusAddWord(struct StringBuilder *sb, uint64_t *state) {
+  StringBuilderAddString(sb, (char*)CORPUS_WORDS[CorpusRandom(state) % CORPUS_WORD_COUNT]);
+}
+
+static inline void CorpusAddInteger(struct StringBuilder *sb, uint64_t *state, uint64_t limit) {
+  CorpusAddFormat(sb, "%" PRIu64, CorpusRandom(state) % limit);
+}
+
+static inline void CorpusAddDecimal(struct StringBuilder *sb, uint64_t *state) {
+  uint64_t r = CorpusRandom(state);
+  CorpusAddFormat(sb, "%" PRIu64 ".%03" PRIu64, (r >> 10) % 100000, r % 1000);
+}
+
+// A word, a couple of words, an integer or a decimal
+static inline void CorpusAddScalar(struct StringBuilder *sb, uint64_t *state) {
+  switch (CorpusRandom(state) % 4) {
+    case 0:
+      CorpusAddWord(sb, state);
+      break;
+    case 1:
+      CorpusAddWord(sb, state);
+      StringBuilderAddChar(sb, ' ');
+      CorpusAddWord(sb, state);
+      break;
+    case 2:
+      CorpusAddInteger(sb, state, 1000000);
+      break;
+    default:
+      CorpusAddDecimal(sb, state);
+  }
+}
+
+static inline void CorpusAddIndent(struct StringBuilder *sb, size_t depth) {
+  for (size_t i = 0; i < depth; i++) {
+    StringBuilderAddString(sb, "  ");
+  }
+}
+
+static inline void CorpusAddEntry(enum SDF_CorpusShape shape, size_t n, uint64_t *state, struct StringBuilder *sb) {
+  switch (shape) {
+    case CS_FLAT:
+      CorpusAddFormat(sb, "key%zu = ", n);
+      CorpusAddScalar(sb, state);
+      StringBuilderAddChar(sb, '\n');
+      break;
+
+    case CS_DEEP:
+      CorpusAddFormat(sb, "chain%zu {\n", n);
+      for (size_t d = 1; d <= CORPUS_DEEP_DEPTH; d++) {
+        CorpusAddIndent(sb, d);
+        CorpusAddFormat(sb, "id = %zu\n", d);
+        CorpusAddIndent(sb, d);
+        StringBuilderAddString(sb, "name = ");
+        CorpusAddWord(sb, state);
+        StringBuilderAddChar(sb, '\n');
+        CorpusAddIndent(sb, d);
+        CorpusAddFormat(sb, "level%zu {\n", d);
+      }
+      for (size_t d = CORPUS_DEEP_DEPTH + 1; d > 0; d--) {
+        CorpusAddIndent(sb, d - 1);
+        StringBuilderAddString(sb, "}\n");
+      }
+      break;
+
+    case CS_LIST:
+      CorpusAddFormat(sb, "list%zu [\n", n);
+      for (size_t i = 0; i < CORPUS_LIST_LENGTH; i++) {
+        StringBuilderAddString(sb, "  ");
+        CorpusAddScalar(sb, state);
+        StringBuilderAddChar(sb, '\n');
+      }
+      StringBuilderAddString(sb, "]\n");
+      break;
+
+    case CS_OBJECTS:
+      CorpusAddFormat(sb, "people%zu [\n", n);
+      for (size_t i = 0; i < CORPUS_LIST_LENGTH; i++) {
+        StringBuilderAddString(sb, "  {name = ");
+        CorpusAddWord(sb, state);
+        StringBuilderAddString(sb, "; age = ");
+        CorpusAddInteger(sb, state, 100);
+        StringBuilderAddString(sb, "; city = ");
+        CorpusAddWord(sb, state);
+        StringBuilderAddString(sb, "}\n");
+      }
+      StringBuilderAddString(sb, "]\n");
+      break;
+
+    case CS_SCHEMA:
+      CorpusAddFormat(sb, "people%zu (name; age; city; score) [\n", n);
+      for (size_t i = 0; i < CORPUS_LIST_LENGTH; i++) {
+        StringBuilderAddString(sb, "  ");
+        CorpusAddWord(sb, state);
+        StringBuilderAddString(sb, "; ");
+        CorpusAddInteger(sb, state, 100);
+        StringBuilderAddString(sb, "; ");
+        CorpusAddWord(sb, state);
+        StringBuilderAddString(sb, "; ");
+        CorpusAddDecimal(sb, state);
+        StringBuilderAddChar(sb, '\n');
+      }
+      StringBuilderAddString(sb, "]\n");
+      break;
+
+    case CS_STRINGS: {
+      CorpusAddFormat(sb, "text%zu = \"", n);
+      size_t words = 30 + CorpusRandom(state) % 300;
+      for (size_t i = 0; i < words; i++) {
+        switch (CorpusRandom(state) % 16) {
+          case 0:
+            StringBuilderAddString(sb, "\\\"");
+            break;
+          case 1:
+            StringBuilderAddString(sb, "\\\\");
+            break;
+          case 2:
+            StringBuilderAddString(sb, "\\n");
+            break;
+        }
+        CorpusAddWord(sb, state);
+        StringBuilderAddChar(sb, ' ');
+      }
+      StringBuilderAddString(sb, "\"\n");
+      break;
+    }
+
+    case CS_NUMBERS:
+      CorpusAddFormat(sb, "samples%zu (id; x; y; z; count) [\n", n);
+      for (size_t i = 0; i < CORPUS_LIST_LENGTH; i++) {
+        CorpusAddFormat(sb, "  %zu; ", i);
+        CorpusAddDecimal(sb, state);
+        StringBuilderAddString(sb, "; ");
+        CorpusAddDecimal(sb, state);
+        StringBuilderAddString(sb, "; ");
+        CorpusAddDecimal(sb, state);
+        StringBuilderAddString(sb, "; ");
+        CorpusAddInteger(sb, state, UINT64_C(10000000000));
+        StringBuilderAddChar(sb, '\n');
+      }
+      StringBuilderAddString(sb, "]\n");
+      break;
+
+    default:
+      FatalLog("Unknown corpus shape %d", shape);
+  }
+}
+
+inline void GenerateCorpus(enum SDF_CorpusShape shape, size_t size, uint64_t seed, struct StringBuilder *sb) {
+  uint64_t state = seed;
+  size_t target = sb->length + size;
+  for (size_t n = 0; sb->length < target; n++) {
+    CorpusAddEntry(shape, n, &state, sb);
+  }
+}
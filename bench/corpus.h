@@ -0,0 +1,40 @@
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include "util.h"
+
+// Depth of each nested chain in the deep shape, well inside the recursion limits
+#define CORPUS_DEEP_DEPTH 32
+// Items in each list of the list shapes
+#define CORPUS_LIST_LENGTH 1000
+
+/*
+  Synthetic documents, one per shape the grammar supports:
+
+    flat     top-level `key = value` pairs
+    deep     chains of objects nested CORPUS_DEEP_DEPTH levels
+    list     lists of words and numbers
+    objects  lists of `{name = ...; age = ...}` objects
+    schema   schema lists of mixed text and numbers
+    strings  long quoted strings with escapes
+    numbers  schema lists of integers and decimals only
+*/
+enum SDF_CorpusShape {
+  CS_FLAT,
+  CS_DEEP,
+  CS_LIST,
+  CS_OBJECTS,
+  CS_SCHEMA,
+  CS_STRINGS,
+  CS_NUMBERS,
+  CS_COUNT,
+};
+
+extern const char *CORPUS_SHAPE_NAMES[CS_COUNT];
+
+// Returns -1 for an unknown name
+int CorpusShapeFromName(const char *name);
+// Appends whole entries to an in-memory sb until it grew by size bytes. Same seed, same text
+void GenerateCorpus(enum SDF_CorpusShape shape, size_t size, uint64_t seed, struct StringBuilder *sb);
+
+#endif
@@ -0,0 +1,38 @@
+#include "corpus.h"
+
+/*
+  Writes a corpus file per shape into a directory:
+
+    generate <directory> [megabytes] [seed]
+
+  Built from the repository root with
+
+    gcc -std=gnu11 -O2 -Isrc -o sdf-generate bench/generate.c bench/corpus.c src/util.c
+*/
+int main(int argc, char **argv) {
+  if (argc < 2 || argc > 4) {
+    fprintf(stderr, "Usage: %s <directory> [megabytes] [seed]\n", argv[0]);
+    return 1;
+  }
+  size_t size = (argc > 2 ? strtoull(argv[2], NULL, 10) : 16) << 20;
+  uint64_t seed = argc > 3 ? strtoull(argv[3], NULL, 10) : 1;
+
+  struct StringBuilder sb = CreateStringBuilder();
+  char path[4096];
+  for (int shape = 0; shape < CS_COUNT; shape++) {
+    StringBuilderClear(&sb);
+    GenerateCorpus(shape, size, seed, &sb);
+
+    snprintf(path, sizeof(path), "%s/%s.sdf", argv[1], CORPUS_SHAPE_NAMES[shape]);
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+      fprintf(stderr, "Error! Failed to open file: %s\n", path);
+      return 1;
+    }
+    fwrite(sb.string, 1, sb.length, f);
+    fclose(f);
+    printf("%s %zu bytes\n", path, sb.length);
+  }
+  free(sb.string);
+  return 0;
+}
@@ -0,0 +1,159 @@
+#include "batch.h"
+#include "cache.h"
+#include "main.h"
+
+static inline void ConvertFile(const char *file_path, struct StringBuilder *sb, struct ConvertOptions *options, int jobs) {
+  if (options->stats != SF_NONE) {
+    struct SDF_Stats s = {};
+    StatsFilePathToFormat(file_path, sb, jobs, options->format, &s);
+    WriteSDFStats(stderr, file_path, &s, options->stats);
+    AddSDFStats(options->totals, &s);
+  }
+  else if (options->cache != NULL) {
+    CachedFilePathToFormat(options->cache, file_path, sb, jobs, options->format);
+  }
+  else {
+    FilePathToFormat(file_path, sb, jobs, options->format);
+  }
+}
+
+static inline void ConvertFilesSequential(char **paths, size_t count, struct ConvertOptions *options, FILE *out) {
+  struct StringBuilder sb = CreateFileStringBuilder(out);
+  struct SDF_ParserContext context = CreateSDFParserContext();
+  struct SDF_ParserContext *previous = UseSDFParserContext(&context);
+  for (size_t i = 0; i < count; i++) {
+    ConvertFile(paths[i], &sb, options, 1);
+    StringBuilderFlush(&sb);
+  }
+  UseSDFParserContext(previous);
+  FreeSDFParserContext(&context);
+  free(sb.string);
+}
+
+#ifndef _WIN32
+
+static void* BatchWorker(void *arg) {
+  struct Batch *b = arg;
+  // Files converted on this thread reuse each other's scratch buffers
+  struct SDF_ParserContext context = CreateSDFParserContext();
+  UseSDFParserContext(&context);
+
+  pthread_mutex_lock(&b->lock);
+  while (b->next < b->count) {
+    if (b->ordered && b->next >= b->written + b->window) {
+      pthread_cond_wait(&b->space, &b->lock);
+      continue;
+    }
+    size_t i = b->next++;
+    pthread_mutex_unlock(&b->lock);
+
+    struct StringBuilder sb = CreateStringBuilder();
+    ConvertFile(b->paths[i], &sb, b->options, 1);
+
+    if (!b->ordered) {
+      // A single fwrite holds the stream lock, so lines never interleave
+      fwrite(sb.string, sizeof(char), sb.length, b->out);
+      free(sb.string);
+      pthread_mutex_lock(&b->lock);
+      continue;
+    }
+
+    pthread_mutex_lock(&b->lock);
+    b->results[i].output = sb;
+    b->results[i].done = 1;
+    pthread_cond_signal(&b->ready);
+  }
+  pthread_mutex_unlock(&b->lock);
+  UseSDFParserContext(NULL);
+  FreeSDFParserContext(&context);
+  return NULL;
+}
+
+// Writes results in argument order as they become available
+static inline void BatchSequence(struct Batch *b) {
+  for (size_t i = 0; i < b->count; i++) {
+    pthread_mutex_lock(&b->lock);
+    while (!b->results[i].done) {
+      pthread_cond_wait(&b->ready, &b->lock);
+    }
+    pthread_mutex_unlock(&b->lock);
+
+    struct StringBuilder *sb = &(b->results[i].output);
+    fwrite(sb->string, sizeof(char), sb->length, b->out);
+    fflush(b->out);
+    free(sb->string);
+
+    pthread_mutex_lock(&b->lock);
+    b->written++;
+    pthread_cond_broadcast(&b->space);
+    pthread_mutex_unlock(&b->lock);
+  }
+}
+
+inline void ConvertFiles(char **paths, size_t count, struct ConvertOptions *options, FILE *out) {
+  int jobs = options->jobs;
+  if (jobs <= 0) {
+    jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  }
+  if (count == 1 && jobs > 1) {
+    struct StringBuilder sb = CreateFileStringBuilder(out);
+    ConvertFile(paths[0], &sb, options, jobs);
+    StringBuilderFlush(&sb);
+    free(sb.string);
+    return;
+  }
+  if ((size_t)jobs > count) {
+    jobs = (int)count;
+  }
+  if (jobs <= 1) {
+    ConvertFilesSequential(paths, count, options, out);
+    return;
+  }
+
+  struct Batch b = {
+    .paths = paths,
+    .count = count,
+    .window = (size_t)jobs * BATCH_WINDOW_PER_JOB,
+    .ordered = options->ordered,
+    .options = options,
+    .out = out,
+    .results = options->ordered ? calloc(count, sizeof(struct BatchResult)) : NULL,
+  };
+  pthread_mutex_init(&b.lock, NULL);
+  pthread_cond_init(&b.ready, NULL);
+  pthread_cond_init(&b.space, NULL);
+
+  pthread_t *workers = malloc(sizeof(pthread_t) * jobs);
+  int started = 0;
+  while (started < jobs && pthread_create(&workers[started], NULL, BatchWorker, &b) == 0) {
+    started++;
+  }
+  if (started < jobs) {
+    ErrorLog("Started %d of %d worker threads", started, jobs);
+  }
+  if (started == 0) {
+    // Nothing was claimed, so the files can still be converted here
+    ConvertFilesSequential(paths, count, options, out);
+  }
+  else if (options->ordered) {
+    BatchSequence(&b);
+  }
+  for (int i = 0; i < started; i++) {
+    pthread_join(workers[i], NULL);
+  }
+  fflush(out);
+
+  free(workers);
+  free(b.results);
+  pthread_cond_destroy(&b.space);
+  pthread_cond_destroy(&b.ready);
+  pthread_mutex_destroy(&b.lock);
+}
+
+#else
+
+inline void ConvertFiles(char **paths, size_t count, struct ConvertOptions *options, FILE *out) {
+  ConvertFilesSequential(paths, count, options, out);
+}
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+#include "binary.h"
+#include "stats.h"
+#include "util.h"
+
+// How many files per worker may be buffered ahead of the one being written
+#define BATCH_WINDOW_PER_JOB 4
+
+/*
+  The converted output of one file, filled in by a worker and released
+  to the output by the sequencer once every earlier file is written.
+*/
+struct BatchResult {
+  struct StringBuilder output;
+  int done;
+};
+
+/*
+  How ConvertFiles converts. jobs 0 means one thread per online CPU and
+  cache, when set, is the directory CachedFilePathToFormat keeps outputs in.
+  With stats set each file's SDF_Stats go to stderr and are added to
+  totals, and the cache is skipped so every file is really converted.
+*/
+struct ConvertOptions {
+  int jobs;
+  int ordered;
+  enum SDF_OutputFormat format;
+  const char *cache;
+  enum SDF_StatsFormat stats;
+  struct SDF_Stats *totals;
+};
+
+/*
+  Files are claimed in argument order by the workers. In ordered mode
+  the calling thread writes results in the same order and workers stop
+  claiming once they are a window ahead of it, which bounds the memory
+  held by finished but unwritten files. Otherwise each worker writes its
+  file as soon as it is done.
+*/
+struct Batch {
+  char **paths;
+  size_t count;
+  size_t next;
+  size_t written;
+  size_t window;
+  int ordered;
+  struct ConvertOptions *options;
+  FILE *out;
+  struct BatchResult *results;
+#ifndef _WIN32
+  pthread_mutex_t lock;
+  pthread_cond_t ready;
+  pthread_cond_t space;
+#endif
+};
+
+/*
+  Converts each path to a document in options->format, by default a
+  line of JSON, on out using up to options->jobs threads. With ordered
+  unset files are written in completion order. A single file is
+  converted through the tree instead, with its large lists split across
+  the threads.
+*/
+void ConvertFiles(char **paths, size_t count, struct ConvertOptions *options, FILE *out);
+
+#endif
@@ -0,0 +1,303 @@
+#include "binary.h"
+
+enum BinaryKind {
+  BK_STRING,
+  BK_LIST,
+  BK_OBJECT,
+};
+
+// CBOR major types of the kinds
+static const uint8_t CBOR_MAJOR[3] = {
+  [BK_STRING] = 3,
+  [BK_LIST] = 4,
+  [BK_OBJECT] = 5,
+};
+
+// MessagePack: the fix* type of each kind, the most it holds, and the 8 bit form (0 for none)
+static const uint8_t MSGPACK_FIX[3] = {
+  [BK_STRING] = 0xA0,
+  [BK_LIST] = 0x90,
+  [BK_OBJECT] = 0x80,
+};
+static const size_t MSGPACK_FIX_MAX[3] = {
+  [BK_STRING] = 31,
+  [BK_LIST] = 15,
+  [BK_OBJECT] = 15,
+};
+static const uint8_t MSGPACK_8[3] = {
+  [BK_STRING] = 0xD9,
+};
+// The 16 bit forms, followed by the 32 bit ones
+static const uint8_t MSGPACK_16[3] = {
+  [BK_STRING] = 0xDA,
+  [BK_LIST] = 0xDC,
+  [BK_OBJECT] = 0xDE,
+};
+
+inline int ParseSDFOutputFormat(const char *name, enum SDF_OutputFormat *format) {
+  if (strcmp(name, "json") == 0) {
+    *format = OF_JSON;
+  }
+  else if (strcmp(name, "msgpack") == 0) {
+    *format = OF_MSGPACK;
+  }
+  else if (strcmp(name, "cbor") == 0) {
+    *format = OF_CBOR;
+  }
+  else {
+    return 0;
+  }
+  return 1;
+}
+
+// Appends first and then the low size bytes of value, most significant first
+static inline void BinaryAddBigEndian(struct StringBuilder *sb, uint8_t first, uint64_t value, size_t size) {
+  StringBuilderReserve(sb, size + 1);
+  char *p = sb->string + sb->length;
+  p[0] = (char)first;
+  for (size_t i = 0; i < size; i++) {
+    p[size - i] = (char)(value >> (i * 8));
+  }
+  sb->length += size + 1;
+  sb->string[sb->length] = '\0';
+}
+
+// CBOR's initial byte with an argument of 0 to 8 bytes after it
+static inline void CBORAddHead(struct StringBuilder *sb, uint8_t major, uint64_t n) {
+  major <<= 5;
+  if (n < 24) {
+    BinaryAddBigEndian(sb, major | n, 0, 0);
+  }
+  else if (n <= UINT8_MAX) {
+    BinaryAddBigEndian(sb, major | 24, n, 1);
+  }
+  else if (n <= UINT16_MAX) {
+    BinaryAddBigEndian(sb, major | 25, n, 2);
+  }
+  else if (n <= UINT32_MAX) {
+    BinaryAddBigEndian(sb, major | 26, n, 4);
+  }
+  else {
+    BinaryAddBigEndian(sb, major | 27, n, 8);
+  }
+}
+
+static inline void BinaryAddHeader(struct StringBuilder *sb, enum SDF_OutputFormat format, enum BinaryKind kind, size_t n) {
+  if (format == OF_CBOR) {
+    CBORAddHead(sb, CBOR_MAJOR[kind], n);
+  }
+  else if (n <= MSGPACK_FIX_MAX[kind]) {
+    BinaryAddBigEndian(sb, MSGPACK_FIX[kind] | n, 0, 0);
+  }
+  else if (n <= UINT8_MAX && MSGPACK_8[kind] != 0) {
+    BinaryAddBigEndian(sb, MSGPACK_8[kind], n, 1);
+  }
+  else if (n <= UINT16_MAX) {
+    BinaryAddBigEndian(sb, MSGPACK_16[kind], n, 2);
+  }
+  else {
+    BinaryAddBigEndian(sb, MSGPACK_16[kind] + 1, n, 4);
+  }
+}
+
+static inline void BinaryAddNil(struct StringBuilder *sb, enum SDF_OutputFormat format) {
+  BinaryAddBigEndian(sb, format == OF_CBOR ? 0xF6 : 0xC0, 0, 0);
+}
+
+static inline void BinaryAddInteger(struct StringBuilder *sb, enum SDF_OutputFormat format, int64_t value) {
+  if (format == OF_CBOR) {
+    // Negative integers are stored as -1 - value
+    CBORAddHead(sb, value < 0 ? 1 : 0, value < 0 ? ~(uint64_t)value : (uint64_t)value);
+  }
+  else if (value >= 0) {
+    if (value <= INT8_MAX) {
+      BinaryAddBigEndian(sb, (uint8_t)value, 0, 0);
+    }
+    else if (value <= UINT8_MAX) {
+      BinaryAddBigEndian(sb, 0xCC, value, 1);
+    }
+    else if (value <= UINT16_MAX) {
+      BinaryAddBigEndian(sb, 0xCD, value, 2);
+    }
+    else if (value <= UINT32_MAX) {
+      BinaryAddBigEndian(sb, 0xCE, value, 4);
+    }
+    else {
+      BinaryAddBigEndian(sb, 0xCF, value, 8);
+    }
+  }
+  else if (value >= -32) {
+    BinaryAddBigEndian(sb, (uint8_t)value, 0, 0);
+  }
+  else if (value >= INT8_MIN) {
+    BinaryAddBigEndian(sb, 0xD0, (uint64_t)value, 1);
+  }
+  else if (value >= INT16_MIN) {
+    BinaryAddBigEndian(sb, 0xD1, (uint64_t)value, 2);
+  }
+  else if (value >= INT32_MIN) {
+    BinaryAddBigEndian(sb, 0xD2, (uint64_t)value, 4);
+  }
+  else {
+    BinaryAddBigEndian(sb, 0xD3, (uint64_t)value, 8);
+  }
+}
+
+static inline void BinaryAddDouble(struct StringBuilder *sb, enum SDF_OutputFormat format, double value) {
+  float f = (float)value;
+  if ((double)f == value) {
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    BinaryAddBigEndian(sb, format == OF_CBOR ? 0xFA : 0xCA, bits, 4);
+  }
+  else {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    BinaryAddBigEndian(sb, format == OF_CBOR ? 0xFB : 0xCB, bits, 8);
+  }
+}
+
+static inline void BinaryAddString(struct StringBuilder *sb, enum SDF_OutputFormat format, const char *s, size_t length) {
+  int valid;
+  size_t replaced = UTF8ReplacedLength(s, length, &valid);
+  BinaryAddHeader(sb, format, BK_STRING, replaced);
+  if (!valid) {
+    StringBuilderAddUTF8(sb, s, length);
+    return;
+  }
+  StringBuilderReserve(sb, length);
+  memcpy(sb->string + sb->length, s, length);
+  sb->length += length;
+  sb->string[sb->length] = '\0';
+}
+
+static inline void SDFRowToBinary(struct SDF_Row *r, struct StringBuilder *sb, enum SDF_OutputFormat format) {
+  size_t length = SDFTableRowLength(r->table, r->index);
+  BinaryAddHeader(sb, format, BK_OBJECT, length);
+  for (size_t i = 0; i < length; i++) {
+    char *key = r->table->schema->items[i];
+    struct ParserValue pv;
+    BinaryAddString(sb, format, key, strlen(key));
+    if (SDFTableGetField(r->table, r->index, i, &pv)) {
+      ParserValueToBinary(&pv, sb, format);
+    }
+    else {
+      BinaryAddNil(sb, format);
+    }
+  }
+}
+
+static inline void SDFListToBinary(struct SDF_List *l, struct StringBuilder *sb, enum SDF_OutputFormat format) {
+  size_t length = SDFListLength(l);
+  BinaryAddHeader(sb, format, BK_LIST, length);
+  for (size_t i = 0; i < length; i++) {
+    struct ParserValue pv = SDFListGetItem(l, i);
+    ParserValueToBinary(&pv, sb, format);
+  }
+}
+
+inline void SDFObjectToBinary(struct SDF_Object *o, struct StringBuilder *sb, enum SDF_OutputFormat format) {
+  BinaryAddHeader(sb, format, BK_OBJECT, o->keys->length);
+  for (size_t i = 0; i < o->keys->length; i++) {
+    BinaryAddString(sb, format, o->keys->items[i], strlen(o->keys->items[i]));
+    ParserValueToBinary(&(o->values->items[i]), sb, format);
+  }
+}
+
+inline void ParserValueToBinary(struct ParserValue *pv, struct StringBuilder *sb, enum SDF_OutputFormat format) {
+  switch (pv->type) {
+    case PVT_STRING:
+      BinaryAddString(sb, format, pv->data.as_string, strlen(pv->data.as_string));
+      break;
+    case PVT_INTEGER:
+      BinaryAddInteger(sb, format, pv->data.as_integer);
+      break;
+    case PVT_DOUBLE:
+      BinaryAddDouble(sb, format, pv->data.as_double);
+      break;
+    case PVT_OBJECT:
+      SDFObjectToBinary(&(pv->data.as_object), sb, format);
+      break;
+    case PVT_LIST:
+      SDFListToBinary(&(pv->data.as_list), sb, format);
+      break;
+    case PVT_ROW:
+      SDFRowToBinary(&(pv->data.as_row), sb, format);
+      break;
+    default:
+      BinaryAddNil(sb, format);
+  }
+}
+
+inline void SDFImageValueToBinary(struct SDF_ImageValue *v, struct StringBuilder *sb, enum SDF_OutputFormat format) {
+  struct SDF_ImageValue item;
+  const char *key;
+  size_t length, key_length;
+  switch (v->type) {
+    case PVT_STRING: {
+      const char *s = SDFImageValueString(v, &length);
+      if (s != NULL) {
+        BinaryAddString(sb, format, s, length);
+      }
+      else {
+        BinaryAddNil(sb, format);
+      }
+      break;
+    }
+    case PVT_INTEGER:
+      BinaryAddInteger(sb, format, v->data.as_integer);
+      break;
+    case PVT_DOUBLE:
+      BinaryAddDouble(sb, format, v->data.as_double);
+      break;
+    case PVT_OBJECT:
+    case PVT_ROW:
+      length = SDFImageValueLength(v);
+      BinaryAddHeader(sb, format, BK_OBJECT, length);
+      for (size_t i = 0; i < length; i++) {
+        if (SDFImageValueGetEntry(v, i, &key, &key_length, &item)) {
+          BinaryAddString(sb, format, key, key_length);
+          SDFImageValueToBinary(&item, sb, format);
+        }
+        else {
+          BinaryAddNil(sb, format);
+          BinaryAddNil(sb, format);
+        }
+      }
+      break;
+    case PVT_LIST:
+      length = SDFImageValueLength(v);
+      BinaryAddHeader(sb, format, BK_LIST, length);
+      for (size_t i = 0; i < length; i++) {
+        if (SDFImageValueGetItem(v, i, &item)) {
+          SDFImageValueToBinary(&item, sb, format);
+        }
+        else {
+          BinaryAddNil(sb, format);
+        }
+      }
+      break;
+    default:
+      BinaryAddNil(sb, format);
+  }
+}
+
+inline void SDFObjectToFormat(struct SDF_Object *o, struct StringBuilder *sb, enum SDF_OutputFormat format) {
+  if (format == OF_JSON) {
+    SDFObjectToString(o, sb);
+    StringBuilderAddChar(sb, '\n');
+  }
+  else {
+    SDFObjectToBinary(o, sb, format);
+  }
+}
+
+inline void SDFImageValueToFormat(struct SDF_ImageValue *v, struct StringBuilder *sb, enum SDF_OutputFormat format) {
+  if (format == OF_JSON) {
+    SDFImageValueToString(v, sb);
+    StringBuilderAddChar(sb, '\n');
+  }
+  else {
+    SDFImageValueToBinary(v, sb, format);
+  }
+}
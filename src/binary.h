@@ -0,0 +1,36 @@
+#ifndef BINARY_H
+#define BINARY_H
+
+#include "format.h"
+#include "image.h"
+#include "parser.h"
+#include "util.h"
+
+enum SDF_OutputFormat {
+  OF_JSON,
+  OF_MSGPACK,
+  OF_CBOR,
+};
+
+// Returns 0 if name isn't json, msgpack or cbor
+int ParseSDFOutputFormat(const char *name, enum SDF_OutputFormat *format);
+
+/*
+  MessagePack and CBOR writers. Both formats put the length of a string,
+  list or object before its contents, so they write trees, where the
+  lengths are known, instead of parser events. Integers, doubles and
+  lengths take the fewest bytes that hold them exactly (a double that
+  fits a float exactly is written as a float32). Strings are UTF-8, and
+  invalid bytes are replaced like in JSON. Rows of schema lists become
+  maps. Documents in a stream follow each other without separators.
+*/
+void ParserValueToBinary(struct ParserValue *pv, struct StringBuilder *sb, enum SDF_OutputFormat format);
+void SDFObjectToBinary(struct SDF_Object *o, struct StringBuilder *sb, enum SDF_OutputFormat format);
+// Missing values of a damaged image are written as nil, so the output stays well formed
+void SDFImageValueToBinary(struct SDF_ImageValue *v, struct StringBuilder *sb, enum SDF_OutputFormat format);
+
+// Writes a document: JSON on a line of its own, or a single binary value
+void SDFObjectToFormat(struct SDF_Object *o, struct StringBuilder *sb, enum SDF_OutputFormat format);
+void SDFImageValueToFormat(struct SDF_ImageValue *v, struct StringBuilder *sb, enum SDF_OutputFormat format);
+
+#endif
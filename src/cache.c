@@ -0,0 +1,150 @@
+#include "cache.h"
+#include "image.h"
+#include "main.h"
+
+#ifndef _WIN32
+
+#ifdef __APPLE__
+#define STAT_MTIME_NSEC(st) ((st)->st_mtimespec.tv_nsec)
+#else
+#define STAT_MTIME_NSEC(st) ((st)->st_mtim.tv_nsec)
+#endif
+
+static inline void SDFCacheEntryPath(const char *cache, const char *file_path, enum SDF_OutputFormat format, struct StringBuilder *sb) {
+  // The same file reached through different paths shares an entry, each format has its own
+  char *real = realpath(file_path, NULL);
+  const char *key = real != NULL ? real : file_path;
+  char name[32];
+  snprintf(name, sizeof(name), "/%016" PRIx64, HashBytes(key, strlen(key), format));
+  StringBuilderAddString(sb, (char*)cache);
+  StringBuilderAddString(sb, name);
+  free(real);
+}
+
+static inline int SDFCacheHeaderMatches(struct SDF_CacheHeader *h, struct stat *st, enum SDF_OutputFormat format) {
+  return memcmp(h->magic, SDF_CACHE_MAGIC, 4) == 0
+    && h->version == SDF_CACHE_VERSION
+    && h->format == format
+    && h->size == (uint64_t)st->st_size;
+}
+
+static inline int SDFCacheMTimeMatches(struct SDF_CacheHeader *h, struct stat *st) {
+  return h->mtime_sec == (int64_t)st->st_mtime
+    && h->mtime_nsec == (int64_t)STAT_MTIME_NSEC(st)
+    && h->mtime_sec < h->written_sec;
+}
+
+// Appends the output stored after the header to sb
+static inline int SDFCacheReadOutput(FILE *f, struct SDF_CacheHeader *h, struct StringBuilder *sb) {
+  size_t length = sb->length;
+  StringBuilderReserve(sb, h->length);
+  if (fread(sb->string + sb->length, sizeof(char), h->length, f) != h->length) {
+    sb->length = length;
+    return 0;
+  }
+  sb->length += h->length;
+  sb->string[sb->length] = '\0';
+  return 1;
+}
+
+static inline void SDFCacheWrite(const char *cache, const char *entry, struct SDF_CacheHeader *h, struct StringBuilder *output) {
+  struct StringBuilder temp = CreateStringBuilder();
+  StringBuilderAddString(&temp, (char*)entry);
+  StringBuilderAddString(&temp, ".XXXXXX");
+  mkdir(cache, 0777);
+  int fd = mkstemp(temp.string);
+  if (fd < 0) {
+    StdErrorLog("Failed to create cache entry: %s", temp.string);
+    free(temp.string);
+    return;
+  }
+  FILE *f = fdopen(fd, "wb");
+  int ok = f != NULL
+    && fwrite(h, sizeof(*h), 1, f) == 1
+    && fwrite(output->string, sizeof(char), output->length, f) == output->length;
+  if (f != NULL) {
+    ok = fclose(f) == 0 && ok;
+  }
+  else {
+    close(fd);
+  }
+  if (!ok || rename(temp.string, entry) != 0) {
+    StdErrorLog("Failed to write cache entry: %s", entry);
+    unlink(temp.string);
+  }
+  free(temp.string);
+}
+
+inline void CachedFilePathToFormat(const char *cache, const char *file_path, struct StringBuilder *sb, int jobs, enum SDF_OutputFormat format) {
+  struct stat st;
+  if (stat(file_path, &st) != 0) {
+    FilePathToFormat(file_path, sb, jobs, format);
+    return;
+  }
+
+  struct StringBuilder entry = CreateStringBuilder();
+  SDFCacheEntryPath(cache, file_path, format, &entry);
+  struct SDF_CacheHeader h;
+  FILE *f = fopen(entry.string, "rb");
+  int found = f != NULL
+    && fread(&h, sizeof(h), 1, f) == 1
+    && SDFCacheHeaderMatches(&h, &st, format);
+  if (found && SDFCacheMTimeMatches(&h, &st) && SDFCacheReadOutput(f, &h, sb)) {
+    goto Done;
+  }
+
+  struct FileBuffer fb;
+  if (!OpenFileBuffer(file_path, &fb)) {
+    fprintf(stderr, "Error! Failed to open file: %s\n", file_path);
+    goto Done;
+  }
+  if (IsSDFImage(fb.data, fb.length)) {
+    BufferToFormat(fb.data, fb.length, sb, jobs, format);
+    CloseFileBuffer(&fb);
+    goto Done;
+  }
+
+  uint64_t hash = HashBytes(fb.data, fb.length, 0);
+  struct StringBuilder output = CreateStringBuilder();
+  int changed = !found || h.hash != hash || !SDFCacheReadOutput(f, &h, &output);
+  if (changed) {
+    BufferToFormat(fb.data, fb.length, &output, jobs, format);
+  }
+  CloseFileBuffer(&fb);
+
+  // A touched file gets a new entry once its mtime can be trusted, so the next run skips hashing
+  int64_t now = time(NULL);
+  if (changed || now > (int64_t)st.st_mtime) {
+    struct SDF_CacheHeader header = {
+      .magic = SDF_CACHE_MAGIC,
+      .version = SDF_CACHE_VERSION,
+      .format = format,
+      .size = st.st_size,
+      .mtime_sec = st.st_mtime,
+      .mtime_nsec = STAT_MTIME_NSEC(&st),
+      .written_sec = now,
+      .hash = hash,
+      .length = output.length,
+    };
+    SDFCacheWrite(cache, entry.string, &header, &output);
+  }
+  StringBuilderReserve(sb, output.length);
+  memcpy(sb->string + sb->length, output.string, output.length);
+  sb->length += output.length;
+  sb->string[sb->length] = '\0';
+  free(output.string);
+
+Done:
+  if (f != NULL) {
+    fclose(f);
+  }
+  free(entry.string);
+}
+
+#else
+
+inline void CachedFilePathToFormat(const char *cache, const char *file_path, struct StringBuilder *sb, int jobs, enum SDF_OutputFormat format) {
+  FilePathToFormat(file_path, sb, jobs, format);
+}
+
+#endif
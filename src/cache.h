@@ -0,0 +1,43 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#ifndef _INC_TIME
+#include <time.h>
+#endif
+
+#include "binary.h"
+#include "util.h"
+
+#define SDF_CACHE_MAGIC "SDFC"
+// Bump when a conversion would produce different output, to drop old entries
+#define SDF_CACHE_VERSION 2
+
+/*
+  Start of a cache entry, which holds the converted output of one file
+  in one output format and is named after the hash of the file's real
+  path and the format. Entries are only meant for the machine that
+  wrote them, so the header is stored as is.
+*/
+struct SDF_CacheHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t format; // enum SDF_OutputFormat
+  uint64_t size;
+  int64_t mtime_sec, mtime_nsec;
+  int64_t written_sec;
+  uint64_t hash; // HashBytes of the contents
+  uint64_t length; // Bytes of output after the header
+};
+
+/*
+  Converts file_path like FilePathToFormat, through a cache kept
+  in the directory `cache`. An entry is used when the size matches and
+  either the mtime matches or the contents hash to the same value. The
+  mtime alone is only trusted once the second it names had passed when
+  the entry was written, since a file changed again within that second
+  could keep it. Entries are replaced by renaming, so several processes
+  can share a cache. Compiled images are fast to read and not cached.
+*/
+void CachedFilePathToFormat(const char *cache, const char *file_path, struct StringBuilder *sb, int jobs, enum SDF_OutputFormat format);
+
+#endif
@@ -0,0 +1,101 @@
+#include "classify.h"
+
+#if defined(__AVX2__)
+
+// x is in [lo, lo + n] as an unsigned byte
+static inline __m256i InRange256(__m256i x, char lo, char n) {
+  __m256i d = _mm256_sub_epi8(x, _mm256_set1_epi8(lo));
+  return _mm256_cmpeq_epi8(_mm256_min_epu8(d, _mm256_set1_epi8(n)), d);
+}
+
+static inline uint64_t MoveMask256(__m256i x, int shift) {
+  return (uint64_t)(uint32_t)_mm256_movemask_epi8(x) << shift;
+}
+
+static inline void ClassifyVectors(const char *s, uint64_t masks[CC_COUNT]) {
+  for (int i = 0; i < CLASSIFY_BLOCK_SIZE; i += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)(s + i));
+    __m256i whitespace = _mm256_or_si256(
+      _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+      _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))
+    );
+    __m256i newline = _mm256_or_si256(
+      _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')),
+      _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))
+    );
+    __m256i digit = _mm256_or_si256(
+      InRange256(v, '0', 9),
+      _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_'))
+    );
+    __m256i alphabetic = InRange256(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 25);
+    masks[CC_WHITESPACE] |= MoveMask256(whitespace, i);
+    masks[CC_NEWLINE] |= MoveMask256(newline, i);
+    masks[CC_WORD] |= MoveMask256(_mm256_or_si256(alphabetic, digit), i);
+    masks[CC_DIGIT] |= MoveMask256(digit, i);
+    masks[CC_QUOTE] |= MoveMask256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')), i);
+  }
+}
+
+#elif defined(__SSE2__)
+
+// x is in [lo, lo + n] as an unsigned byte
+static inline __m128i InRange128(__m128i x, char lo, char n) {
+  __m128i d = _mm_sub_epi8(x, _mm_set1_epi8(lo));
+  return _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(n)), d);
+}
+
+static inline uint64_t MoveMask128(__m128i x, int shift) {
+  return (uint64_t)(uint16_t)_mm_movemask_epi8(x) << shift;
+}
+
+static inline void ClassifyVectors(const char *s, uint64_t masks[CC_COUNT]) {
+  for (int i = 0; i < CLASSIFY_BLOCK_SIZE; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(s + i));
+    __m128i whitespace = _mm_or_si128(
+      _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+      _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))
+    );
+    __m128i newline = _mm_or_si128(
+      _mm_cmpeq_epi8(v, _mm_set1_epi8('\n')),
+      _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))
+    );
+    __m128i digit = _mm_or_si128(
+      InRange128(v, '0', 9),
+      _mm_cmpeq_epi8(v, _mm_set1_epi8('_'))
+    );
+    __m128i alphabetic = InRange128(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 25);
+    masks[CC_WHITESPACE] |= MoveMask128(whitespace, i);
+    masks[CC_NEWLINE] |= MoveMask128(newline, i);
+    masks[CC_WORD] |= MoveMask128(_mm_or_si128(alphabetic, digit), i);
+    masks[CC_DIGIT] |= MoveMask128(digit, i);
+    masks[CC_QUOTE] |= MoveMask128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')), i);
+  }
+}
+
+#else
+
+static inline void ClassifyVectors(const char *s, uint64_t masks[CC_COUNT]) {
+  for (int i = 0; i < CLASSIFY_BLOCK_SIZE; i++) {
+    char c = s[i];
+    uint64_t bit = (uint64_t)1 << i;
+    int digit = CharIsDigit(c) || c == '_';
+    masks[CC_WHITESPACE] |= CharIsWhiteSpace(c) ? bit : 0;
+    masks[CC_NEWLINE] |= c == '\n' || c == '\r' ? bit : 0;
+    masks[CC_WORD] |= digit || CharIsAlphabetic(c) ? bit : 0;
+    masks[CC_DIGIT] |= digit ? bit : 0;
+    masks[CC_QUOTE] |= c == '"' ? bit : 0;
+  }
+}
+
+#endif
+
+inline void ClassifyBlock(const char *s, size_t length, uint64_t masks[CC_COUNT]) {
+  char padded[CLASSIFY_BLOCK_SIZE];
+  if (length < CLASSIFY_BLOCK_SIZE) {
+    memset(padded, 0, CLASSIFY_BLOCK_SIZE);
+    memcpy(padded, s, length);
+    s = padded;
+  }
+  memset(masks, 0, sizeof(uint64_t) * CC_COUNT);
+  ClassifyVectors(s, masks);
+}
@@ -0,0 +1,29 @@
+#ifndef CLASSIFY_H
+#define CLASSIFY_H
+
+#include "util.h"
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#define CLASSIFY_BLOCK_SIZE 64
+
+enum CharClass {
+  CC_WHITESPACE,  // Spaces and tabs
+  CC_NEWLINE,     // \n and \r
+  CC_WORD,        // Letters, digits and underscores
+  CC_DIGIT,       // Digits and underscores
+  CC_QUOTE,       // "
+  CC_COUNT,
+};
+
+/*
+  Sets bit i of masks[c] when byte i of the block is in class c.
+  Uses AVX2 when compiled with it enabled, SSE2 on any x86-64 and a
+  table lookup per byte elsewhere. Blocks shorter than 64 bytes are
+  padded with zeros, which belong to no class.
+*/
+void ClassifyBlock(const char *s, size_t length, uint64_t masks[CC_COUNT]);
+
+#endif
@@ -0,0 +1,295 @@
+#include "events.h"
+
+static inline void EmitScalar(struct SDF_EventHandler *h, char *s) {
+  struct ParserValue pv = CreateParserValueScalar(s);
+  EmitEvent(h, value, &pv);
+}
+
+/*
+  Schema rows are held back in row, their values one after the other
+  with a '\0' after each, until they are complete. Values nested in the
+  middle of a row then come out before it, like ParseList orders them.
+*/
+static inline void EmitRow(struct SDF_EventHandler *h, struct StringList *schema, struct StringBuilder *row, size_t fields) {
+  char *value = row->string;
+  EmitEvent(h, begin_object);
+  for (size_t i = 0; i < fields; i++) {
+    EmitEvent(h, key, schema->items[i]);
+    EmitScalar(h, value);
+    value += strlen(value) + 1;
+  }
+  EmitEvent(h, end_object);
+  StringBuilderClear(row);
+}
+
+static inline void AddRowField(struct StringBuilder *row, char *value) {
+  StringBuilderAddString(row, value);
+  StringBuilderAddChar(row, '\0');
+}
+
+// Frees the schema keys an object parsed into events owns, then releases its scratch
+static void EventsScratchCleanup(void *s) {
+  struct SDF_ParserScratch *scratch = s;
+  for (size_t i = 0; i < scratch->schema.length; i++) {
+    free(scratch->schema.items[i]);
+  }
+  ReleaseParserScratch(scratch);
+}
+
+inline void ParseObjectEvents(struct TokenIterator *ti, struct SDF_EventHandler *h) {
+  struct Token t = {};
+  struct SDF_ParserScratch local, *scratch = AcquireParserScratch(&local);
+  struct StringBuilder *sb = &(scratch->sb), *key = &(scratch->key);
+  struct StringList *schema = &(scratch->schema);
+  struct SDF_Cleanup cleanup;
+  int has_key = 0;
+  if (key->string == NULL) {
+    *key = CreateStringBuilder();
+  }
+  if (schema->items == NULL) {
+    *schema = CreateStringList();
+  }
+  PushSDFCleanup(&cleanup, EventsScratchCleanup, scratch);
+
+  EmitEvent(h, begin_object);
+  while (GetNextToken(ti, &t)) switch (t.type) {
+    case TT_TEXT:
+    case TT_NUMBER:
+    case TT_STRING:
+    case TT_OTHER: {
+      if (has_key) {
+        InvalidTokenError(t);
+      }
+      StringBuilderClear(key);
+      StringBuilderAddToken(key, &t);
+      ParseKeyText(ti, key);
+      char *text = StringBuilderTrimInPlace(key);
+      if (!ParserScratchAddKeyCopy(scratch, text)) {
+        DuplicateKeyError(t, text);
+      }
+      EmitEvent(h, key, text);
+      has_key = 1;
+      break;
+    }
+
+    case TT_EQUALS: {
+      if (!has_key) {
+        InvalidTokenError(t);
+      }
+      ParseValueText(ti, sb);
+      EmitScalar(h, StringBuilderTrimInPlace(sb));
+      StringBuilderClear(sb);
+      has_key = 0;
+      break;
+    }
+
+    case TT_LBRACE:
+      if (!has_key) {
+        InvalidTokenError(t);
+      }
+      ParseObjectEvents(ti, h);
+      has_key = 0;
+      break;
+
+    case TT_LBRACK:
+      if (!has_key) {
+        InvalidTokenError(t);
+      }
+      ParseListEvents(ti, schema, h);
+      has_key = 0;
+      break;
+
+    case TT_LPAREN:
+      // A new schema replaces the previous one
+      for (size_t i = 0; i < schema->length; i++) {
+        free(schema->items[i]);
+      }
+      schema->length = 0;
+      ParseSchema(ti, schema, NULL);
+      break;
+
+    case TT_NEWLINE:
+    case TT_WHITESPACE:
+      continue;
+
+    case TT_RBRACE:
+      goto FunctionReturn;
+
+    default:
+      InvalidTokenError(t);
+  }
+
+FunctionReturn:
+  if (has_key) {
+    NoMatchingValueError(StringBuilderTrimInPlace(key));
+  }
+  EmitEvent(h, end_object);
+  PopSDFCleanup(&cleanup);
+  EventsScratchCleanup(scratch);
+}
+
+inline void ParseListEvents(struct TokenIterator *ti, struct StringList *schema, struct SDF_EventHandler *h) {
+  struct SDF_ParserScratch local, *scratch = AcquireParserScratch(&local);
+  struct StringBuilder *sb = &(scratch->sb), *row = &(scratch->key);
+  struct Token t;
+  int ignore_whitespace_and_newlines = 1;
+  struct SDF_Cleanup cleanup;
+  size_t fields = 0;
+  if (row->string == NULL) {
+    *row = CreateStringBuilder();
+  }
+  PushSDFCleanup(&cleanup, ParserScratchCleanup, scratch);
+
+  EmitEvent(h, begin_list);
+  if (schema->length > 0) {
+    EmitEvent(h, schema, schema);
+  }
+
+  while (GetNextToken(ti, &t)) {
+    // Same rules as ParseList
+    if (ignore_whitespace_and_newlines) {
+      if (t.type == TT_NEWLINE || t.type == TT_WHITESPACE) {
+        continue;
+      }
+      else {
+        ignore_whitespace_and_newlines = 0;
+      }
+    }
+
+    switch (t.type) {
+      case TT_TEXT:
+      case TT_NUMBER:
+      case TT_STRING:
+      case TT_OTHER:
+      case TT_WHITESPACE:
+        StringBuilderAddToken(sb, &t);
+        break;
+
+      case TT_NEWLINE:
+      case TT_SEMICOLON: {
+        char *value = StringBuilderTrimInPlace(sb);
+        if (schema->length > 0) {
+          AddRowField(row, value);
+          fields += 1;
+          if (fields == schema->length) {
+            EmitRow(h, schema, row, fields);
+            fields = 0;
+          }
+        }
+        else {
+          EmitScalar(h, value);
+        }
+        ignore_whitespace_and_newlines = 1;
+        StringBuilderClear(sb);
+        break;
+      }
+
+      case TT_LBRACE: {
+        ParseObjectEvents(ti, h);
+        ignore_whitespace_and_newlines = 1;
+        break;
+      }
+
+      case TT_LBRACK: {
+        ParseListEvents(ti, schema, h);
+        ignore_whitespace_and_newlines = 1;
+        break;
+      }
+
+      case TT_RBRACK: {
+        char *value = StringBuilderTrimInPlace(sb);
+        if (schema->length > 0) {
+          if (strlen(value) > 0) {
+            AddRowField(row, value);
+            fields += 1;
+          }
+          if (fields > 0) {
+            EmitRow(h, schema, row, fields);
+          }
+        }
+        else if (strlen(value) > 0) {
+          EmitScalar(h, value);
+        }
+        goto FunctionReturn;
+      }
+
+      default:
+        InvalidTokenError(t);
+    }
+  }
+
+FunctionReturn:
+  EmitEvent(h, end_list);
+  PopSDFCleanup(&cleanup);
+  ReleaseParserScratch(scratch);
+}
+
+static inline void JSONWriterSeparate(struct JSONWriter *w) {
+  if (w->after_key) {
+    w->after_key = 0;
+  }
+  else if (!w->first) {
+    StringBuilderAddChar(w->sb, ',');
+  }
+  w->first = 0;
+}
+
+static void JSONWriterBeginObject(void *user_data) {
+  struct JSONWriter *w = user_data;
+  JSONWriterSeparate(w);
+  StringBuilderAddChar(w->sb, '{');
+  w->first = 1;
+}
+
+static void JSONWriterEndObject(void *user_data) {
+  struct JSONWriter *w = user_data;
+  StringBuilderAddChar(w->sb, '}');
+  w->first = 0;
+}
+
+static void JSONWriterKey(void *user_data, char *key) {
+  struct JSONWriter *w = user_data;
+  JSONWriterSeparate(w);
+  StringBuilderAddJSONString(w->sb, key, strlen(key));
+  StringBuilderAddChar(w->sb, ':');
+  w->after_key = 1;
+}
+
+static void JSONWriterValue(void *user_data, struct ParserValue *pv) {
+  struct JSONWriter *w = user_data;
+  JSONWriterSeparate(w);
+  ParserValueToString(pv, w->sb);
+}
+
+static void JSONWriterBeginList(void *user_data) {
+  struct JSONWriter *w = user_data;
+  JSONWriterSeparate(w);
+  StringBuilderAddChar(w->sb, '[');
+  w->first = 1;
+}
+
+static void JSONWriterEndList(void *user_data) {
+  struct JSONWriter *w = user_data;
+  StringBuilderAddChar(w->sb, ']');
+  w->first = 0;
+}
+
+inline struct JSONWriter CreateJSONWriter(struct StringBuilder *sb) {
+  return (struct JSONWriter) {
+    .sb = sb,
+    .first = 1,
+    .after_key = 0,
+  };
+}
+
+inline struct SDF_EventHandler CreateJSONEventHandler(struct JSONWriter *w) {
+  return (struct SDF_EventHandler) {
+    .user_data = w,
+    .begin_object = JSONWriterBeginObject,
+    .end_object = JSONWriterEndObject,
+    .key = JSONWriterKey,
+    .value = JSONWriterValue,
+    .begin_list = JSONWriterBeginList,
+    .end_list = JSONWriterEndList,
+  };
+}
@@ -0,0 +1,43 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include "parser.h"
+#include "tokenizer.h"
+#include "util.h"
+
+/*
+  Callbacks for parsing without building a tree. Any of them may be NULL.
+  Strings passed to a callback are only valid for the duration of the call.
+  Rows of a schema list arrive as objects keyed by the schema, after a
+  schema event right behind the list's begin_list.
+*/
+struct SDF_EventHandler {
+  void *user_data;
+  void (*begin_object)(void *user_data);
+  void (*end_object)(void *user_data);
+  void (*key)(void *user_data, char *key);
+  void (*value)(void *user_data, struct ParserValue *pv);
+  void (*begin_list)(void *user_data);
+  void (*end_list)(void *user_data);
+  void (*schema)(void *user_data, struct StringList *schema);
+};
+
+#define EmitEvent(h, event, ...)\
+  do {\
+    if ((h)->event != NULL) {\
+      (h)->event((h)->user_data, ##__VA_ARGS__);\
+    }\
+  } while (0)
+
+void ParseObjectEvents(struct TokenIterator *ti, struct SDF_EventHandler *h);
+void ParseListEvents(struct TokenIterator *ti, struct StringList *schema, struct SDF_EventHandler *h);
+
+struct JSONWriter {
+  struct StringBuilder *sb;
+  int first, after_key;
+};
+
+struct JSONWriter CreateJSONWriter(struct StringBuilder *sb);
+struct SDF_EventHandler CreateJSONEventHandler(struct JSONWriter *w);
+
+#endif
@@ -0,0 +1,607 @@
+#include "format.h"
+
+static const char DIGIT_PAIRS[200] =
+  "00010203040506070809"
+  "10111213141516171819"
+  "20212223242526272829"
+  "30313233343536373839"
+  "40414243444546474849"
+  "50515253545556575859"
+  "60616263646566676869"
+  "70717273747576777879"
+  "80818283848586878889"
+  "90919293949596979899";
+
+inline size_t FormatInteger(int64_t value, char *buffer) {
+  char digits[20];
+  char *end = digits + sizeof(digits);
+  char *p = end;
+  size_t length = 0;
+  uint64_t u = (uint64_t)value;
+
+  if (value < 0) {
+    buffer[length++] = '-';
+    u = -u;
+  }
+
+  while (u >= 100) {
+    const char *pair = &DIGIT_PAIRS[(u % 100) * 2];
+    u /= 100;
+    *--p = pair[1];
+    *--p = pair[0];
+  }
+  if (u >= 10) {
+    *--p = DIGIT_PAIRS[u * 2 + 1];
+    *--p = DIGIT_PAIRS[u * 2];
+  }
+  else {
+    *--p = '0' + u;
+  }
+
+  memcpy(buffer + length, p, end - p);
+  return length + (end - p);
+}
+
+/*
+  A floating point value f * 2^e with a 64 bit significand, as used by
+  Grisu ("Printing Floating-Point Numbers Quickly and Accurately with
+  Integers", Loitsch 2010).
+*/
+struct DiyFp {
+  uint64_t f;
+  int e;
+};
+
+#define DOUBLE_SIGNIFICAND_SIZE 52
+#define DOUBLE_EXPONENT_BIAS (0x3FF + DOUBLE_SIGNIFICAND_SIZE)
+#define DOUBLE_HIDDEN_BIT 0x0010000000000000ull
+#define DOUBLE_SIGNIFICAND_MASK 0x000FFFFFFFFFFFFFull
+#define DOUBLE_EXPONENT_MASK 0x7FF0000000000000ull
+
+// Normalized 10^k for k = -348, -340, ..., 340
+static const uint64_t CACHED_POWERS_F[87] = {
+  0xfa8fd5a0081c0288ull, 0xbaaee17fa23ebf76ull, 0x8b16fb203055ac76ull,
+  0xcf42894a5dce35eaull, 0x9a6bb0aa55653b2dull, 0xe61acf033d1a45dfull,
+  0xab70fe17c79ac6caull, 0xff77b1fcbebcdc4full, 0xbe5691ef416bd60cull,
+  0x8dd01fad907ffc3cull, 0xd3515c2831559a83ull, 0x9d71ac8fada6c9b5ull,
+  0xea9c227723ee8bcbull, 0xaecc49914078536dull, 0x823c12795db6ce57ull,
+  0xc21094364dfb5637ull, 0x9096ea6f3848984full, 0xd77485cb25823ac7ull,
+  0xa086cfcd97bf97f4ull, 0xef340a98172aace5ull, 0xb23867fb2a35b28eull,
+  0x84c8d4dfd2c63f3bull, 0xc5dd44271ad3cdbaull, 0x936b9fcebb25c996ull,
+  0xdbac6c247d62a584ull, 0xa3ab66580d5fdaf6ull, 0xf3e2f893dec3f126ull,
+  0xb5b5ada8aaff80b8ull, 0x87625f056c7c4a8bull, 0xc9bcff6034c13053ull,
+  0x964e858c91ba2655ull, 0xdff9772470297ebdull, 0xa6dfbd9fb8e5b88full,
+  0xf8a95fcf88747d94ull, 0xb94470938fa89bcfull, 0x8a08f0f8bf0f156bull,
+  0xcdb02555653131b6ull, 0x993fe2c6d07b7facull, 0xe45c10c42a2b3b06ull,
+  0xaa242499697392d3ull, 0xfd87b5f28300ca0eull, 0xbce5086492111aebull,
+  0x8cbccc096f5088ccull, 0xd1b71758e219652cull, 0x9c40000000000000ull,
+  0xe8d4a51000000000ull, 0xad78ebc5ac620000ull, 0x813f3978f8940984ull,
+  0xc097ce7bc90715b3ull, 0x8f7e32ce7bea5c70ull, 0xd5d238a4abe98068ull,
+  0x9f4f2726179a2245ull, 0xed63a231d4c4fb27ull, 0xb0de65388cc8ada8ull,
+  0x83c7088e1aab65dbull, 0xc45d1df942711d9aull, 0x924d692ca61be758ull,
+  0xda01ee641a708deaull, 0xa26da3999aef774aull, 0xf209787bb47d6b85ull,
+  0xb454e4a179dd1877ull, 0x865b86925b9bc5c2ull, 0xc83553c5c8965d3dull,
+  0x952ab45cfa97a0b3ull, 0xde469fbd99a05fe3ull, 0xa59bc234db398c25ull,
+  0xf6c69a72a3989f5cull, 0xb7dcbf5354e9beceull, 0x88fcf317f22241e2ull,
+  0xcc20ce9bd35c78a5ull, 0x98165af37b2153dfull, 0xe2a0b5dc971f303aull,
+  0xa8d9d1535ce3b396ull, 0xfb9b7cd9a4a7443cull, 0xbb764c4ca7a44410ull,
+  0x8bab8eefb6409c1aull, 0xd01fef10a657842cull, 0x9b10a4e5e9913129ull,
+  0xe7109bfba19c0c9dull, 0xac2820d9623bf429ull, 0x80444b5e7aa7cf85ull,
+  0xbf21e44003acdd2dull, 0x8e679c2f5e44ff8full, 0xd433179d9c8cb841ull,
+  0x9e19db92b4e31ba9ull, 0xeb96bf6ebadf77d9ull, 0xaf87023b9bf0ee6bull,
+};
+
+static const int16_t CACHED_POWERS_E[87] = {
+  -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954, -927,
+  -901, -874, -847, -821, -794, -768, -741, -715, -688, -661, -635, -608,
+  -582, -555, -529, -502, -475, -449, -422, -396, -369, -343, -316, -289,
+  -263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30,
+  56, 83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+  375, 402, 428, 455, 481, 508, 534, 561, 588, 614, 641, 667,
+  694, 720, 747, 774, 800, 827, 853, 880, 907, 933, 960, 986,
+  1013, 1039, 1066,
+};
+
+static const uint64_t POWERS_OF_TEN_U64[20] = {
+  1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull,
+  10000000ull, 100000000ull, 1000000000ull, 10000000000ull,
+  100000000000ull, 1000000000000ull, 10000000000000ull,
+  100000000000000ull, 1000000000000000ull, 10000000000000000ull,
+  100000000000000000ull, 1000000000000000000ull, 10000000000000000000ull,
+};
+
+static inline struct DiyFp DiyFpFromDouble(double d) {
+  uint64_t u;
+  memcpy(&u, &d, sizeof(u));
+  int biased_e = (int)((u & DOUBLE_EXPONENT_MASK) >> DOUBLE_SIGNIFICAND_SIZE);
+  uint64_t significand = u & DOUBLE_SIGNIFICAND_MASK;
+  if (biased_e != 0) {
+    return (struct DiyFp){significand + DOUBLE_HIDDEN_BIT, biased_e - DOUBLE_EXPONENT_BIAS};
+  }
+  return (struct DiyFp){significand, 1 - DOUBLE_EXPONENT_BIAS};
+}
+
+// The upper 64 bits of the 128 bit product, rounded
+static inline struct DiyFp DiyFpMultiply(struct DiyFp x, struct DiyFp y) {
+  const uint64_t M32 = 0xFFFFFFFFull;
+  uint64_t a = x.f >> 32, b = x.f & M32, c = y.f >> 32, d = y.f & M32;
+  uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+  uint64_t tmp = (bd >> 32) + (ad & M32) + (bc & M32) + (1ull << 31);
+  return (struct DiyFp){ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), x.e + y.e + 64};
+}
+
+static inline struct DiyFp DiyFpNormalize(struct DiyFp x) {
+  int shift = __builtin_clzll(x.f);
+  return (struct DiyFp){x.f << shift, x.e - shift};
+}
+
+/*
+  The boundaries m- and m+ halfway to the neighbouring doubles, with m+
+  normalized and m- sharing its exponent.
+*/
+static inline void DiyFpBoundaries(struct DiyFp v, struct DiyFp *minus, struct DiyFp *plus) {
+  struct DiyFp pl = DiyFpNormalize((struct DiyFp){(v.f << 1) + 1, v.e - 1});
+  struct DiyFp mi = v.f == DOUBLE_HIDDEN_BIT ?
+    (struct DiyFp){(v.f << 2) - 1, v.e - 2} :
+    (struct DiyFp){(v.f << 1) - 1, v.e - 1};
+  mi.f <<= mi.e - pl.e;
+  mi.e = pl.e;
+  *minus = mi;
+  *plus = pl;
+}
+
+// Picks c = 10^-k so that the product with 2^e has an exponent in [-60, -32]
+static inline struct DiyFp CachedPower(int e, int *k) {
+  double dk = (-61 - e) * 0.30102999566398114 + 347;
+  int ik = (int)dk;
+  if (dk - ik > 0.0) {
+    ik++;
+  }
+  unsigned index = (unsigned)((ik >> 3) + 1);
+  *k = -(-348 + (int)(index << 3));
+  return (struct DiyFp){CACHED_POWERS_F[index], CACHED_POWERS_E[index]};
+}
+
+static inline int CountDigits32(uint32_t n) {
+  int digits = 1;
+  while (digits < 10 && n >= POWERS_OF_TEN_U64[digits]) {
+    digits++;
+  }
+  return digits;
+}
+
+/*
+  Moves the last digit down towards w while that brings it closer, then
+  checks that the digits are the closest of the shortest ones. Products
+  of the scaled boundaries and w are off by up to unit either way, so
+  near the edges of the interval nothing is certain and it returns 0.
+*/
+static inline int RoundWeed(char *buffer, int length, uint64_t distance_too_high_w, uint64_t unsafe_interval, uint64_t rest, uint64_t ten_kappa, uint64_t unit) {
+  uint64_t small_distance = distance_too_high_w - unit;
+  uint64_t big_distance = distance_too_high_w + unit;
+  while (
+    rest < small_distance && unsafe_interval - rest >= ten_kappa &&
+    (rest + ten_kappa < small_distance || small_distance - rest >= rest + ten_kappa - small_distance)
+  ) {
+    buffer[length - 1]--;
+    rest += ten_kappa;
+  }
+  if (
+    rest < big_distance && unsafe_interval - rest >= ten_kappa &&
+    (rest + ten_kappa < big_distance || big_distance - rest > rest + ten_kappa - big_distance)
+  ) {
+    return 0;
+  }
+  return 2 * unit <= rest && rest <= unsafe_interval - 4 * unit;
+}
+
+/*
+  Generates digits of the scaled upper boundary until they are inside the
+  interval widened by the error of the products, the unsafe interval.
+  Returns 0 when RoundWeed can't vouch for them.
+*/
+static inline int DigitGen(struct DiyFp low, struct DiyFp w, struct DiyFp high, char *buffer, int *k) {
+  uint64_t unit = 1;
+  uint64_t too_high = high.f + unit;
+  uint64_t unsafe_interval = too_high - (low.f - unit);
+  int shift = -w.e;
+  uint64_t one = 1ull << shift;
+  uint32_t integrals = (uint32_t)(too_high >> shift);
+  uint64_t fractionals = too_high & (one - 1);
+  int kappa = CountDigits32(integrals);
+  int length = 0;
+
+  // Integral part
+  while (kappa > 0) {
+    uint32_t divisor = (uint32_t)POWERS_OF_TEN_U64[kappa - 1];
+    buffer[length++] = '0' + integrals / divisor;
+    integrals %= divisor;
+    kappa--;
+    uint64_t rest = ((uint64_t)integrals << shift) + fractionals;
+    if (rest < unsafe_interval) {
+      *k += kappa;
+      return RoundWeed(buffer, length, too_high - w.f, unsafe_interval, rest, (uint64_t)divisor << shift, unit) ? length : 0;
+    }
+  }
+
+  // Fractional part
+  for (;;) {
+    fractionals *= 10;
+    unit *= 10;
+    unsafe_interval *= 10;
+    buffer[length++] = '0' + (char)(fractionals >> shift);
+    fractionals &= one - 1;
+    kappa--;
+    if (fractionals < unsafe_interval) {
+      *k += kappa;
+      return RoundWeed(buffer, length, (too_high - w.f) * unit, unsafe_interval, fractionals, one, unit) ? length : 0;
+    }
+  }
+}
+
+// Digits of a positive, finite value d = digits * 10^k, or 0 in the rare cases Grisu3 can't decide
+static inline int Grisu3(double d, char *buffer, int *k) {
+  struct DiyFp v = DiyFpFromDouble(d);
+  struct DiyFp minus, plus;
+  DiyFpBoundaries(v, &minus, &plus);
+
+  struct DiyFp c = CachedPower(plus.e, k);
+  struct DiyFp w = DiyFpMultiply(DiyFpNormalize(v), c);
+  struct DiyFp wp = DiyFpMultiply(plus, c);
+  struct DiyFp wm = DiyFpMultiply(minus, c);
+  return DigitGen(wm, w, wp, buffer, k);
+}
+
+/*
+  The fewest digits that parse back to d, found by printing it with more
+  and more precision. Slow, but only needed where Grisu3 gives up.
+*/
+static inline int ShortestDigitsExact(double d, char *buffer, int *k) {
+  char s[32];
+  for (int precision = 1; precision <= 17; precision++) {
+    snprintf(s, sizeof(s), "%.*e", precision - 1, d);
+    if (strtod(s, NULL) == d) {
+      break;
+    }
+  }
+  // d.ddde+x, with a '.' only after the first of several digits
+  char *p = s;
+  int length = 0;
+  for (; *p != 'e'; p++) {
+    if (CharIsDigit(*p)) {
+      buffer[length++] = *p;
+    }
+  }
+  *k = atoi(p + 1) - (length - 1);
+  while (length > 1 && buffer[length - 1] == '0') {
+    length--;
+    *k += 1;
+  }
+  return length;
+}
+
+static inline size_t WriteExponent(int e, char *buffer) {
+  size_t length = 0;
+  buffer[length++] = e < 0 ? '-' : '+';
+  if (e < 0) {
+    e = -e;
+  }
+  if (e >= 100) {
+    buffer[length++] = '0' + e / 100;
+    e %= 100;
+    buffer[length++] = DIGIT_PAIRS[e * 2];
+    buffer[length++] = DIGIT_PAIRS[e * 2 + 1];
+  }
+  else if (e >= 10) {
+    buffer[length++] = DIGIT_PAIRS[e * 2];
+    buffer[length++] = DIGIT_PAIRS[e * 2 + 1];
+  }
+  else {
+    buffer[length++] = '0' + e;
+  }
+  return length;
+}
+
+// Lays out digits * 10^k the way JavaScript's Number.prototype.toString does
+static inline size_t Prettify(char *buffer, int length, int k) {
+  int kk = length + k;  // 10^(kk - 1) <= v < 10^kk
+
+  if (k >= 0 && kk <= 21) {
+    // 1234e7 -> 12340000000
+    memset(buffer + length, '0', k);
+    return kk;
+  }
+  if (kk > 0 && kk <= 21) {
+    // 1234e-2 -> 12.34
+    memmove(buffer + kk + 1, buffer + kk, length - kk);
+    buffer[kk] = '.';
+    return length + 1;
+  }
+  if (kk > -6 && kk <= 0) {
+    // 1234e-6 -> 0.001234
+    int offset = 2 - kk;
+    memmove(buffer + offset, buffer, length);
+    buffer[0] = '0';
+    buffer[1] = '.';
+    memset(buffer + 2, '0', offset - 2);
+    return length + offset;
+  }
+  if (length == 1) {
+    // 1e30
+    buffer[1] = 'e';
+    return 2 + WriteExponent(kk - 1, buffer + 2);
+  }
+  // 1234e30 -> 1.234e+33
+  memmove(buffer + 2, buffer + 1, length - 1);
+  buffer[1] = '.';
+  buffer[length + 1] = 'e';
+  return length + 2 + WriteExponent(kk - 1, buffer + length + 2);
+}
+
+inline size_t FormatDouble(double value, char *buffer) {
+  if (isnan(value) || isinf(value)) {
+    memcpy(buffer, "null", 4);
+    return 4;
+  }
+
+  size_t length = 0;
+  if (signbit(value)) {
+    buffer[length++] = '-';
+    value = -value;
+  }
+  if (value == 0) {
+    buffer[length++] = '0';
+    return length;
+  }
+
+  int k;
+  int digits = Grisu3(value, buffer + length, &k);
+  if (digits == 0) {
+    digits = ShortestDigitsExact(value, buffer + length, &k);
+  }
+  return length + Prettify(buffer + length, digits, k);
+}
+
+inline void StringBuilderAddInteger(struct StringBuilder *sb, int64_t value) {
+  StringBuilderReserve(sb, FORMAT_NUMBER_MAX_LENGTH);
+  sb->length += FormatInteger(value, sb->string + sb->length);
+  sb->string[sb->length] = '\0';
+}
+
+inline void StringBuilderAddDouble(struct StringBuilder *sb, double value) {
+  StringBuilderReserve(sb, FORMAT_NUMBER_MAX_LENGTH);
+  sb->length += FormatDouble(value, sb->string + sb->length);
+  sb->string[sb->length] = '\0';
+}
+
+// Bytes that cannot be copied into a JSON string as they are: 1 for ASCII, 2 for UTF-8
+static const unsigned char JSON_SPECIAL[256] = {
+  [0x00 ... 0x1F] = 1,
+  ['"'] = 1,
+  ['\\'] = 1,
+  [0x80 ... 0xFF] = 2,
+};
+
+static const char HEX_DIGITS[16] = "0123456789abcdef";
+
+#define BYTES_01 0x0101010101010101ull
+#define BYTES_80 0x8080808080808080ull
+
+/*
+  Sets the high bit of each byte of x that is below 0x20, above 0x7F, a
+  quote or a backslash. Borrows can mark bytes after the first special
+  one, so only the lowest set bit is exact.
+*/
+static inline uint64_t JSONSpecialBytes(uint64_t x) {
+  uint64_t quote = x ^ (BYTES_01 * '"');
+  uint64_t backslash = x ^ (BYTES_01 * '\\');
+  return (
+    ((x - BYTES_01 * 0x20) & ~x) |
+    ((quote - BYTES_01) & ~quote) |
+    ((backslash - BYTES_01) & ~backslash) |
+    x
+  ) & BYTES_80;
+}
+
+// Number of leading bytes of s that need no escaping
+static inline size_t JSONPlainLength(const char *s, size_t length) {
+  size_t i = 0;
+#if defined(__AVX2__)
+  for (; i + 32 <= length; i += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)(s + i));
+    // Signed comparison: bytes >= 0x80 are negative and count as below 0x20
+    __m256i special = _mm256_or_si256(
+      _mm256_cmpgt_epi8(_mm256_set1_epi8(0x20), v),
+      _mm256_or_si256(
+        _mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')),
+        _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))
+      )
+    );
+    uint32_t mask = (uint32_t)_mm256_movemask_epi8(special);
+    if (mask != 0) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+#elif defined(__SSE2__)
+  for (; i + 16 <= length; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(s + i));
+    __m128i special = _mm_or_si128(
+      _mm_cmplt_epi8(v, _mm_set1_epi8(0x20)),
+      _mm_or_si128(
+        _mm_cmpeq_epi8(v, _mm_set1_epi8('"')),
+        _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))
+      )
+    );
+    uint32_t mask = (uint32_t)_mm_movemask_epi8(special);
+    if (mask != 0) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+#endif
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  // Eight bytes at a time in a word for the tail and on other targets
+  for (; i + 8 <= length; i += 8) {
+    uint64_t x;
+    memcpy(&x, s + i, sizeof(x));
+    uint64_t special = JSONSpecialBytes(x);
+    if (special != 0) {
+      return i + __builtin_ctzll(special) / 8;
+    }
+  }
+#endif
+  while (i < length && !JSON_SPECIAL[(unsigned char)s[i]]) {
+    i++;
+  }
+  return i;
+}
+
+static inline int UTF8IsContinuation(unsigned char c) {
+  return (c & 0xC0) == 0x80;
+}
+
+/*
+  Length of the UTF-8 sequence at s. Sets valid when it is well formed
+  (RFC 3629), otherwise the length covers the longest prefix that could
+  have started a valid sequence, which is replaced as a single U+FFFD.
+*/
+static inline size_t UTF8SequenceLength(const unsigned char *s, size_t length, int *valid) {
+  unsigned char lo = 0x80, hi = 0xBF;
+  size_t n;
+
+  *valid = 0;
+  switch (s[0]) {
+    case 0xC2 ... 0xDF: n = 2; break;
+    case 0xE0: n = 3; lo = 0xA0; break;
+    case 0xE1 ... 0xEC: n = 3; break;
+    case 0xED: n = 3; hi = 0x9F; break;  // No UTF-16 surrogates
+    case 0xEE ... 0xEF: n = 3; break;
+    case 0xF0: n = 4; lo = 0x90; break;
+    case 0xF1 ... 0xF3: n = 4; break;
+    case 0xF4: n = 4; hi = 0x8F; break;  // Nothing above U+10FFFF
+    default: return 1;
+  }
+  if (length < 2 || s[1] < lo || s[1] > hi) {
+    return 1;
+  }
+  for (size_t i = 2; i < n; i++) {
+    if (i >= length || !UTF8IsContinuation(s[i])) {
+      return i;
+    }
+  }
+  *valid = 1;
+  return n;
+}
+
+static inline void StringBuilderAddBytes(struct StringBuilder *sb, const char *s, size_t length) {
+  StringBuilderReserve(sb, length);
+  memcpy(sb->string + sb->length, s, length);
+  sb->length += length;
+}
+
+static inline void StringBuilderAddEscape(struct StringBuilder *sb, unsigned char c) {
+  char escape[6] = {'\\', 0};
+  size_t length = 2;
+  switch (c) {
+    case '"': escape[1] = '"'; break;
+    case '\\': escape[1] = '\\'; break;
+    case '\b': escape[1] = 'b'; break;
+    case '\f': escape[1] = 'f'; break;
+    case '\n': escape[1] = 'n'; break;
+    case '\r': escape[1] = 'r'; break;
+    case '\t': escape[1] = 't'; break;
+    default:
+      memcpy(escape + 1, "u00", 3);
+      escape[4] = HEX_DIGITS[c >> 4];
+      escape[5] = HEX_DIGITS[c & 0xF];
+      length = 6;
+  }
+  StringBuilderAddBytes(sb, escape, length);
+}
+
+inline void StringBuilderAddJSONString(struct StringBuilder *sb, const char *s, size_t length) {
+  // Most strings need no escaping and go out with a single copy
+  size_t i = JSONPlainLength(s, length);
+  StringBuilderReserve(sb, i + 2);
+  sb->string[sb->length++] = '"';
+  memcpy(sb->string + sb->length, s, i);
+  sb->length += i;
+
+  while (i < length) {
+    unsigned char c = s[i];
+    if (JSON_SPECIAL[c] == 1) {
+      StringBuilderAddEscape(sb, c);
+      i++;
+    }
+    else {
+      int valid;
+      size_t n = UTF8SequenceLength((const unsigned char*)s + i, length - i, &valid);
+      if (valid) {
+        StringBuilderAddBytes(sb, s + i, n);
+      }
+      else {
+        StringBuilderAddBytes(sb, "\xEF\xBF\xBD", 3);
+      }
+      i += n;
+    }
+
+    size_t plain = JSONPlainLength(s + i, length - i);
+    StringBuilderAddBytes(sb, s + i, plain);
+    i += plain;
+  }
+
+  StringBuilderReserve(sb, 1);
+  sb->string[sb->length++] = '"';
+  sb->string[sb->length] = '\0';
+}
+
+// Number of leading ASCII bytes of s
+static inline size_t ASCIILength(const char *s, size_t length) {
+  size_t i = 0;
+  for (; i + 8 <= length; i += 8) {
+    uint64_t x;
+    memcpy(&x, s + i, sizeof(x));
+    if ((x & BYTES_80) != 0) {
+      break;
+    }
+  }
+  while (i < length && (unsigned char)s[i] < 0x80) {
+    i++;
+  }
+  return i;
+}
+
+inline size_t UTF8ReplacedLength(const char *s, size_t length, int *valid) {
+  size_t i = ASCIILength(s, length), replaced = i;
+  *valid = 1;
+  while (i < length) {
+    int sequence_valid;
+    size_t n = UTF8SequenceLength((const unsigned char*)s + i, length - i, &sequence_valid);
+    replaced += sequence_valid ? n : 3;
+    *valid &= sequence_valid;
+    i += n;
+    size_t plain = ASCIILength(s + i, length - i);
+    replaced += plain;
+    i += plain;
+  }
+  return replaced;
+}
+
+inline void StringBuilderAddUTF8(struct StringBuilder *sb, const char *s, size_t length) {
+  size_t i = ASCIILength(s, length);
+  StringBuilderAddBytes(sb, s, i);
+  while (i < length) {
+    int valid;
+    size_t n = UTF8SequenceLength((const unsigned char*)s + i, length - i, &valid);
+    if (valid) {
+      StringBuilderAddBytes(sb, s + i, n);
+    }
+    else {
+      StringBuilderAddBytes(sb, "\xEF\xBF\xBD", 3);
+    }
+    i += n;
+    size_t plain = ASCIILength(s + i, length - i);
+    StringBuilderAddBytes(sb, s + i, plain);
+    i += plain;
+  }
+  sb->string[sb->length] = '\0';
+}
@@ -0,0 +1,55 @@
+#ifndef FORMAT_H
+#define FORMAT_H
+
+#ifndef _INC_MATH
+#include <math.h>
+#endif
+
+#include "util.h"
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// The longest output is a double like -0.0000012345678901234567 (25 characters)
+#define FORMAT_NUMBER_MAX_LENGTH 32
+
+/*
+  Writes the decimal form of an integer into buffer two digits at a time
+  and returns the number of characters written. No terminator is added.
+*/
+size_t FormatInteger(int64_t value, char *buffer);
+
+/*
+  Writes the shortest decimal form of a double that parses back to the
+  same value, the closest to it of those, without a terminator, and
+  returns its length. Grisu3 finds it for almost every value, the rest
+  are found by an exact search.
+  Integral values below 1e21 are written without a fraction or exponent,
+  small and large ones as 1.5e-7 / 1.5e+21. NaN and infinities have no
+  JSON form and are written as null.
+*/
+size_t FormatDouble(double value, char *buffer);
+
+/*
+  Appends s as a quoted JSON string. Quotes, backslashes and control
+  characters are escaped, valid UTF-8 is copied as is and every byte
+  that is not part of a valid sequence is replaced with U+FFFD. Runs of
+  plain ASCII are found 32 (AVX2) or 16 (SSE2) bytes at a time and
+  copied in one go.
+*/
+void StringBuilderAddJSONString(struct StringBuilder *sb, const char *s, size_t length);
+
+/*
+  Length of s once every byte that is not part of a valid UTF-8 sequence
+  is replaced with U+FFFD, the way StringBuilderAddJSONString does it.
+  Sets valid when nothing needs replacing. StringBuilderAddUTF8 appends
+  s with those replacements.
+*/
+size_t UTF8ReplacedLength(const char *s, size_t length, int *valid);
+void StringBuilderAddUTF8(struct StringBuilder *sb, const char *s, size_t length);
+
+void StringBuilderAddInteger(struct StringBuilder *sb, int64_t value);
+void StringBuilderAddDouble(struct StringBuilder *sb, double value);
+
+#endif
@@ -0,0 +1,758 @@
+#include "image.h"
+
+static inline void ImageAddBytes(struct StringBuilder *sb, const void *bytes, size_t length) {
+  StringBuilderReserve(sb, length);
+  memcpy(sb->string + sb->length, bytes, length);
+  sb->length += length;
+}
+
+static inline void ImagePutU32(struct StringBuilder *sb, size_t at, uint32_t value) {
+  for (size_t i = 0; i < 4; i++) {
+    sb->string[at + i] = (char)(value >> (i * 8));
+  }
+}
+
+static inline void ImageAddU32(struct StringBuilder *sb, uint32_t value) {
+  StringBuilderReserve(sb, 4);
+  ImagePutU32(sb, sb->length, value);
+  sb->length += 4;
+}
+
+static inline void ImageAddU64(struct StringBuilder *sb, uint64_t value) {
+  ImageAddU32(sb, (uint32_t)value);
+  ImageAddU32(sb, (uint32_t)(value >> 32));
+}
+
+static inline void ImageAddVarint(struct StringBuilder *sb, uint64_t value) {
+  char bytes[10];
+  size_t length = 0;
+  while (value >= 0x80) {
+    bytes[length++] = (char)(value | 0x80);
+    value >>= 7;
+  }
+  bytes[length++] = (char)value;
+  ImageAddBytes(sb, bytes, length);
+}
+
+static inline uint64_t ImageDoubleBits(double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+static inline uint32_t ImageU32(const struct SDF_Image *image, size_t at) {
+  if (at > image->length || image->length - at < 4) {
+    return 0;
+  }
+  const unsigned char *p = (const unsigned char*)image->data + at;
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline unsigned char ImageByte(const struct SDF_Image *image, size_t at) {
+  return at < image->length ? image->data[at] : 0;
+}
+
+static inline uint64_t ImageU64(const struct SDF_Image *image, size_t at) {
+  return ImageU32(image, at) | ((uint64_t)ImageU32(image, at + 4) << 32);
+}
+
+// Reads the varint at *at and moves past it. Running off the end gives 0 and leaves *at there
+static inline uint64_t ImageVarint(const struct SDF_Image *image, size_t *at) {
+  uint64_t value = 0;
+  for (size_t shift = 0; shift < 64 && *at < image->length; shift += 7) {
+    unsigned char byte = image->data[(*at)++];
+    value |= (uint64_t)(byte & 0x7f) << shift;
+    if (byte < 0x80) {
+      return value;
+    }
+  }
+  *at = image->length;
+  return 0;
+}
+
+// The bytes of the string at offset, or NULL if it isn't a whole string
+static inline const char* ImageString(const struct SDF_Image *image, size_t offset, size_t *length) {
+  if (offset >= image->length || image->data[offset] != SIT_STRING) {
+    return NULL;
+  }
+  size_t at = offset + 1;
+  size_t n = ImageVarint(image, &at);
+  // The '\0' after the bytes must be there too, as strings are also used as C strings
+  if (at >= image->length || image->length - at <= n || image->data[at + n] != '\0') {
+    return NULL;
+  }
+  *length = n;
+  return image->data + at;
+}
+
+static inline int ImageStringEquals(const struct SDF_Image *image, size_t offset, const char *s, size_t length) {
+  size_t n;
+  const char *candidate = ImageString(image, offset, &n);
+  return candidate != NULL && n == length && memcmp(candidate, s, length) == 0;
+}
+
+// Offsets count from the start of the image, not of the builder it is written to
+static inline size_t ImageWriterOffset(struct SDF_ImageWriter *w) {
+  return w->out->length - w->base;
+}
+
+static inline int ImageOverflows(struct SDF_ImageWriter *w) {
+  return ImageWriterOffset(w) > UINT32_MAX;
+}
+
+// Adds the string unless the image has it already, and returns its offset
+static uint32_t SDFImageWriterAddString(struct SDF_ImageWriter *w, const char *s, size_t length) {
+  uint32_t hash = HashString((char*)s, length);
+  size_t mask = w->string_capacity - 1;
+  size_t i = hash & mask;
+  for (; w->strings[i].position != 0; i = (i + 1) & mask) {
+    struct SDF_KeySlot slot = w->strings[i];
+    if (slot.hash == hash) {
+      size_t at = slot.position + 1;
+      size_t n = 0;
+      for (size_t shift = 0;; shift += 7) {
+        unsigned char byte = w->out->string[w->base + at++];
+        n |= (size_t)(byte & 0x7f) << shift;
+        if (byte < 0x80) {
+          break;
+        }
+      }
+      if (n == length && memcmp(w->out->string + w->base + at, s, length) == 0) {
+        return slot.position;
+      }
+    }
+  }
+
+  uint32_t offset = ImageWriterOffset(w);
+  StringBuilderAddChar(w->out, SIT_STRING);
+  ImageAddVarint(w->out, length);
+  ImageAddBytes(w->out, s, length);
+  StringBuilderAddChar(w->out, '\0');
+  if (ImageOverflows(w)) {
+    return 0;
+  }
+
+  w->strings[i] = (struct SDF_KeySlot) {
+    .hash = hash,
+    .position = offset,
+  };
+  w->string_count += 1;
+  if (w->string_count * 2 > w->string_capacity) {
+    size_t capacity = w->string_capacity << 1;
+    struct SDF_KeySlot *strings = calloc(capacity, sizeof(struct SDF_KeySlot));
+    for (size_t j = 0; j < w->string_capacity; j++) {
+      struct SDF_KeySlot slot = w->strings[j];
+      if (slot.position != 0) {
+        size_t k = slot.hash & (capacity - 1);
+        while (strings[k].position != 0) {
+          k = (k + 1) & (capacity - 1);
+        }
+        strings[k] = slot;
+      }
+    }
+    free(w->strings);
+    w->strings = strings;
+    w->string_capacity = capacity;
+  }
+  return offset;
+}
+
+static uint32_t SDFImageWriterAddValue(struct SDF_ImageWriter *w, struct ParserValue *pv);
+
+static uint32_t SDFImageWriterAddEntries(struct SDF_ImageWriter *w, uint32_t *entries, size_t count) {
+  size_t slots = 0;
+  struct SDF_KeySlot *index = NULL;
+  if (count > SDF_OBJECT_INDEX_THRESHOLD) {
+    slots = SDF_OBJECT_INDEX_THRESHOLD * 4;
+    while (count * 2 > slots) {
+      slots <<= 1;
+    }
+    index = calloc(slots, sizeof(struct SDF_KeySlot));
+    for (size_t i = 0; i < count; i++) {
+      size_t length = 0;
+      struct SDF_Image image = {
+        .data = w->out->string + w->base,
+        .length = ImageWriterOffset(w),
+      };
+      const char *key = ImageString(&image, entries[i * 2], &length);
+      uint32_t hash = key != NULL ? HashString((char*)key, length) : 0;
+      size_t j = hash & (slots - 1);
+      while (index[j].position != 0) {
+        j = (j + 1) & (slots - 1);
+      }
+      index[j] = (struct SDF_KeySlot) {
+        .hash = hash,
+        .position = i + 1,
+      };
+    }
+  }
+
+  uint32_t offset = ImageWriterOffset(w);
+  StringBuilderAddChar(w->out, SIT_OBJECT);
+  ImageAddVarint(w->out, count);
+  ImageAddVarint(w->out, slots);
+  for (size_t i = 0; i < count * 2; i++) {
+    ImageAddU32(w->out, entries[i]);
+  }
+  for (size_t i = 0; i < slots; i++) {
+    ImageAddU32(w->out, index[i].hash);
+    ImageAddU32(w->out, index[i].position);
+  }
+  free(index);
+  return offset;
+}
+
+static uint32_t SDFImageWriterAddObject(struct SDF_ImageWriter *w, struct SDF_Object *o) {
+  size_t count = o->keys->length;
+  uint32_t *entries = malloc(sizeof(uint32_t) * 2 * (count + 1));
+  for (size_t i = 0; i < count; i++) {
+    char *key = o->keys->items[i];
+    entries[i * 2] = SDFImageWriterAddString(w, key, strlen(key));
+    entries[i * 2 + 1] = SDFImageWriterAddValue(w, &(o->values->items[i]));
+  }
+  uint32_t offset = SDFImageWriterAddEntries(w, entries, count);
+  free(entries);
+  return offset;
+}
+
+static uint32_t SDFImageWriterAddRow(struct SDF_ImageWriter *w, struct SDF_Row *r) {
+  size_t count = SDFTableRowLength(r->table, r->index);
+  uint32_t *entries = malloc(sizeof(uint32_t) * 2 * (count + 1));
+  for (size_t i = 0; i < count; i++) {
+    char *key = r->table->schema->items[i];
+    struct ParserValue pv;
+    SDFTableGetField(r->table, r->index, i, &pv);
+    entries[i * 2] = SDFImageWriterAddString(w, key, strlen(key));
+    entries[i * 2 + 1] = SDFImageWriterAddValue(w, &pv);
+  }
+  uint32_t offset = SDFImageWriterAddEntries(w, entries, count);
+  free(entries);
+  return offset;
+}
+
+// Integer columns use the narrowest width that holds all of their cells
+static inline size_t ImageCellSize(struct SDF_Table *t, size_t field) {
+  struct SDF_Column *c = &(t->columns[field]);
+  if (c->data.as_value == NULL) {
+    return 1;
+  }
+  switch (c->type) {
+    case SCT_INTEGER: {
+      size_t size = 1;
+      for (size_t i = 0; i < t->rows && size < 8; i++) {
+        int64_t value = field < SDFTableRowLength(t, i) ? c->data.as_integer[i] : 0;
+        while (size < 8 && (value < -(INT64_C(1) << (size * 8 - 1)) || value >= (INT64_C(1) << (size * 8 - 1)))) {
+          size <<= 1;
+        }
+      }
+      return size;
+    }
+    case SCT_DOUBLE:
+      return 8;
+    default:
+      return 4;
+  }
+}
+
+static uint32_t SDFImageWriterAddTable(struct SDF_ImageWriter *w, struct SDF_Table *t) {
+  size_t fields = t->schema->length;
+  // Keys, then the strings and values the cells point to, for every column
+  uint32_t *offsets = malloc(sizeof(uint32_t) * (fields * (t->rows + 1) + 1));
+  for (size_t i = 0; i < fields; i++) {
+    char *key = t->schema->items[i];
+    offsets[i] = SDFImageWriterAddString(w, key, strlen(key));
+  }
+  for (size_t i = 0; i < fields; i++) {
+    struct SDF_Column *c = &(t->columns[i]);
+    uint32_t *cells = &(offsets[fields + i * t->rows]);
+    for (size_t j = 0; j < t->rows; j++) {
+      cells[j] = 0;
+      if (c->data.as_value == NULL || i >= SDFTableRowLength(t, j)) {
+        continue;
+      }
+      if (c->type == SCT_STRING) {
+        cells[j] = SDFImageWriterAddString(w, c->data.as_string[j], strlen(c->data.as_string[j]));
+      }
+      else if (c->type == SCT_VALUE) {
+        cells[j] = SDFImageWriterAddValue(w, &(c->data.as_value[j]));
+      }
+    }
+  }
+
+  uint32_t offset = ImageWriterOffset(w);
+  StringBuilderAddChar(w->out, SIT_TABLE);
+  ImageAddVarint(w->out, t->rows);
+  ImageAddVarint(w->out, t->last_row_length);
+  ImageAddVarint(w->out, fields);
+  for (size_t i = 0; i < fields; i++) {
+    ImageAddU32(w->out, offsets[i]);
+  }
+  // Columns follow the offset table, so their positions are known up front
+  size_t *sizes = malloc(sizeof(size_t) * (fields + 1));
+  size_t column = ImageWriterOffset(w) + fields * 4;
+  for (size_t i = 0; i < fields; i++) {
+    sizes[i] = ImageCellSize(t, i);
+    ImageAddU32(w->out, column);
+    column += 2 + t->rows * sizes[i];
+  }
+  for (size_t i = 0; i < fields; i++) {
+    struct SDF_Column *c = &(t->columns[i]);
+    enum SDF_ColumnType type = c->data.as_value != NULL ? c->type : SCT_INTEGER;
+    StringBuilderAddChar(w->out, type);
+    StringBuilderAddChar(w->out, sizes[i]);
+    StringBuilderReserve(w->out, t->rows * sizes[i]);
+    for (size_t j = 0; j < t->rows; j++) {
+      int filled = c->data.as_value != NULL && i < SDFTableRowLength(t, j);
+      uint64_t cell;
+      switch (type) {
+        case SCT_INTEGER:
+          cell = filled ? (uint64_t)c->data.as_integer[j] : 0;
+          break;
+        case SCT_DOUBLE:
+          cell = filled ? ImageDoubleBits(c->data.as_double[j]) : 0;
+          break;
+        default:
+          cell = offsets[fields + i * t->rows + j];
+          break;
+      }
+      for (size_t k = 0; k < sizes[i]; k++) {
+        w->out->string[w->out->length++] = (char)(cell >> (k * 8));
+      }
+    }
+  }
+  free(sizes);
+  free(offsets);
+  return offset;
+}
+
+static uint32_t SDFImageWriterAddList(struct SDF_ImageWriter *w, struct SDF_List *l) {
+  if (l->table != NULL) {
+    return SDFImageWriterAddTable(w, l->table);
+  }
+  size_t count = l->items->length;
+  uint32_t *items = malloc(sizeof(uint32_t) * (count + 1));
+  for (size_t i = 0; i < count; i++) {
+    items[i] = SDFImageWriterAddValue(w, &(l->items->items[i]));
+  }
+  uint32_t offset = ImageWriterOffset(w);
+  StringBuilderAddChar(w->out, SIT_LIST);
+  ImageAddVarint(w->out, count);
+  for (size_t i = 0; i < count; i++) {
+    ImageAddU32(w->out, items[i]);
+  }
+  free(items);
+  return offset;
+}
+
+// Children are written before their parent, which refers to them by offset
+static uint32_t SDFImageWriterAddValue(struct SDF_ImageWriter *w, struct ParserValue *pv) {
+  uint32_t offset = ImageWriterOffset(w);
+  switch (pv->type) {
+    case PVT_STRING:
+      return SDFImageWriterAddString(w, pv->data.as_string, strlen(pv->data.as_string));
+    case PVT_INTEGER: {
+      int64_t i = pv->data.as_integer;
+      StringBuilderAddChar(w->out, SIT_INTEGER);
+      ImageAddVarint(w->out, ((uint64_t)i << 1) ^ (uint64_t)(i >> 63));
+      return offset;
+    }
+    case PVT_DOUBLE:
+      StringBuilderAddChar(w->out, SIT_DOUBLE);
+      ImageAddU64(w->out, ImageDoubleBits(pv->data.as_double));
+      return offset;
+    case PVT_OBJECT:
+      return SDFImageWriterAddObject(w, &(pv->data.as_object));
+    case PVT_LIST:
+      return SDFImageWriterAddList(w, &(pv->data.as_list));
+    case PVT_ROW:
+      return SDFImageWriterAddRow(w, &(pv->data.as_row));
+    default:
+      return 0;
+  }
+}
+
+inline int CompileSDFObject(struct SDF_Object *o, struct StringBuilder *sb) {
+  const size_t capacity = 1024;
+  struct SDF_ImageWriter w = {
+    .out = sb,
+    .base = sb->length,
+    .strings = calloc(capacity, sizeof(struct SDF_KeySlot)),
+    .string_capacity = capacity,
+  };
+  ImageAddBytes(sb, SDF_IMAGE_MAGIC, 4);
+  ImageAddU32(sb, SDF_IMAGE_VERSION);
+  ImageAddU64(sb, 0);
+  uint32_t root = SDFImageWriterAddObject(&w, o);
+  free(w.strings);
+  if (ImageOverflows(&w)) {
+    sb->length = w.base;
+    sb->string[sb->length] = '\0';
+    return 0;
+  }
+  ImagePutU32(sb, w.base + 8, root);
+  ImagePutU32(sb, w.base + 12, ImageWriterOffset(&w));
+  return 1;
+}
+
+inline int CompileSDFFile(const char *input_path, const char *output_path) {
+  struct FileBuffer fb;
+  if (!OpenFileBuffer(input_path, &fb)) {
+    fprintf(stderr, "Error! Failed to open file: %s\n", input_path);
+    return 0;
+  }
+  struct TokenIterator ti = CreateBufferTokenIterator(fb.data, fb.length);
+  struct Arena a = CreateArena();
+  struct SDF_Object o = ParseObject(&ti, &a);
+  struct StringBuilder sb = CreateStringBuilder();
+  int ok = CompileSDFObject(&o, &sb);
+  FreeArena(&a);
+  CloseFileBuffer(&fb);
+  if (!ok) {
+    fprintf(stderr, "Error! Compiled image of %s is larger than 4 GiB\n", input_path);
+    free(sb.string);
+    return 0;
+  }
+
+  FILE *f = fopen(output_path, "wb");
+  if (f == NULL || fwrite(sb.string, sizeof(char), sb.length, f) != sb.length) {
+    fprintf(stderr, "Error! Failed to write file: %s\n", output_path);
+    ok = 0;
+  }
+  if (f != NULL && fclose(f) != 0) {
+    ok = 0;
+  }
+  free(sb.string);
+  return ok;
+}
+
+inline int IsSDFImage(const char *data, size_t length) {
+  return length >= SDF_IMAGE_HEADER_SIZE && memcmp(data, SDF_IMAGE_MAGIC, 4) == 0;
+}
+
+// The image is used in place and data must outlive it
+inline int LoadSDFImage(const char *data, size_t length, struct SDF_Image *image) {
+  *image = (struct SDF_Image) {
+    .data = data,
+    .length = length,
+  };
+  if (!IsSDFImage(data, length)
+      || ImageU32(image, 4) != SDF_IMAGE_VERSION
+      || ImageU32(image, 12) != length) {
+    return 0;
+  }
+  image->root = ImageU32(image, 8);
+  struct SDF_ImageValue root;
+  return SDFImageRoot(image, &root);
+}
+
+inline int OpenSDFImage(const char *file_path, struct SDF_Image *image) {
+  struct FileBuffer fb;
+  if (!OpenFileBuffer(file_path, &fb)) {
+    return 0;
+  }
+  if (!LoadSDFImage(fb.data, fb.length, image)) {
+    CloseFileBuffer(&fb);
+    return 0;
+  }
+#ifndef _WIN32
+  // Lookups jump around the file rather than reading it front to back
+  if (fb.is_mapped) {
+    madvise(fb.data, fb.length, MADV_RANDOM);
+  }
+#endif
+  image->fb = fb;
+  return 1;
+}
+
+inline void CloseSDFImage(struct SDF_Image *image) {
+  if (image->fb.data != NULL) {
+    CloseFileBuffer(&(image->fb));
+  }
+  *image = (struct SDF_Image) {};
+}
+
+// Values only refer to values before them, which keeps a damaged image from looping
+static inline int SDFImageValueAt(const struct SDF_Image *image, size_t offset, size_t limit, struct SDF_ImageValue *v) {
+  if (offset < SDF_IMAGE_HEADER_SIZE || offset >= limit || offset >= image->length) {
+    return 0;
+  }
+  *v = (struct SDF_ImageValue) {
+    .image = image,
+    .offset = offset,
+  };
+  size_t at = offset + 1;
+  switch (image->data[offset]) {
+    case SIT_STRING:
+      v->type = PVT_STRING;
+      break;
+    case SIT_INTEGER: {
+      uint64_t u = ImageVarint(image, &at);
+      v->type = PVT_INTEGER;
+      v->data.as_integer = (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+      break;
+    }
+    case SIT_DOUBLE: {
+      uint64_t bits = ImageU64(image, at);
+      v->type = PVT_DOUBLE;
+      memcpy(&(v->data.as_double), &bits, sizeof(bits));
+      break;
+    }
+    case SIT_OBJECT:
+      v->type = PVT_OBJECT;
+      break;
+    case SIT_LIST:
+    case SIT_TABLE:
+      v->type = PVT_LIST;
+      break;
+    default:
+      return 0;
+  }
+  return 1;
+}
+
+inline int SDFImageRoot(const struct SDF_Image *image, struct SDF_ImageValue *v) {
+  return SDFImageValueAt(image, image->root, image->length, v) && v->type == PVT_OBJECT;
+}
+
+struct SDF_ImageTable {
+  size_t offset;
+  size_t rows, last_row_length, fields;
+  size_t keys; // Offset of the key offsets, followed by the column offsets
+};
+
+static inline struct SDF_ImageTable ImageTable(const struct SDF_Image *image, size_t offset) {
+  struct SDF_ImageTable t = {
+    .offset = offset,
+  };
+  size_t at = offset + 1;
+  t.rows = ImageVarint(image, &at);
+  t.last_row_length = ImageVarint(image, &at);
+  t.fields = ImageVarint(image, &at);
+  t.keys = at;
+  return t;
+}
+
+static inline size_t ImageTableRowLength(struct SDF_ImageTable *t, size_t row) {
+  size_t length = row + 1 == t->rows ? t->last_row_length : t->fields;
+  return length < t->fields ? length : t->fields;
+}
+
+// Cells of integer and double columns are stored inline, the rest point to values
+static inline int ImageTableGetField(const struct SDF_Image *image, struct SDF_ImageTable *t, size_t row, size_t field, struct SDF_ImageValue *v) {
+  if (row >= t->rows || field >= ImageTableRowLength(t, row)) {
+    return 0;
+  }
+  size_t column = ImageU32(image, t->keys + (t->fields + field) * 4);
+  if (column == 0 || column >= image->length) {
+    return 0;
+  }
+  enum SDF_ColumnType type = image->data[column];
+  size_t size = ImageByte(image, column + 1);
+  size_t cell = column + 2 + row * size;
+  if (size == 0 || size > 8 || cell > image->length || image->length - cell < size) {
+    return 0;
+  }
+  uint64_t bits = 0;
+  for (size_t i = 0; i < size; i++) {
+    bits |= (uint64_t)(unsigned char)image->data[cell + i] << (i * 8);
+  }
+  switch (type) {
+    case SCT_INTEGER:
+    case SCT_DOUBLE: {
+      *v = (struct SDF_ImageValue) {
+        .image = image,
+        .offset = cell,
+      };
+      if (type == SCT_INTEGER) {
+        // Sign extend narrow cells
+        int shift = 64 - size * 8;
+        v->type = PVT_INTEGER;
+        v->data.as_integer = (int64_t)(bits << shift) >> shift;
+      }
+      else {
+        v->type = PVT_DOUBLE;
+        memcpy(&(v->data.as_double), &bits, sizeof(bits));
+      }
+      return 1;
+    }
+    default:
+      return SDFImageValueAt(image, bits, t->offset, v);
+  }
+}
+
+inline size_t SDFImageValueLength(struct SDF_ImageValue *v) {
+  const struct SDF_Image *image = v->image;
+  size_t at = v->offset + 1;
+  switch (v->type) {
+    case PVT_STRING:
+    case PVT_OBJECT:
+      return ImageVarint(image, &at);
+    case PVT_LIST:
+      if (image->data[v->offset] == SIT_TABLE) {
+        return ImageTable(image, v->offset).rows;
+      }
+      return ImageVarint(image, &at);
+    case PVT_ROW: {
+      struct SDF_ImageTable t = ImageTable(image, v->offset);
+      return ImageTableRowLength(&t, v->data.row);
+    }
+    default:
+      return 0;
+  }
+}
+
+inline int SDFImageValueGetEntry(struct SDF_ImageValue *v, size_t i, const char **key, size_t *key_length, struct SDF_ImageValue *result) {
+  const struct SDF_Image *image = v->image;
+  size_t key_offset;
+  if (v->type == PVT_OBJECT) {
+    size_t at = v->offset + 1;
+    size_t count = ImageVarint(image, &at);
+    ImageVarint(image, &at);
+    if (i >= count) {
+      return 0;
+    }
+    key_offset = ImageU32(image, at + i * 8);
+    if (!SDFImageValueAt(image, ImageU32(image, at + i * 8 + 4), v->offset, result)) {
+      return 0;
+    }
+  }
+  else if (v->type == PVT_ROW) {
+    struct SDF_ImageTable t = ImageTable(image, v->offset);
+    if (!ImageTableGetField(image, &t, v->data.row, i, result)) {
+      return 0;
+    }
+    key_offset = ImageU32(image, t.keys + i * 4);
+  }
+  else {
+    return 0;
+  }
+  *key = ImageString(image, key_offset, key_length);
+  return *key != NULL;
+}
+
+inline int SDFImageValueGet(struct SDF_ImageValue *v, const char *key, size_t length, struct SDF_ImageValue *result) {
+  const struct SDF_Image *image = v->image;
+  if (v->type == PVT_ROW) {
+    struct SDF_ImageTable t = ImageTable(image, v->offset);
+    for (size_t i = 0; i < t.fields; i++) {
+      if (ImageStringEquals(image, ImageU32(image, t.keys + i * 4), key, length)) {
+        return ImageTableGetField(image, &t, v->data.row, i, result);
+      }
+    }
+    return 0;
+  }
+  if (v->type != PVT_OBJECT) {
+    return 0;
+  }
+
+  size_t at = v->offset + 1;
+  size_t count = ImageVarint(image, &at);
+  size_t slots = ImageVarint(image, &at);
+  size_t entries = at;
+  if (slots == 0 || (slots & (slots - 1)) != 0) {
+    for (size_t i = 0; i < count && entries + i * 8 < image->length; i++) {
+      if (ImageStringEquals(image, ImageU32(image, entries + i * 8), key, length)) {
+        return SDFImageValueAt(image, ImageU32(image, entries + i * 8 + 4), v->offset, result);
+      }
+    }
+    return 0;
+  }
+
+  uint32_t hash = HashString((char*)key, length);
+  size_t index = entries + count * 8;
+  size_t mask = slots - 1;
+  // At most every slot is probed, even if a damaged index has no empty one
+  for (size_t n = 0, i = hash & mask; n < slots; n++, i = (i + 1) & mask) {
+    uint32_t position = ImageU32(image, index + i * 8 + 4);
+    if (position == 0 || position > count) {
+      return 0;
+    }
+    size_t entry = entries + (position - 1) * 8;
+    if (ImageU32(image, index + i * 8) == hash && ImageStringEquals(image, ImageU32(image, entry), key, length)) {
+      return SDFImageValueAt(image, ImageU32(image, entry + 4), v->offset, result);
+    }
+  }
+  return 0;
+}
+
+// Rows of a table come back as PVT_ROW views into it
+inline int SDFImageValueGetItem(struct SDF_ImageValue *v, size_t i, struct SDF_ImageValue *result) {
+  const struct SDF_Image *image = v->image;
+  if (v->type != PVT_LIST) {
+    return 0;
+  }
+  if (image->data[v->offset] == SIT_TABLE) {
+    if (i >= ImageTable(image, v->offset).rows) {
+      return 0;
+    }
+    *result = (struct SDF_ImageValue) {
+      .image = image,
+      .type = PVT_ROW,
+      .offset = v->offset,
+      .data.row = i,
+    };
+    return 1;
+  }
+  size_t at = v->offset + 1;
+  size_t count = ImageVarint(image, &at);
+  return i < count && SDFImageValueAt(image, ImageU32(image, at + i * 4), v->offset, result);
+}
+
+// The string is '\0' terminated, so it can also be used as a C string
+inline const char* SDFImageValueString(struct SDF_ImageValue *v, size_t *length) {
+  if (v->type != PVT_STRING) {
+    return NULL;
+  }
+  return ImageString(v->image, v->offset, length);
+}
+
+inline void SDFImageValueToString(struct SDF_ImageValue *v, struct StringBuilder *sb) {
+  struct SDF_ImageValue item;
+  const char *key;
+  size_t length, key_length;
+  switch (v->type) {
+    case PVT_STRING: {
+      const char *s = SDFImageValueString(v, &length);
+      if (s != NULL) {
+        StringBuilderAddJSONString(sb, s, length);
+      }
+      else {
+        StringBuilderAddString(sb, "null");
+      }
+      break;
+    }
+    case PVT_INTEGER:
+      StringBuilderAddInteger(sb, v->data.as_integer);
+      break;
+    case PVT_DOUBLE:
+      StringBuilderAddDouble(sb, v->data.as_double);
+      break;
+    case PVT_OBJECT:
+    case PVT_ROW:
+      length = SDFImageValueLength(v);
+      StringBuilderAddChar(sb, '{');
+      for (size_t i = 0; i < length && SDFImageValueGetEntry(v, i, &key, &key_length, &item); i++) {
+        if (i > 0) {
+          StringBuilderAddChar(sb, ',');
+        }
+        StringBuilderAddJSONString(sb, key, key_length);
+        StringBuilderAddChar(sb, ':');
+        SDFImageValueToString(&item, sb);
+      }
+      StringBuilderAddChar(sb, '}');
+      break;
+    case PVT_LIST:
+      length = SDFImageValueLength(v);
+      StringBuilderAddChar(sb, '[');
+      for (size_t i = 0; i < length && SDFImageValueGetItem(v, i, &item); i++) {
+        if (i > 0) {
+          StringBuilderAddChar(sb, ',');
+        }
+        SDFImageValueToString(&item, sb);
+      }
+      StringBuilderAddChar(sb, ']');
+      break;
+    default:
+      return;
+  }
+}
@@ -0,0 +1,100 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include "parser.h"
+#include "util.h"
+
+// The leading byte can't start SDF text, so no text file is taken for an image
+#define SDF_IMAGE_MAGIC "\x89SDF"
+#define SDF_IMAGE_VERSION 1
+#define SDF_IMAGE_HEADER_SIZE 16
+
+/*
+  Compiled documents. Everything after the header is a value starting
+  with one of these tags, and values refer to each other by their offset
+  from the start of the image, as little-endian uint32. Children are
+  written before their parents, so references always point backwards.
+  Counts and lengths are LEB128 varints.
+
+    header  "\x89SDF", version, root offset, image length (uint32 each)
+    string  varint length, bytes, '\0'; equal strings are stored once
+    integer zigzag varint
+    double  8 bytes
+    object  varint count, varint slots, count (key, value) offsets, then
+            slots (hash, position + 1) pairs of an open addressing index
+            like SDF_KeyIndex when count > SDF_OBJECT_INDEX_THRESHOLD
+    list    varint count, count item offsets
+    table   varint rows, varint last row length, varint fields, then an
+            offset per schema key and per column. A column is an
+            SDF_ColumnType byte, a cell size byte and one cell per row:
+            doubles take 8 bytes, integers the fewest of 1, 2, 4 or 8
+            that fit the column, strings and other values an offset.
+*/
+enum SDF_ImageTag {
+  SIT_STRING = 1,
+  SIT_INTEGER,
+  SIT_DOUBLE,
+  SIT_OBJECT,
+  SIT_LIST,
+  SIT_TABLE,
+};
+
+// Image being written, with the offsets of the strings already in it
+struct SDF_ImageWriter {
+  struct StringBuilder *out;
+  size_t base; // Where the image starts in out
+  struct SDF_KeySlot *strings;
+  size_t string_count, string_capacity;
+};
+
+/*
+  Appends the image to sb, which must not write to a file as the image is
+  read back while it is written. Returns 0, leaving sb as it was, if the
+  image would pass the 4 GiB an offset can address.
+*/
+int CompileSDFObject(struct SDF_Object *o, struct StringBuilder *sb);
+int CompileSDFFile(const char *input_path, const char *output_path);
+
+/*
+  A compiled document, used in place: lookups read the mapped file and
+  strings are views into it, so nothing is parsed or allocated. Offsets
+  are checked against the image length as they are followed, so a
+  damaged image makes lookups fail instead of reading past the end. It
+  can still point many values at the same child, so only convert images
+  you compiled yourself to text.
+*/
+struct SDF_Image {
+  const char *data;
+  size_t length;
+  uint32_t root;
+  struct FileBuffer fb;
+};
+
+// A value in an image. Numbers are decoded up front, rows are a table and an index
+struct SDF_ImageValue {
+  const struct SDF_Image *image;
+  enum ParserValueType type;
+  uint32_t offset;
+  union {
+    int64_t as_integer;
+    double as_double;
+    size_t row;
+  } data;
+};
+
+int IsSDFImage(const char *data, size_t length);
+int LoadSDFImage(const char *data, size_t length, struct SDF_Image *image);
+int OpenSDFImage(const char *file_path, struct SDF_Image *image);
+void CloseSDFImage(struct SDF_Image *image);
+
+int SDFImageRoot(const struct SDF_Image *image, struct SDF_ImageValue *v);
+// Keys of an object or row, items of a list or bytes of a string
+size_t SDFImageValueLength(struct SDF_ImageValue *v);
+int SDFImageValueGet(struct SDF_ImageValue *v, const char *key, size_t length, struct SDF_ImageValue *result);
+int SDFImageValueGetItem(struct SDF_ImageValue *v, size_t i, struct SDF_ImageValue *result);
+int SDFImageValueGetEntry(struct SDF_ImageValue *v, size_t i, const char **key, size_t *key_length, struct SDF_ImageValue *result);
+const char* SDFImageValueString(struct SDF_ImageValue *v, size_t *length);
+// A string of a damaged image that can't be read is written as null
+void SDFImageValueToString(struct SDF_ImageValue *v, struct StringBuilder *sb);
+
+#endif
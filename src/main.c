@@ -1,6 +1,12 @@
 #include "main.h"
+#include "batch.h"
+#include "binary.h"
+#include "events.h"
+#include "image.h"
 #include "parser.h"
+#include "stats.h"
 #include "tokenizer.h"
+#include "watch.h"
 
 static inline void SubString(char *buffer, char *s, int start, int stop) {
   int length = stop - start;
@@ -8,63 +14,251 @@ static inline void SubString(char *buffer, char *s, int start, int stop) {
 }
 
 int main(int argc, char **argv) {
+  if (argc > 1 && strcmp(argv[1], "compile") == 0) {
+    if (argc != 4) {
+      fprintf(stderr, "Usage: %s compile <input.sdf> <output>\n", argv[0]);
+      return 1;
+    }
+    return CompileSDFFile(argv[2], argv[3]) ? 0 : 1;
+  }
+
+  struct ConvertOptions options = {
+    .jobs = 1,
+    .ordered = 1,
+  };
+  struct SDF_Stats totals = {};
+  options.totals = &totals;
+  int watch = 0;
+  const char *to = NULL;
+  char **paths = malloc(sizeof(char*) * argc);
+  size_t count = 0;
 
   for (int i = 1; i < argc; i++) {
-    FilePathToJSON(argv[i]);
+    if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      options.jobs = atoi(argv[++i]);
+    }
+    else if (strncmp(argv[i], "-j", 2) == 0 && CharIsDigit(argv[i][2])) {
+      options.jobs = atoi(argv[i] + 2);
+    }
+    else if (strcmp(argv[i], "--unordered") == 0) {
+      options.ordered = 0;
+    }
+    else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+      options.cache = argv[++i];
+    }
+    else if (strncmp(argv[i], "--cache=", 8) == 0) {
+      options.cache = argv[i] + 8;
+    }
+    else if (strcmp(argv[i], "--stats") == 0 || strcmp(argv[i], "--stats=text") == 0) {
+      options.stats = SF_TEXT;
+    }
+    else if (strcmp(argv[i], "--stats=json") == 0) {
+      options.stats = SF_JSON;
+    }
+    else if (strcmp(argv[i], "--to") == 0 && i + 1 < argc) {
+      to = argv[++i];
+    }
+    else if (strncmp(argv[i], "--to=", 5) == 0) {
+      to = argv[i] + 5;
+    }
+    else if (strcmp(argv[i], "--watch") == 0) {
+      watch = 1;
+    }
+    else {
+      paths[count++] = argv[i];
+    }
   }
 
-  if (StdinIsReadable()) {
-    FILE *f = fopen("sdf.tmp", "wb+");
-    if (f == NULL) {
-      StdErrorLog("Failed to create tmp file!");
+  if (to != NULL && !ParseSDFOutputFormat(to, &options.format)) {
+    fprintf(stderr, "Unknown output format: %s (json, msgpack or cbor)\n", to);
+    free(paths);
+    return 1;
+  }
+
+#ifdef _WIN32
+  if (options.format != OF_JSON) {
+    _setmode(_fileno(stdout), _O_BINARY);
+  }
+#endif
+
+  if (watch) {
+    if (count != 1) {
+      fprintf(stderr, "Usage: %s --watch <file.sdf>\n", argv[0]);
+      free(paths);
+      return 1;
+    }
+    SDF_DocumentCallback callbacks[] = {
+      [OF_JSON] = WriteDocumentJSON,
+      [OF_MSGPACK] = WriteDocumentMsgPack,
+      [OF_CBOR] = WriteDocumentCBOR,
+    };
+    int ok = WatchSDFFile(paths[0], callbacks[options.format], stdout);
+    free(paths);
+    return ok ? 0 : 1;
+  }
+
+  ConvertFiles(paths, count, &options, stdout);
+  int stdin_readable = StdinIsReadable(paths, count);
+  free(paths);
+
+  if (stdin_readable) {
+    struct StringBuilder out = CreateFileStringBuilder(stdout);
+    if (options.stats != SF_NONE) {
+      struct SDF_Stats s = {};
+      StatsFileToFormat(stdin, &out, options.format, &s);
+      WriteSDFStats(stderr, "<stdin>", &s, options.stats);
+      AddSDFStats(&totals, &s);
+    }
+    else {
+      FileToFormat(stdin, &out, options.format);
     }
-    struct StringBuilder sb = CreateStringBuilder();
-    ReadStdinContent(&sb);
-    fwrite(sb.string, sizeof(char), sb.length, f);
-    rewind(f);
-    FileToJSON(f);
-    fclose(f);
-    remove("sdf.tmp");
-    free(sb.string);
+    StringBuilderFlush(&out);
+    free(out.string);
+  }
+
+  if (options.stats != SF_NONE && totals.files > 1) {
+    fflush(stdout);
+    WriteSDFStats(stderr, NULL, &totals, options.stats);
   }
 
   return 0;
 }
 
-inline int StdinIsReadable(void) {
-  fseek(stdin, 0, SEEK_END);
-  int is_readable = ftell(stdin) > 0;
-  rewind(stdin);
-  return is_readable;
+#ifndef _WIN32
+// Whether file_path names stdin: a pipe by any path, a redirected file only by a link like /dev/stdin
+static inline int StdinIsPath(struct stat *st, const char *file_path) {
+  struct stat path_st;
+  if (stat(file_path, &path_st) != 0 || path_st.st_dev != st->st_dev || path_st.st_ino != st->st_ino) {
+    return 0;
+  }
+  return !S_ISREG(st->st_mode) || (lstat(file_path, &path_st) == 0 && S_ISLNK(path_st.st_mode));
 }
+#endif
 
-inline void ReadStdinContent(struct StringBuilder *sb) {
-  while (1) {
-    char buffer[BUFFER_SIZE + 1] = {0};
-    size_t n = fread(buffer, sizeof(char), BUFFER_SIZE, stdin);
-    StringBuilderAddSubString(sb, buffer, 0, n);
-    if (n < BUFFER_SIZE) {
-      break;
+/*
+  Stdin is converted when it is redirected from a non-empty file, or when
+  it is a pipe or socket and no paths were given. Waiting on a pipe that
+  may never close would otherwise hold up the paths. It is never
+  converted again after one of the paths, like /dev/stdin, named it.
+*/
+inline int StdinIsReadable(char **paths, size_t count) {
+#ifndef _WIN32
+  if (isatty(STDIN_FILENO)) {
+    return 0;
+  }
+  struct stat st;
+  if (fstat(STDIN_FILENO, &st) == 0) {
+    for (size_t i = 0; i < count; i++) {
+      if (StdinIsPath(&st, paths[i])) {
+        return 0;
+      }
+    }
+    if (S_ISREG(st.st_mode)) {
+      return st.st_size > 0;
     }
   }
+#endif
+  if (count > 0) {
+    return 0;
+  }
+  int c = getc(stdin);
+  if (c == EOF) {
+    return 0;
+  }
+  ungetc(c, stdin);
+  return 1;
+}
+
+inline void FilePathToJSON(const char *file_path, struct StringBuilder *sb) {
+  FilePathToFormat(file_path, sb, 1, OF_JSON);
 }
 
-inline void FilePathToJSON(const char *file_path) {
-  FILE *f = fopen(file_path, "rb");
-  if (f == NULL) {
+inline void FilePathToFormat(const char *file_path, struct StringBuilder *sb, int jobs, enum SDF_OutputFormat format) {
+  struct FileBuffer fb;
+  if (!OpenFileBuffer(file_path, &fb)) {
     fprintf(stderr, "Error! Failed to open file: %s\n", file_path);
     return;
   }
-  FileToJSON(f);
-  fclose(f);
+  BufferToFormat(fb.data, fb.length, sb, jobs, format);
+  CloseFileBuffer(&fb);
 }
 
-inline void FileToJSON(FILE *f) {
-  struct TokenIterator ti = CreateTokenIterator(f);
-  struct SDF_Object o = ParseObject(&ti);
-  struct StringBuilder sb = CreateStringBuilder();
-  SDFObjectToString(&o, &sb);
-  puts(sb.string);
-  StringBuilderClear(&sb);
+/*
+  Converts a whole document in memory, text or compiled image. JSON is
+  written straight from parser events on a single thread. Otherwise the
+  tree is built, so that large lists can be parsed on several threads
+  with jobs > 1, and so that binary formats know every length up front.
+*/
+inline void BufferToFormat(char *data, size_t length, struct StringBuilder *sb, int jobs, enum SDF_OutputFormat format) {
+  if (ImageToFormat(data, length, sb, format)) {
+    return;
+  }
+  struct TokenIterator ti = CreateBufferTokenIterator(data, length);
+  if (jobs <= 1 && format == OF_JSON) {
+    TokenIteratorToJSON(&ti, sb);
+    return;
+  }
+  ti.jobs = jobs;
+  struct Arena a = CreateArena();
+  struct SDF_Object o = ParseObject(&ti, &a);
+  SDFObjectToFormat(&o, sb, format);
+  FreeArena(&a);
+}
+
+static inline void WriteDocument(struct SDF_Document *d, FILE *f, enum SDF_OutputFormat format) {
+  struct StringBuilder sb = CreateFileStringBuilder(f);
+  SDFObjectToFormat(&(d->root), &sb, format);
+  StringBuilderFlush(&sb);
+  fflush(f);
   free(sb.string);
 }
+
+// Writes a line of JSON to the FILE in user_data for every version of a watched document
+inline void WriteDocumentJSON(struct SDF_Document *d, void *user_data) {
+  WriteDocument(d, user_data, OF_JSON);
+}
+
+inline void WriteDocumentMsgPack(struct SDF_Document *d, void *user_data) {
+  WriteDocument(d, user_data, OF_MSGPACK);
+}
+
+inline void WriteDocumentCBOR(struct SDF_Document *d, void *user_data) {
+  WriteDocument(d, user_data, OF_CBOR);
+}
+
+// Returns 0 if data isn't a compiled image, which is then parsed as text. Exits on a damaged one
+inline int ImageToFormat(const char *data, size_t length, struct StringBuilder *sb, enum SDF_OutputFormat format) {
+  struct SDF_Image image;
+  struct SDF_ImageValue root;
+  if (!IsSDFImage(data, length)) {
+    return 0;
+  }
+  if (!LoadSDFImage(data, length, &image) || !SDFImageRoot(&image, &root)) {
+    fprintf(stderr, "Error! Damaged or unsupported compiled image\n");
+    exit(1);
+  }
+  SDFImageValueToFormat(&root, sb, format);
+  return 1;
+}
+
+inline void FileToFormat(FILE *f, struct StringBuilder *sb, enum SDF_OutputFormat format) {
+  struct TokenIterator ti = CreateTokenIterator(f);
+  if (format == OF_JSON) {
+    TokenIteratorToJSON(&ti, sb);
+  }
+  else {
+    struct Arena a = CreateArena();
+    struct SDF_Object o = ParseObject(&ti, &a);
+    SDFObjectToBinary(&o, sb, format);
+    FreeArena(&a);
+  }
+  FreeTokenIterator(&ti);
+}
+
+// Converts straight from parser events, so no tree is built
+inline void TokenIteratorToJSON(struct TokenIterator *ti, struct StringBuilder *sb) {
+  struct JSONWriter w = CreateJSONWriter(sb);
+  struct SDF_EventHandler h = CreateJSONEventHandler(&w);
+  ParseObjectEvents(ti, &h);
+  StringBuilderAddChar(sb, '\n');
+}
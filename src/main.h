@@ -5,16 +5,36 @@
 #include "util.h"
 #endif
 
+#ifndef TOKENIZER_H
+#include "tokenizer.h"
+#endif
+
+#ifndef WATCH_H
+#include "watch.h"
+#endif
+
 #ifndef _INC_STDIO
 #include <stdio.h>
 #endif
 
-#define BUFFER_SIZE 4096
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include "binary.h"
 
-int StdinIsReadable(void);
-void ReadStdinContent(struct StringBuilder *sb);
+int StdinIsReadable(char **paths, size_t count);
 
-void FilePathToJSON(const char *file_path);
-void FileToJSON(FILE *f);
+void FilePathToJSON(const char *file_path, struct StringBuilder *sb);
+void FilePathToFormat(const char *file_path, struct StringBuilder *sb, int jobs, enum SDF_OutputFormat format);
+void BufferToFormat(char *data, size_t length, struct StringBuilder *sb, int jobs, enum SDF_OutputFormat format);
+// Watch callbacks, which write each version of the document to the FILE in user_data
+void WriteDocumentJSON(struct SDF_Document *d, void *user_data);
+void WriteDocumentMsgPack(struct SDF_Document *d, void *user_data);
+void WriteDocumentCBOR(struct SDF_Document *d, void *user_data);
+int ImageToFormat(const char *data, size_t length, struct StringBuilder *sb, enum SDF_OutputFormat format);
+void FileToFormat(FILE *f, struct StringBuilder *sb, enum SDF_OutputFormat format);
+void TokenIteratorToJSON(struct TokenIterator *ti, struct StringBuilder *sb);
 
 #endif
\ No newline at end of file
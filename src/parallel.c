@@ -0,0 +1,211 @@
+#include "parallel.h"
+
+// Offset just past the closing quote of the string opened at s[start - 1]
+static inline size_t SkipString(const char *s, size_t start, size_t length) {
+  size_t i = start;
+  while (i < length) {
+    const char *quote = memchr(s + i, '"', length - i);
+    if (quote == NULL) {
+      return length;
+    }
+    i = quote - s;
+    size_t backslashes = 0;
+    while (i - backslashes > start && s[i - backslashes - 1] == '\\') {
+      backslashes++;
+    }
+    if (backslashes % 2 == 0) {
+      return i + 1;
+    }
+    i++;
+  }
+  return length;
+}
+
+/*
+  Walks the list body from ti->offset to its closing bracket and cuts it
+  into at most count chunks. Cuts are made only where SDFListIteratorNext
+  starts afresh: outside strings and nested values, right after a field
+  or item ends and, for schema lists, after a complete row. Line numbers
+  are counted the way the tokenizer does, so errors point at the same
+  place. Returns the number of chunks, or 0 when the list can't be split.
+*/
+static inline size_t SDFListSplit(struct TokenIterator *ti, size_t fields_per_row, struct SDF_ListChunk *chunks, size_t count) {
+  const char *s = ti->buffer;
+  size_t length = ti->length;
+  size_t chunk_size = (length - ti->offset) / count;
+  size_t ln = ti->ln, line_start = ti->offset - (ti->col - 1);
+  size_t fields = 0, n = 0;
+  int ignore = 1;
+
+  chunks[0].start = ti->offset;
+  chunks[0].ln = ti->ln;
+  chunks[0].col = ti->col;
+
+  for (size_t i = ti->offset; i < length; i++) {
+    int boundary = 0;
+    switch (s[i]) {
+      case ' ':
+      case '\t':
+      case '\r':
+        continue;
+
+      case '\n':
+        ln++;
+        line_start = i + 1;
+        if (ignore) {
+          continue;
+        }
+        // Fall through
+      case ';':
+        fields++;
+        ignore = 1;
+        boundary = fields_per_row == 0 || fields % fields_per_row == 0;
+        break;
+
+      case '"':
+        ignore = 0;
+        i = SkipString(s, i + 1, length) - 1;
+        break;
+
+      case '{':
+      case '[': {
+        // Schema lists would turn into mixed lists, text before would be joined
+        if (fields_per_row > 0 || !ignore) {
+          return 0;
+        }
+        size_t depth = 1;
+        while (depth > 0 && ++i < length) {
+          switch (s[i]) {
+            case '{':
+            case '[':
+              depth++;
+              break;
+            case '}':
+            case ']':
+              depth--;
+              break;
+            case '"':
+              i = SkipString(s, i + 1, length) - 1;
+              break;
+            case '\n':
+              ln++;
+              line_start = i + 1;
+              break;
+          }
+        }
+        boundary = 1;
+        break;
+      }
+
+      case ']':
+        chunks[n].stop = i + 1;
+        return n + 1;
+
+      case '}':
+        return 0;
+
+      default:
+        ignore = 0;
+        break;
+    }
+
+    if (boundary && n + 1 < count && i + 1 - chunks[n].start >= chunk_size) {
+      chunks[n].stop = i + 1;
+      n++;
+      chunks[n].start = i + 1;
+      chunks[n].ln = ln;
+      chunks[n].col = i + 1 - line_start + 1;
+    }
+  }
+
+  // No closing bracket
+  return 0;
+}
+
+#ifndef _WIN32
+
+static void* SDFListChunkParse(void *arg) {
+  struct SDF_ListChunk *c = arg;
+  sdf_allocation_stats = c->allocation_stats;
+  c->list = ParseList(&(c->ti), c->schema, c->a);
+  return NULL;
+}
+
+inline int ParseListParallel(struct TokenIterator *ti, struct StringList *schema, struct Arena *a, struct SDF_List *l) {
+  size_t count = (ti->length - ti->offset) / SDF_PARALLEL_CHUNK_MIN_SIZE;
+  if (ti->f != NULL || ti->jobs <= 1 || count < 2) {
+    return 0;
+  }
+  if (count > (size_t)ti->jobs) {
+    count = ti->jobs;
+  }
+
+  struct SDF_ListChunk *chunks = calloc(count, sizeof(struct SDF_ListChunk));
+  count = SDFListSplit(ti, schema->length, chunks, count);
+  if (count < 2) {
+    free(chunks);
+    return 0;
+  }
+
+  pthread_t *threads = malloc(sizeof(pthread_t) * count);
+  for (size_t i = 0; i < count; i++) {
+    struct SDF_ListChunk *c = &chunks[i];
+    c->ti = CreateBufferTokenIterator(ti->buffer, c->stop);
+    c->ti.offset = c->start;
+    c->ti.ln = c->ln;
+    c->ti.col = c->col;
+    c->schema = schema;
+    c->arena = CreateArena();
+    c->a = a == NULL ? NULL : &(c->arena);
+    c->allocation_stats = sdf_allocation_stats;
+    // The first chunk, and any that can't get a thread, are parsed here
+    c->threaded = i > 0 && pthread_create(&threads[i], NULL, SDFListChunkParse, c) == 0;
+  }
+  for (size_t i = 0; i < count; i++) {
+    if (chunks[i].threaded) {
+      pthread_join(threads[i], NULL);
+    }
+    else {
+      SDFListChunkParse(&chunks[i]);
+    }
+  }
+
+  *l = (struct SDF_List) {
+    .schema = schema,
+    .items = NewParserValueList(a),
+    .table = schema->length > 0 ? NewSDFTable(schema, a) : NULL,
+  };
+  for (size_t i = 0; i < count; i++) {
+    struct SDF_ListChunk *c = &chunks[i];
+    if (l->table != NULL) {
+      SDFTableAppend(l->table, c->list.table);
+    }
+    else {
+      for (size_t j = 0; j < c->list.items->length; j++) {
+        ParserValueListAdd(l->items, c->list.items->items[j]);
+      }
+    }
+    if (a != NULL) {
+      ArenaAdopt(a, &(c->arena));
+    }
+  }
+
+  // Continue after the closing bracket, as ParseList would
+  struct SDF_ListChunk *last = &chunks[count - 1];
+  ti->offset = last->ti.offset;
+  ti->ln = last->ti.ln;
+  ti->col = last->ti.col;
+  ti->block = SIZE_MAX;
+
+  free(threads);
+  free(chunks);
+  return 1;
+}
+
+#else
+
+inline int ParseListParallel(struct TokenIterator *ti, struct StringList *schema, struct Arena *a, struct SDF_List *l) {
+  return 0;
+}
+
+#endif
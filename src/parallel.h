@@ -0,0 +1,38 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+#include "parser.h"
+#include "tokenizer.h"
+#include "util.h"
+
+// List bodies shorter than this are not worth splitting
+#define SDF_PARALLEL_CHUNK_MIN_SIZE (1 << 20)
+
+/*
+  A byte range of a list body that starts where the list iterator holds
+  no state, with its own tokenizer, arena and result.
+*/
+struct SDF_ListChunk {
+  size_t start, stop;
+  size_t ln, col;
+  struct TokenIterator ti;
+  struct StringList *schema;
+  struct Arena arena, *a;
+  struct SDF_List list;
+  struct SDF_AllocationStats *allocation_stats;
+  int threaded;
+};
+
+/*
+  Parses the body of the list ti is positioned in on up to ti->jobs
+  threads and appends the chunks in order, as ParseList would have
+  built it. Returns 0 without consuming anything when the body is too
+  small, or holds something that can only be parsed in sequence.
+*/
+int ParseListParallel(struct TokenIterator *ti, struct StringList *schema, struct Arena *a, struct SDF_List *l);
+
+#endif
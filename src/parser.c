@@ -1,32 +1,26 @@
 #include "parser.h"
+#include "parallel.h"
 
 inline void ParserValueToString(struct ParserValue *pv, struct StringBuilder *sb) {
   switch (pv->type) {
     case PVT_STRING:
-      StringBuilderAddChar(sb, '"');
-      StringBuilderAddString(sb, pv->data.as_string);
-      StringBuilderAddChar(sb, '"');
+      StringBuilderAddJSONString(sb, pv->data.as_string, strlen(pv->data.as_string));
       break;
-    case PVT_NUMBER: {
-      float is_int = (float)((int)pv->data.as_float) == pv->data.as_float;
-      if (is_int) {
-        char buffer[256] = {0};
-        itoa(pv->data.as_float, buffer, 10);
-        StringBuilderAddString(sb, buffer);
-      }
-      else {
-        char buffer[256] = {};
-        sprintf(buffer, "%f", pv->data.as_float);
-        StringBuilderAddString(sb, buffer);
-      }
+    case PVT_INTEGER:
+      StringBuilderAddInteger(sb, pv->data.as_integer);
+      break;
+    case PVT_DOUBLE:
+      StringBuilderAddDouble(sb, pv->data.as_double);
       break;
-    }
     case PVT_OBJECT:
       SDFObjectToString(&(pv->data.as_object), sb);
       break;
     case PVT_LIST:
       SDFListToString(&(pv->data.as_list), sb);
       break;
+    case PVT_ROW:
+      SDFRowToString(&(pv->data.as_row), sb);
+      break;
     default:
       return;
   }
@@ -39,13 +33,33 @@ inline struct ParserValue CreateParserValueString(char *s) {
   };
 }
 
-inline struct ParserValue CreateParserValueNumber(float f) {
+inline struct ParserValue CreateParserValueInteger(int64_t i) {
   return (struct ParserValue) {
-    .type = PVT_NUMBER,
-    .data.as_float = f,
+    .type = PVT_INTEGER,
+    .data.as_integer = i,
   };
 }
 
+inline struct ParserValue CreateParserValueDouble(double d) {
+  return (struct ParserValue) {
+    .type = PVT_DOUBLE,
+    .data.as_double = d,
+  };
+}
+
+inline struct ParserValue CreateParserValueScalar(char *s) {
+  int64_t integer;
+  double real;
+  switch (ParseNumber(s, &integer, &real)) {
+    case NT_INTEGER:
+      return CreateParserValueInteger(integer);
+    case NT_DOUBLE:
+      return CreateParserValueDouble(real);
+    default:
+      return CreateParserValueString(s);
+  }
+}
+
 inline struct ParserValue CreateParserValueObject(struct SDF_Object o) {
   return (struct ParserValue) {
     .type = PVT_OBJECT,
@@ -60,37 +74,155 @@ inline struct ParserValue CreateParserValueList(struct SDF_List l) {
   };
 }
 
-inline struct ParserValueList* NewParserValueList(void) {
+inline struct ParserValue CreateParserValueRow(struct SDF_Table *t, size_t i) {
+  return (struct ParserValue) {
+    .type = PVT_ROW,
+    .data.as_row = {
+      .table = t,
+      .index = i,
+    },
+  };
+}
+
+inline struct ParserValueList* NewParserValueList(struct Arena *a) {
   const size_t capacity = 32;
-  struct ParserValueList *pvl = malloc(sizeof(struct ParserValueList));
+  struct ParserValueList *pvl = ArenaAlloc(a, sizeof(struct ParserValueList));
   pvl->capacity = capacity;
   pvl->length = 0;
-  pvl->items = malloc(sizeof(struct ParserValue) * capacity);
+  pvl->items = ArenaAlloc(a, sizeof(struct ParserValue) * capacity);
+  pvl->arena = a;
+  CountAllocation(AK_PARSER_VALUE_LIST, sizeof(struct ParserValue) * capacity);
   return pvl;
 }
 
 inline void ParserValueListAdd(struct ParserValueList *pvl, struct ParserValue pv) {
   if (pvl->length >= pvl->capacity) {
     pvl->capacity <<= 1;
-    pvl->items = realloc(pvl->items, sizeof(struct ParserValue) * pvl->capacity);
+    pvl->items = ArenaRealloc(
+      pvl->arena,
+      pvl->items,
+      sizeof(struct ParserValue) * pvl->length,
+      sizeof(struct ParserValue) * pvl->capacity
+    );
+    CountAllocation(AK_PARSER_VALUE_LIST, sizeof(struct ParserValue) * pvl->capacity);
   }
   pvl->items[pvl->length] = pv;
   pvl->length += 1;
 }
 
-inline struct SDF_Object CreateSDFObject(void) {
+inline struct SDF_Object CreateSDFObject(struct Arena *a) {
   return (struct SDF_Object) {
-    .keys = NewStringList(),
-    .values = NewParserValueList(),
+    .keys = NewStringList(a),
+    .values = NewParserValueList(a),
   };
 }
 
+static inline void SDFKeyIndexInsert(struct SDF_KeyIndex *index, uint32_t hash, size_t position) {
+  size_t mask = index->capacity - 1;
+  size_t i = hash & mask;
+  while (index->slots[i].position != 0) {
+    i = (i + 1) & mask;
+  }
+  index->slots[i] = (struct SDF_KeySlot) {
+    .hash = hash,
+    .position = position + 1,
+  };
+}
+
+static inline void SDFObjectRebuildIndex(struct SDF_Object *o, size_t capacity) {
+  struct Arena *a = o->keys->arena;
+  struct SDF_KeyIndex index = {
+    .slots = ArenaAlloc(a, sizeof(struct SDF_KeySlot) * capacity),
+    .capacity = capacity,
+  };
+  memset(index.slots, 0, sizeof(struct SDF_KeySlot) * capacity);
+  if (o->index == NULL) {
+    o->index = ArenaAlloc(a, sizeof(struct SDF_KeyIndex));
+    for (size_t i = 0; i < o->keys->length; i++) {
+      char *key = o->keys->items[i];
+      SDFKeyIndexInsert(&index, HashString(key, strlen(key)), i);
+    }
+  }
+  else {
+    for (size_t i = 0; i < o->index->capacity; i++) {
+      struct SDF_KeySlot slot = o->index->slots[i];
+      if (slot.position != 0) {
+        SDFKeyIndexInsert(&index, slot.hash, slot.position - 1);
+      }
+    }
+    if (a == NULL) {
+      free(o->index->slots);
+    }
+  }
+  *(o->index) = index;
+}
+
+// Returns the position of the key, or -1 if the object doesn't have it
+static inline long SDFObjectFindKey(struct SDF_Object *o, char *key, size_t length, uint32_t hash) {
+  if (o->index == NULL) {
+    for (size_t i = 0; i < o->keys->length; i++) {
+      char *candidate = o->keys->items[i];
+      if (strncmp(candidate, key, length) == 0 && candidate[length] == '\0') {
+        return i;
+      }
+    }
+    return -1;
+  }
+  size_t mask = o->index->capacity - 1;
+  for (size_t i = hash & mask; o->index->slots[i].position != 0; i = (i + 1) & mask) {
+    struct SDF_KeySlot slot = o->index->slots[i];
+    char *candidate = o->keys->items[slot.position - 1];
+    if (slot.hash == hash && strncmp(candidate, key, length) == 0 && candidate[length] == '\0') {
+      return slot.position - 1;
+    }
+  }
+  return -1;
+}
+
+static inline void SDFObjectUnshare(struct SDF_Object *o);
+
+// Returns 0 without adding the key if the object already has it
+inline int SDFObjectAddKey(struct SDF_Object *o, char *key) {
+  size_t length = strlen(key);
+  uint32_t hash = o->index != NULL ? HashString(key, length) : 0;
+  if (SDFObjectFindKey(o, key, length, hash) >= 0) {
+    return 0;
+  }
+  if (o->keys->shared) {
+    SDFObjectUnshare(o);
+  }
+  StringListAdd(o->keys, key);
+  if (o->index != NULL) {
+    if (o->keys->length * 2 > o->index->capacity) {
+      SDFObjectRebuildIndex(o, o->index->capacity << 1);
+    }
+    SDFKeyIndexInsert(o->index, hash, o->keys->length - 1);
+  }
+  else if (o->keys->length > SDF_OBJECT_INDEX_THRESHOLD) {
+    SDFObjectRebuildIndex(o, SDF_OBJECT_INDEX_THRESHOLD * 4);
+  }
+  return 1;
+}
+
+inline struct ParserValue* SDFObjectGet(struct SDF_Object *o, char *key) {
+  size_t length = strlen(key);
+  return SDFObjectGetHashed(o, key, length, HashString(key, length));
+}
+
+// For callers that hashed the key up front with HashString
+inline struct ParserValue* SDFObjectGetHashed(struct SDF_Object *o, char *key, size_t length, uint32_t hash) {
+  long i = SDFObjectFindKey(o, key, length, hash);
+  if (i < 0 || (size_t)i >= o->values->length) {
+    return NULL;
+  }
+  return &(o->values->items[i]);
+}
+
 inline void SDFObjectToString(struct SDF_Object *o, struct StringBuilder *sb) {
   StringBuilderAddChar(sb, '{');
   for (size_t i = 0; i < o->keys->length; i++) {
-    StringBuilderAddChar(sb, '"');
-    StringBuilderAddString(sb, o->keys->items[i]);
-    StringBuilderAddString(sb, "\":");
+    StringBuilderAddJSONString(sb, o->keys->items[i], strlen(o->keys->items[i]));
+    StringBuilderAddChar(sb, ':');
     ParserValueToString(&(o->values->items[i]), sb);
     if (i < o->keys->length - 1) {
       StringBuilderAddChar(sb, ',');
@@ -99,73 +231,733 @@ inline void SDFObjectToString(struct SDF_Object *o, struct StringBuilder *sb) {
   StringBuilderAddChar(sb, '}');
 }
 
-inline struct SDF_List CreateSDFList(void) {
+inline struct SDF_List CreateSDFList(struct Arena *a) {
   return (struct SDF_List) {
-    .schema = NewStringList(),
-    .items = NewParserValueList(),
+    .schema = NewStringList(a),
+    .items = NewParserValueList(a),
   };
 }
 
+inline size_t SDFListLength(struct SDF_List *l) {
+  if (l->table != NULL) {
+    return l->table->rows;
+  }
+  return l->items->length;
+}
+
+// Rows of a table come back as PVT_ROW views into it
+inline struct ParserValue SDFListGetItem(struct SDF_List *l, size_t i) {
+  if (l->table != NULL) {
+    return CreateParserValueRow(l->table, i);
+  }
+  return l->items->items[i];
+}
+
 inline void SDFListToString(struct SDF_List *l, struct StringBuilder *sb) {
+  size_t length = SDFListLength(l);
   StringBuilderAddChar(sb, '[');
-  for (size_t i = 0; i < l->items->length; i++) {
-    ParserValueToString(&(l->items->items[i]), sb);
-    if (i < l->items->length - 1) {
+  for (size_t i = 0; i < length; i++) {
+    struct ParserValue pv = SDFListGetItem(l, i);
+    ParserValueToString(&pv, sb);
+    if (i < length - 1) {
       StringBuilderAddChar(sb, ',');
     }
   }
   StringBuilderAddChar(sb, ']');
 }
 
-inline struct SDF_Object ParseObject(struct TokenIterator *ti) {
-  struct SDF_Object o = CreateSDFObject();
+static inline size_t SDFColumnCellSize(enum SDF_ColumnType type) {
+  switch (type) {
+    case SCT_INTEGER:
+      return sizeof(int64_t);
+    case SCT_DOUBLE:
+      return sizeof(double);
+    case SCT_STRING:
+      return sizeof(char*);
+    default:
+      return sizeof(struct ParserValue);
+  }
+}
+
+static inline struct ParserValue SDFColumnGet(struct SDF_Column *c, size_t i) {
+  switch (c->type) {
+    case SCT_INTEGER:
+      return CreateParserValueInteger(c->data.as_integer[i]);
+    case SCT_DOUBLE:
+      return CreateParserValueDouble(c->data.as_double[i]);
+    case SCT_STRING:
+      return CreateParserValueString(c->data.as_string[i]);
+    default:
+      return c->data.as_value[i];
+  }
+}
+
+inline struct SDF_Table* NewSDFTable(struct StringList *schema, struct Arena *a) {
+  const size_t capacity = 32;
+  struct SDF_Table *t = ArenaAlloc(a, sizeof(struct SDF_Table));
+  t->schema = schema;
+  t->rows = 0;
+  t->capacity = capacity;
+  t->last_row_length = 0;
+  t->arena = a;
+  t->columns = ArenaAlloc(a, sizeof(struct SDF_Column) * schema->length);
+  // Columns are allocated once their first value decides their type
+  memset(t->columns, 0, sizeof(struct SDF_Column) * schema->length);
+  return t;
+}
+
+inline size_t SDFTableRowLength(struct SDF_Table *t, size_t row) {
+  if (row + 1 == t->rows) {
+    return t->last_row_length;
+  }
+  return t->schema->length;
+}
+
+static inline void SDFTableGrow(struct SDF_Table *t) {
+  size_t capacity = t->capacity << 1;
+  for (size_t i = 0; i < t->schema->length; i++) {
+    struct SDF_Column *c = &(t->columns[i]);
+    if (c->data.as_value != NULL) {
+      size_t size = SDFColumnCellSize(c->type);
+      c->data.as_value = ArenaRealloc(t->arena, c->data.as_value, size * t->rows, size * capacity);
+    }
+  }
+  t->capacity = capacity;
+}
+
+static inline enum SDF_ColumnType SDFColumnTypeOf(enum ParserValueType type) {
+  switch (type) {
+    case PVT_INTEGER:
+      return SCT_INTEGER;
+    case PVT_DOUBLE:
+      return SCT_DOUBLE;
+    case PVT_STRING:
+      return SCT_STRING;
+    default:
+      return SCT_VALUE;
+  }
+}
+
+// Falls back to storing whole values once a column sees a second type
+static inline void SDFColumnPromote(struct SDF_Table *t, struct SDF_Column *c) {
+  struct ParserValue *values = ArenaAlloc(t->arena, sizeof(struct ParserValue) * t->capacity);
+  for (size_t i = 0; i < t->rows; i++) {
+    values[i] = SDFColumnGet(c, i);
+  }
+  c->type = SCT_VALUE;
+  c->data.as_value = values;
+}
+
+static inline void SDFTableSetField(struct SDF_Table *t, size_t field, struct ParserValue pv) {
+  struct SDF_Column *c = &(t->columns[field]);
+  if (c->data.as_value == NULL) {
+    c->type = SDFColumnTypeOf(pv.type);
+    c->data.as_value = ArenaAlloc(t->arena, SDFColumnCellSize(c->type) * t->capacity);
+  }
+  else if (c->type != SCT_VALUE && c->type != SDFColumnTypeOf(pv.type)) {
+    SDFColumnPromote(t, c);
+  }
+  switch (c->type) {
+    case SCT_INTEGER:
+      c->data.as_integer[t->rows] = pv.data.as_integer;
+      break;
+    case SCT_DOUBLE:
+      c->data.as_double[t->rows] = pv.data.as_double;
+      break;
+    case SCT_STRING:
+      c->data.as_string[t->rows] = pv.data.as_string;
+      break;
+    default:
+      c->data.as_value[t->rows] = pv;
+      break;
+  }
+}
+
+// Copies the values of a row object whose keys follow the table's schema
+inline void SDFTableAddRow(struct SDF_Table *t, struct SDF_Object *row) {
+  if (t->rows >= t->capacity) {
+    SDFTableGrow(t);
+  }
+  for (size_t i = 0; i < row->values->length; i++) {
+    SDFTableSetField(t, i, row->values->items[i]);
+  }
+  t->last_row_length = row->values->length;
+  t->rows += 1;
+}
+
+/*
+  Adds the rows of src, which shares t's schema, to the end of t. Only
+  the last row of t may be shorter than the schema, so t must be empty
+  or end in a full row.
+*/
+inline void SDFTableAppend(struct SDF_Table *t, struct SDF_Table *src) {
+  if (src->rows == 0) {
+    return;
+  }
+  while (t->rows + src->rows > t->capacity) {
+    SDFTableGrow(t);
+  }
+  for (size_t i = 0; i < t->schema->length; i++) {
+    struct SDF_Column *c = &(t->columns[i]);
+    struct SDF_Column *s = &(src->columns[i]);
+    // The last row of src may not reach this column
+    size_t rows = i < src->last_row_length ? src->rows : src->rows - 1;
+    if (rows == 0) {
+      continue;
+    }
+    if (c->data.as_value == NULL) {
+      c->type = s->type;
+      c->data.as_value = ArenaAlloc(t->arena, SDFColumnCellSize(c->type) * t->capacity);
+    }
+    else if (c->type != SCT_VALUE && c->type != s->type) {
+      SDFColumnPromote(t, c);
+    }
+    if (c->type == s->type) {
+      size_t size = SDFColumnCellSize(c->type);
+      memcpy((char*)c->data.as_value + size * t->rows, s->data.as_value, size * rows);
+    }
+    else {
+      for (size_t j = 0; j < rows; j++) {
+        c->data.as_value[t->rows + j] = SDFColumnGet(s, j);
+      }
+    }
+  }
+  t->rows += src->rows;
+  t->last_row_length = src->last_row_length;
+}
+
+inline int SDFTableGetField(struct SDF_Table *t, size_t row, size_t field, struct ParserValue *pv) {
+  if (row >= t->rows || field >= SDFTableRowLength(t, row)) {
+    return 0;
+  }
+  *pv = SDFColumnGet(&(t->columns[field]), row);
+  return 1;
+}
+
+inline long SDFTableFindField(struct SDF_Table *t, char *key, size_t length) {
+  for (size_t i = 0; i < t->schema->length; i++) {
+    char *candidate = t->schema->items[i];
+    if (strncmp(candidate, key, length) == 0 && candidate[length] == '\0') {
+      return i;
+    }
+  }
+  return -1;
+}
+
+inline void SDFRowToString(struct SDF_Row *r, struct StringBuilder *sb) {
+  size_t length = SDFTableRowLength(r->table, r->index);
+  StringBuilderAddChar(sb, '{');
+  for (size_t i = 0; i < length; i++) {
+    struct ParserValue pv = SDFColumnGet(&(r->table->columns[i]), r->index);
+    StringBuilderAddJSONString(sb, r->table->schema->items[i], strlen(r->table->schema->items[i]));
+    StringBuilderAddChar(sb, ':');
+    ParserValueToString(&pv, sb);
+    if (i < length - 1) {
+      StringBuilderAddChar(sb, ',');
+    }
+  }
+  StringBuilderAddChar(sb, '}');
+}
+
+_Thread_local struct SDF_ParserContext *sdf_parser_context = NULL;
+
+inline struct SDF_ParserContext CreateSDFParserContext(void) {
+  return (struct SDF_ParserContext) {};
+}
+
+inline void FreeSDFParserContext(struct SDF_ParserContext *c) {
+  struct SDF_ParserScratch *s = c->free;
+  while (s != NULL) {
+    struct SDF_ParserScratch *next = s->next;
+    s->context = NULL;
+    ReleaseParserScratch(s);
+    free(s);
+    s = next;
+  }
+  c->free = NULL;
+}
+
+inline struct SDF_ParserContext* UseSDFParserContext(struct SDF_ParserContext *c) {
+  struct SDF_ParserContext *previous = sdf_parser_context;
+  sdf_parser_context = c;
+  return previous;
+}
+
+inline struct SDF_ParserScratch* AcquireParserScratch(struct SDF_ParserScratch *local) {
+  struct SDF_ParserContext *c = sdf_parser_context;
+  struct SDF_ParserScratch *s = local;
+  if (c == NULL) {
+    *s = (struct SDF_ParserScratch) {};
+  }
+  else if (c->free != NULL) {
+    s = c->free;
+    c->free = s->next;
+  }
+  else {
+    s = malloc(sizeof(struct SDF_ParserScratch));
+    *s = (struct SDF_ParserScratch) {
+      .context = c,
+    };
+  }
+  if (s->sb.string == NULL) {
+    s->sb = CreateStringBuilder();
+  }
+  return s;
+}
+
+inline void ReleaseParserScratch(struct SDF_ParserScratch *s) {
+  struct SDF_ParserContext *c = s->context;
+  if (c == NULL) {
+    free(s->sb.string);
+    free(s->key.string);
+    if (s->keys != NULL) {
+      free(s->keys->items);
+      free(s->keys);
+      free(s->values->items);
+      free(s->values);
+    }
+    free(s->index.slots);
+    free(s->schema.items);
+    free(s->interner.strings.slots);
+    free(s->interner.shapes.slots);
+    FreeArena(&(s->rows));
+    return;
+  }
+  if (s->sb.string != NULL) {
+    StringBuilderClear(&(s->sb));
+  }
+  if (s->key.string != NULL) {
+    StringBuilderClear(&(s->key));
+  }
+  if (s->keys != NULL) {
+    s->keys->length = 0;
+    s->values->length = 0;
+  }
+  ArenaReset(&(s->rows));
+  s->schema.length = 0;
+  s->next = c->free;
+  c->free = s;
+}
+
+inline void ParserScratchCleanup(void *s) {
+  ReleaseParserScratch(s);
+}
+
+inline void ParserContextCleanup(void *previous) {
+  sdf_parser_context = previous;
+}
+
+static inline void InternMapClear(struct SDF_InternMap *m) {
+  if (m->count > 0) {
+    memset(m->slots, 0, sizeof(struct SDF_InternSlot) * m->capacity);
+    m->count = 0;
+  }
+}
+
+static inline void InternMapGrow(struct SDF_InternMap *m) {
+  size_t capacity = m->capacity > 0 ? m->capacity << 1 : 256;
+  struct SDF_InternSlot *slots = calloc(capacity, sizeof(struct SDF_InternSlot));
+  for (size_t i = 0; i < m->capacity; i++) {
+    struct SDF_InternSlot slot = m->slots[i];
+    if (slot.p != NULL) {
+      size_t j = slot.hash & (capacity - 1);
+      while (slots[j].p != NULL) {
+        j = (j + 1) & (capacity - 1);
+      }
+      slots[j] = slot;
+    }
+  }
+  free(m->slots);
+  m->slots = slots;
+  m->capacity = capacity;
+}
+
+// Returns the empty slot to fill in when the map grew too full for another entry
+static inline struct SDF_InternSlot* InternMapReserve(struct SDF_InternMap *m, uint32_t hash) {
+  if ((m->count + 1) * 2 > m->capacity) {
+    InternMapGrow(m);
+  }
+  size_t mask = m->capacity - 1;
+  size_t i = hash & mask;
+  while (m->slots[i].p != NULL) {
+    i = (i + 1) & mask;
+  }
+  m->count += 1;
+  return &(m->slots[i]);
+}
+
+static inline void OpenSDFInterner(struct SDF_Interner *in, struct Arena *a) {
+  InternMapClear(&(in->strings));
+  InternMapClear(&(in->shapes));
+  in->arena = a;
+  in->empty_schema = NULL;
+}
+
+// Returns the interned copy of the length bytes at s, which hash to hash
+static inline char* InternString(struct SDF_Interner *in, char *s, size_t length, uint32_t hash) {
+  struct SDF_InternMap *m = &(in->strings);
+  if (m->capacity > 0) {
+    size_t mask = m->capacity - 1;
+    for (size_t i = hash & mask; m->slots[i].p != NULL; i = (i + 1) & mask) {
+      struct SDF_InternSlot slot = m->slots[i];
+      if (slot.hash == hash && slot.length == length && memcmp(slot.p, s, length) == 0) {
+        return slot.p;
+      }
+    }
+  }
+  char *copy = ArenaAlloc(in->arena, length + 1);
+  memcpy(copy, s, length);
+  copy[length] = '\0';
+  *InternMapReserve(m, hash) = (struct SDF_InternSlot) {
+    .hash = hash,
+    .length = length,
+    .p = copy,
+  };
+  return copy;
+}
+
+static inline struct StringList* CopyStringList(char **items, size_t length, struct Arena *a) {
+  size_t capacity = length > 0 ? length : 1;
+  struct StringList *sl = ArenaAlloc(a, sizeof(struct StringList));
+  sl->capacity = capacity;
+  sl->length = length;
+  sl->items = ArenaAlloc(a, sizeof(char*) * capacity);
+  sl->arena = a;
+  sl->shared = 0;
+  if (length > 0) {
+    memcpy(sl->items, items, sizeof(char*) * length);
+  }
+  CountAllocation(AK_STRING_LIST, sizeof(char*) * capacity);
+  return sl;
+}
+
+// An empty list with room for exactly length values
+static inline struct ParserValueList* NewFixedParserValueList(size_t length, struct Arena *a) {
+  size_t capacity = length > 0 ? length : 1;
+  struct ParserValueList *pvl = ArenaAlloc(a, sizeof(struct ParserValueList));
+  pvl->capacity = capacity;
+  pvl->length = 0;
+  pvl->items = ArenaAlloc(a, sizeof(struct ParserValue) * capacity);
+  pvl->arena = a;
+  CountAllocation(AK_PARSER_VALUE_LIST, sizeof(struct ParserValue) * capacity);
+  return pvl;
+}
+
+static inline struct ParserValueList* CopyParserValueList(struct ParserValue *items, size_t length, struct Arena *a) {
+  struct ParserValueList *pvl = NewFixedParserValueList(length, a);
+  memcpy(pvl->items, items, sizeof(struct ParserValue) * length);
+  pvl->length = length;
+  return pvl;
+}
+
+// Index for objects with these keys, or NULL when they are few enough to search in order
+static inline struct SDF_KeyIndex* NewSDFKeyIndex(struct StringList *keys) {
+  if (keys->length <= SDF_OBJECT_INDEX_THRESHOLD) {
+    return NULL;
+  }
+  struct SDF_Object o = {
+    .keys = keys,
+  };
+  size_t capacity = SDF_OBJECT_INDEX_THRESHOLD * 4;
+  while (keys->length * 2 > capacity) {
+    capacity <<= 1;
+  }
+  SDFObjectRebuildIndex(&o, capacity);
+  return o.index;
+}
+
+// A copy of index in a, or NULL for no index
+static inline struct SDF_KeyIndex* CopySDFKeyIndex(struct SDF_KeyIndex *index, struct Arena *a) {
+  if (index == NULL) {
+    return NULL;
+  }
+  struct SDF_KeyIndex *copy = ArenaAlloc(a, sizeof(struct SDF_KeyIndex));
+  copy->capacity = index->capacity;
+  copy->slots = ArenaAlloc(a, sizeof(struct SDF_KeySlot) * index->capacity);
+  memcpy(copy->slots, index->slots, sizeof(struct SDF_KeySlot) * index->capacity);
+  return copy;
+}
+
+// Gives an object that shares its keys with others a copy of them and of their index
+static inline void SDFObjectUnshare(struct SDF_Object *o) {
+  struct Arena *a = o->keys->arena;
+  o->keys = CopyStringList(o->keys->items, o->keys->length, a);
+  o->index = CopySDFKeyIndex(o->index, a);
+}
+
+// The index of the keys is only copied for a new shape
+static inline struct SDF_ObjectShape* InternShape(struct SDF_Interner *in, char **keys, size_t length, struct SDF_KeyIndex *index) {
+  uint32_t hash = (uint32_t)HashBytes(keys, sizeof(char*) * length, 0);
+  struct SDF_InternMap *m = &(in->shapes);
+  if (m->capacity > 0) {
+    size_t mask = m->capacity - 1;
+    for (size_t i = hash & mask; m->slots[i].p != NULL; i = (i + 1) & mask) {
+      struct SDF_InternSlot slot = m->slots[i];
+      struct SDF_ObjectShape *shape = slot.p;
+      // Interned keys are equal only if they are the same string
+      if (slot.hash == hash && slot.length == length && memcmp(shape->keys.items, keys, sizeof(char*) * length) == 0) {
+        return shape;
+      }
+    }
+  }
+  struct SDF_ObjectShape *shape = ArenaAlloc(in->arena, sizeof(struct SDF_ObjectShape));
+  shape->keys = *CopyStringList(keys, length, in->arena);
+  shape->keys.shared = 1;
+  shape->index = CopySDFKeyIndex(index, in->arena);
+  *InternMapReserve(m, hash) = (struct SDF_InternSlot) {
+    .hash = hash,
+    .length = length,
+    .p = shape,
+  };
+  return shape;
+}
+
+static inline struct SDF_Interner* ParserInterner(struct TokenIterator *ti, struct Arena *a) {
+  struct SDF_Interner *in = ti->interner;
+  return in != NULL && in->arena == a ? in : NULL;
+}
+
+// The outermost parse of a document shares its interner with the nested ones. Returns 1 if it did
+static inline int ParserOpenInterner(struct TokenIterator *ti, struct SDF_ParserScratch *s, struct Arena *a) {
+  if (ti->interner != NULL || a == NULL) {
+    return 0;
+  }
+  OpenSDFInterner(&(s->interner), a);
+  ti->interner = &(s->interner);
+  return 1;
+}
+
+static inline void ParserCloseInterner(struct TokenIterator *ti, int opened) {
+  if (opened) {
+    ti->interner = NULL;
+  }
+}
+
+// Lists declared without a schema all share one empty schema
+static inline struct StringList* ParserEmptySchema(struct TokenIterator *ti, struct Arena *a) {
+  struct SDF_Interner *in = ParserInterner(ti, a);
+  if (in == NULL) {
+    return NewStringList(a);
+  }
+  if (in->empty_schema == NULL) {
+    in->empty_schema = CopyStringList(NULL, 0, a);
+  }
+  return in->empty_schema;
+}
+
+// Copies the trimmed text of sb for a key into a, interned if in isn't NULL
+static inline char* ParserKey(struct SDF_Interner *in, struct StringBuilder *sb, struct Arena *a, uint32_t *hash) {
+  char *key = StringBuilderTrimInPlace(sb);
+  size_t length = strlen(key);
+  *hash = HashString(key, length);
+  if (in != NULL) {
+    return InternString(in, key, length, *hash);
+  }
+  char *copy = ArenaAlloc(a, length + 1);
+  memcpy(copy, key, length + 1);
+  return copy;
+}
+
+// Numbers need no copy of their text, short strings are interned like keys
+static inline struct ParserValue ParserScalar(struct TokenIterator *ti, char *text, struct Arena *a) {
+  int64_t integer;
+  double real;
+  switch (ParseNumber(text, &integer, &real)) {
+    case NT_INTEGER:
+      return CreateParserValueInteger(integer);
+    case NT_DOUBLE:
+      return CreateParserValueDouble(real);
+    default:
+      break;
+  }
+  size_t length = strlen(text);
+  struct SDF_Interner *in = ParserInterner(ti, a);
+  if (in != NULL && length <= SDF_INTERN_VALUE_MAX) {
+    return CreateParserValueString(InternString(in, text, length, HashString(text, length)));
+  }
+  char *s = ArenaAlloc(a, length + 1);
+  memcpy(s, text, length + 1);
+  return CreateParserValueString(s);
+}
+
+// Like SDFObjectAddKey, for the keys of an object still being parsed. hash is the hash of key
+static inline int ParserScratchAddKey(struct SDF_ParserScratch *s, char *key, uint32_t hash) {
+  struct StringList *keys = s->keys;
+  struct SDF_KeyIndex *index = &(s->index);
+  if (keys->length < SDF_OBJECT_INDEX_THRESHOLD) {
+    for (size_t i = 0; i < keys->length; i++) {
+      if (keys->items[i] == key || strcmp(keys->items[i], key) == 0) {
+        return 0;
+      }
+    }
+    StringListAdd(keys, key);
+    return 1;
+  }
+
+  // Index the keys so far once there are enough, or again in a bigger index
+  if (keys->length == SDF_OBJECT_INDEX_THRESHOLD) {
+    index->capacity = SDF_OBJECT_INDEX_THRESHOLD * 4;
+    if (s->index_slots < index->capacity) {
+      free(index->slots);
+      index->slots = malloc(sizeof(struct SDF_KeySlot) * index->capacity);
+      s->index_slots = index->capacity;
+    }
+    memset(index->slots, 0, sizeof(struct SDF_KeySlot) * index->capacity);
+    for (size_t i = 0; i < keys->length; i++) {
+      SDFKeyIndexInsert(index, HashString(keys->items[i], strlen(keys->items[i])), i);
+    }
+  }
+  else if ((keys->length + 1) * 2 > index->capacity) {
+    struct SDF_KeyIndex grown = {
+      .slots = calloc(index->capacity << 1, sizeof(struct SDF_KeySlot)),
+      .capacity = index->capacity << 1,
+    };
+    for (size_t i = 0; i < index->capacity; i++) {
+      struct SDF_KeySlot slot = index->slots[i];
+      if (slot.position != 0) {
+        SDFKeyIndexInsert(&grown, slot.hash, slot.position - 1);
+      }
+    }
+    free(index->slots);
+    *index = grown;
+    s->index_slots = grown.capacity;
+  }
+  size_t mask = index->capacity - 1;
+  for (size_t i = hash & mask; index->slots[i].position != 0; i = (i + 1) & mask) {
+    struct SDF_KeySlot slot = index->slots[i];
+    char *candidate = keys->items[slot.position - 1];
+    if (slot.hash == hash && (candidate == key || strcmp(candidate, key) == 0)) {
+      return 0;
+    }
+  }
+  StringListAdd(keys, key);
+  SDFKeyIndexInsert(index, hash, keys->length - 1);
+  return 1;
+}
+
+inline int ParserScratchAddKeyCopy(struct SDF_ParserScratch *s, char *key) {
+  if (s->keys == NULL) {
+    s->keys = NewStringList(NULL);
+    s->values = NewParserValueList(NULL);
+  }
+  size_t length = strlen(key);
+  uint32_t hash = HashString(key, length);
+  char *copy = ArenaAlloc(&(s->rows), length + 1);
+  memcpy(copy, key, length + 1);
+  return ParserScratchAddKey(s, copy, hash);
+}
+
+// Moves the object out of the scratch into a, sized to fit, with a shared shape where it can
+static inline struct SDF_Object ParserFinishObject(struct SDF_Interner *in, struct SDF_ParserScratch *s, struct Arena *a) {
+  struct SDF_Object o = {
+    .values = CopyParserValueList(s->values->items, s->values->length, a),
+  };
+  // The scratch index is only in use for objects with enough keys
+  struct SDF_KeyIndex *index = s->keys->length > SDF_OBJECT_INDEX_THRESHOLD ? &(s->index) : NULL;
+  if (in != NULL) {
+    struct SDF_ObjectShape *shape = InternShape(in, s->keys->items, s->keys->length, index);
+    o.keys = &(shape->keys);
+    o.index = shape->index;
+  }
+  else {
+    o.keys = CopyStringList(s->keys->items, s->keys->length, a);
+    o.index = CopySDFKeyIndex(index, a);
+  }
+  return o;
+}
+
+// Turns the rows of a table back into objects, for lists that mix rows with other items
+static inline void SDFListUnpackTable(struct SDF_List *l, struct Arena *a) {
+  struct SDF_Table *t = l->table;
+  // Full rows have the schema for keys, so they share it
+  struct SDF_KeyIndex *index = NewSDFKeyIndex(t->schema);
+  t->schema->shared = 1;
+  for (size_t i = 0; i < t->rows; i++) {
+    size_t length = SDFTableRowLength(t, i);
+    struct SDF_Object o = {
+      .keys = t->schema,
+      .values = NewFixedParserValueList(length, a),
+      .index = index,
+    };
+    if (length < t->schema->length) {
+      o.keys = CopyStringList(t->schema->items, length, a);
+      o.index = NULL;
+    }
+    for (size_t j = 0; j < length; j++) {
+      ParserValueListAdd(o.values, SDFColumnGet(&(t->columns[j]), i));
+    }
+    ParserValueListAdd(l->items, CreateParserValueObject(o));
+  }
+  l->table = NULL;
+}
+
+inline struct SDF_Object ParseObject(struct TokenIterator *ti, struct Arena *a) {
   struct Token t = {};
-  struct StringList schema = CreateStringList();
-  struct StringBuilder sb = CreateStringBuilder();
+  struct StringList *schema = NULL;
+  struct SDF_ParserScratch local, *scratch = AcquireParserScratch(&local);
+  struct StringBuilder *sb = &(scratch->sb);
+  struct SDF_Cleanup cleanup;
+  PushSDFCleanup(&cleanup, ParserScratchCleanup, scratch);
+  int opened = ParserOpenInterner(ti, scratch, a);
+  // The keys of the outermost object can't repeat in it, so it doesn't intern them or its shape
+  struct SDF_Interner *in = opened ? NULL : ParserInterner(ti, a);
+  if (scratch->keys == NULL) {
+    scratch->keys = NewStringList(NULL);
+    scratch->values = NewParserValueList(NULL);
+  }
+  // Keys and values are collected in the scratch until the object is complete
+  struct StringList *keys = scratch->keys;
+  struct ParserValueList *values = scratch->values;
 
   while (GetNextToken(ti, &t)) switch (t.type) {
     case TT_TEXT:
     case TT_NUMBER:
     case TT_STRING:
-    case TT_OTHER:
-      StringBuilderAddString(&sb, t.value);
-      if (o.keys->length > o.values->length) {
+    case TT_OTHER: {
+      StringBuilderAddToken(sb, &t);
+      if (keys->length > values->length) {
         InvalidTokenError(t);
       }
-      ParseKeyText(ti, &sb);
-      StringListAdd(o.keys, StringBuilderTrim(&sb));
-      StringBuilderClear(&sb);
+      ParseKeyText(ti, sb);
+      uint32_t hash;
+      char *key = ParserKey(in, sb, a, &hash);
+      if (!ParserScratchAddKey(scratch, key, hash)) {
+        DuplicateKeyError(t, key);
+      }
+      StringBuilderClear(sb);
       break;
+    }
 
     case TT_EQUALS: {
-      ParseValueText(ti, &sb);
-      char *value = StringBuilderTrim(&sb);
-      if (StringIsNumber(value)) {
-        ParserValueListAdd(o.values, CreateParserValueNumber(strtof(value, NULL)));
-      }
-      else {
-        ParserValueListAdd(o.values, CreateParserValueString(value));
+      if (keys->length == values->length) {
+        InvalidTokenError(t);
       }
-      StringBuilderClear(&sb);
+      ParseValueText(ti, sb);
+      ParserValueListAdd(values, ParserScalar(ti, StringBuilderTrimInPlace(sb), a));
+      StringBuilderClear(sb);
       break;
     }
 
     case TT_LBRACE:
-      if (o.keys->length == o.values->length) {
+      if (keys->length == values->length) {
         InvalidTokenError(t);
       }
-      ParserValueListAdd(o.values, CreateParserValueObject(ParseObject(ti)));
+      ParserValueListAdd(values, CreateParserValueObject(ParseObject(ti, a)));
       break;
 
     case TT_LBRACK:
-      if (o.keys->length == o.values->length) {
+      if (keys->length == values->length) {
         InvalidTokenError(t);
       }
-      ParserValueListAdd(o.values, CreateParserValueList(ParseList(ti, &schema)));
+      if (schema == NULL) {
+        schema = ParserEmptySchema(ti, a);
+      }
+      ParserValueListAdd(values, CreateParserValueList(ParseList(ti, schema, a)));
       break;
 
     case TT_LPAREN:
-      ParseSchema(ti, &schema);
+      schema = NewStringList(a);
+      ParseSchema(ti, schema, a);
       break;
 
     case TT_NEWLINE:
@@ -180,36 +972,169 @@ inline struct SDF_Object ParseObject(struct TokenIterator *ti) {
   }
 
 FunctionReturn:
-  if (o.keys->length > o.values->length) {
-   NoMatchingValueError(o.keys->items[o.keys->length - 1]);
+  if (keys->length > values->length) {
+   NoMatchingValueError(keys->items[keys->length - 1]);
   }
-  free(sb.string);
+  struct SDF_Object o = ParserFinishObject(in, scratch, a);
+  ParserCloseInterner(ti, opened);
+  PopSDFCleanup(&cleanup);
+  ReleaseParserScratch(scratch);
   return o;
 }
 
-inline struct SDF_List ParseList(struct TokenIterator *ti, struct StringList *schema) {
-  struct SDF_List l = CreateSDFList();
-  struct StringBuilder sb = CreateStringBuilder();
-  struct Token t;
-  int ignore_whitespace_and_newlines = 1;
-  struct SDF_Object o = {};
+inline struct SDF_List ParseList(struct TokenIterator *ti, struct StringList *schema, struct Arena *a) {
+  struct SDF_List l;
+  if (ti->jobs > 1 && ParseListParallel(ti, schema, a, &l)) {
+    return l;
+  }
+  l = (struct SDF_List) {
+    .schema = schema,
+    .items = NewParserValueList(a),
+  };
+  struct SDF_ParserScratch local, *scratch = AcquireParserScratch(&local);
+  struct SDF_ListIterator li = CreateSDFListIterator(ti, schema, a);
+  struct ParserValue pv;
+  struct SDF_Cleanup cleanups[2];
+  // Lent to the iterator until the end of the list
+  li.sb = scratch->sb;
+  scratch->sb = (struct StringBuilder) {};
+  PushSDFCleanup(&cleanups[0], ParserScratchCleanup, scratch);
+  PushSDFCleanup(&cleanups[1], StringBuilderCleanup, &(li.sb));
+  int opened = ParserOpenInterner(ti, scratch, a);
 
-  l.schema = schema;
+  // Rows are assembled in a scratch arena and copied into the table's columns
   if (schema->length > 0) {
-    o = CreateSDFObject();
+    l.table = NewSDFTable(schema, a);
+    li.row_arena = &(scratch->rows);
   }
 
-  while (GetNextToken(ti, &t)) {
+  while (SDFListIteratorNext(&li, &pv)) {
+    if (l.table != NULL && li.is_row) {
+      SDFTableAddRow(l.table, &(pv.data.as_object));
+      ArenaReset(&(scratch->rows));
+      continue;
+    }
+    if (l.table != NULL) {
+      SDFListUnpackTable(&l, a);
+      if (li.row.keys != NULL) {
+        struct SDF_Object row = CreateSDFObject(a);
+        for (size_t i = 0; i < li.row.keys->length; i++) {
+          StringListAdd(row.keys, li.row.keys->items[i]);
+          ParserValueListAdd(row.values, li.row.values->items[i]);
+        }
+        li.row = row;
+      }
+      li.row_arena = a;
+    }
+    ParserValueListAdd(l.items, pv);
+  }
+
+  ParserCloseInterner(ti, opened);
+  PopSDFCleanup(&cleanups[1]);
+  PopSDFCleanup(&cleanups[0]);
+  scratch->sb = li.sb;
+  ReleaseParserScratch(scratch);
+  return l;
+}
+
+inline struct SDF_ListIterator CreateSDFListIterator(struct TokenIterator *ti, struct StringList *schema, struct Arena *a) {
+  return (struct SDF_ListIterator) {
+    .ti = ti,
+    .schema = schema,
+    .arena = a,
+    .row_arena = a,
+    .ignore_whitespace_and_newlines = 1,
+  };
+}
+
+inline struct SDF_ListIterator* OpenSDFListIterator(struct TokenIterator *ti) {
+  struct SDF_ListIterator *li = malloc(sizeof(struct SDF_ListIterator));
+  *li = CreateSDFListIterator(ti, NewStringList(NULL), NULL);
+  li->sb = CreateStringBuilder();
+  li->item_arena = CreateArena();
+  li->arena = &(li->item_arena);
+  li->row_arena = li->arena;
+  struct Token t;
+  while (GetNextToken(ti, &t)) switch (t.type) {
+    case TT_TEXT:
+    case TT_NUMBER:
+    case TT_STRING:
+    case TT_OTHER:
+      if (li->key != NULL) {
+        InvalidTokenError(t);
+      }
+      StringBuilderAddToken(&li->sb, &t);
+      ParseKeyText(ti, &li->sb);
+      li->key = StringBuilderTrim(&li->sb, NULL);
+      StringBuilderClear(&li->sb);
+      break;
+
+    case TT_LPAREN:
+      ParseSchema(ti, li->schema, NULL);
+      break;
+
+    case TT_LBRACK:
+      if (li->key == NULL) {
+        InvalidTokenError(t);
+      }
+      return li;
+
+    case TT_NEWLINE:
+    case TT_WHITESPACE:
+      continue;
+
+    default:
+      InvalidTokenError(t);
+  }
+  li->done = 1;
+  return li;
+}
+
+inline void CloseSDFListIterator(struct SDF_ListIterator *li) {
+  for (size_t i = 0; i < li->schema->length; i++) {
+    free(li->schema->items[i]);
+  }
+  free(li->schema->items);
+  free(li->schema);
+  free(li->key);
+  free(li->sb.string);
+  FreeArena(&(li->item_arena));
+  free(li);
+}
+
+static inline void SDFListIteratorAddField(struct SDF_ListIterator *li, struct ParserValue value) {
+  if (li->row.keys == NULL) {
+    li->row = CreateSDFObject(li->row_arena);
+  }
+  // ParseSchema already rejected duplicate keys
+  StringListAdd(li->row.keys, li->schema->items[li->row.keys->length]);
+  ParserValueListAdd(li->row.values, value);
+}
+
+inline int SDFListIteratorNext(struct SDF_ListIterator *li, struct ParserValue *pv) {
+  struct StringList *schema = li->schema;
+  struct Token t;
+
+  li->is_row = 0;
+  if (li->done) {
+    return 0;
+  }
+  // Reclaim the previous item unless a schema row is still being filled
+  if (li->arena == &(li->item_arena) && li->row.keys == NULL) {
+    ArenaReset(li->arena);
+  }
+
+  while (GetNextToken(li->ti, &t)) {
     /*
       Ignore leading newlines and whitespace to avoid empty values
         in the beginning of the list.
     */
-    if (ignore_whitespace_and_newlines) {
+    if (li->ignore_whitespace_and_newlines) {
       if (t.type == TT_NEWLINE || t.type == TT_WHITESPACE) {
         continue;
       }
       else {
-        ignore_whitespace_and_newlines = 0;
+        li->ignore_whitespace_and_newlines = 0;
       }
     }
 
@@ -219,75 +1144,64 @@ inline struct SDF_List ParseList(struct TokenIterator *ti, struct StringList *sc
       case TT_STRING:
       case TT_OTHER:
       case TT_WHITESPACE:
-        StringBuilderAddString(&sb, t.value);
+        StringBuilderAddToken(&li->sb, &t);
         break;
 
       case TT_NEWLINE:
       case TT_SEMICOLON: {
-        char *value = StringBuilderTrim(&sb);
+        struct ParserValue value = ParserScalar(li->ti, StringBuilderTrimInPlace(&li->sb), li->arena);
+        li->ignore_whitespace_and_newlines = 1;
+        StringBuilderClear(&li->sb);
         if (schema->length > 0) {
-          StringListAdd(o.keys, schema->items[o.keys->length]);
-          if (StringIsNumber(value)) {
-            ParserValueListAdd(o.values, CreateParserValueNumber(strtof(value, NULL)));
-          }
-          else {
-            ParserValueListAdd(o.values, CreateParserValueString(value));
-          }
-          if (o.keys->length == schema->length) {
-            ParserValueListAdd(l.items, CreateParserValueObject(o));
-            o = CreateSDFObject();
+          SDFListIteratorAddField(li, value);
+          if (li->row.keys->length == schema->length) {
+            *pv = CreateParserValueObject(li->row);
+            li->row = (struct SDF_Object) {};
+            li->is_row = 1;
+            return 1;
           }
         }
         else {
-          if (StringIsNumber(value)) {
-            ParserValueListAdd(l.items, CreateParserValueNumber(strtof(value, NULL)));
-          }
-          else {
-            ParserValueListAdd(l.items, CreateParserValueString(value));
-          }
+          *pv = value;
+          return 1;
         }
-        ignore_whitespace_and_newlines = 1;
-        StringBuilderClear(&sb);
         break;
       }
 
       case TT_LBRACE: {
-        ParserValueListAdd(l.items, CreateParserValueObject(ParseObject(ti)));
-        ignore_whitespace_and_newlines = 1;
-        break;
+        li->ignore_whitespace_and_newlines = 1;
+        *pv = CreateParserValueObject(ParseObject(li->ti, li->arena));
+        return 1;
       }
 
       case TT_LBRACK: {
-        ParserValueListAdd(l.items, CreateParserValueList(ParseList(ti, schema)));
-        ignore_whitespace_and_newlines = 1;
-        break;
+        li->ignore_whitespace_and_newlines = 1;
+        *pv = CreateParserValueList(ParseList(li->ti, schema, li->arena));
+        return 1;
       }
 
       case TT_RBRACK: {
-        char *value = StringBuilderTrim(&sb);
+        char *text = StringBuilderTrimInPlace(&li->sb);
+        int has_value = text[0] != '\0';
+        struct ParserValue value = has_value ? ParserScalar(li->ti, text, li->arena) : (struct ParserValue) {};
+        StringBuilderClear(&li->sb);
+        li->done = 1;
         if (schema->length > 0) {
-          if (o.keys->length < schema->length && strlen(value) > 0) {
-            StringListAdd(o.keys, schema->items[o.keys->length]);
-            if (StringIsNumber(value)) {
-              ParserValueListAdd(o.values, CreateParserValueNumber(strtof(value, NULL)));
-            }
-            else {
-              ParserValueListAdd(o.values, CreateParserValueString(value));
-            }
+          if (has_value) {
+            SDFListIteratorAddField(li, value);
           }
-          if (o.keys->length > 0) {
-            ParserValueListAdd(l.items, CreateParserValueObject(o));
+          if (li->row.keys != NULL) {
+            *pv = CreateParserValueObject(li->row);
+            li->row = (struct SDF_Object) {};
+            li->is_row = 1;
+            return 1;
           }
         }
-        else if (strlen(value) > 0) {
-          if (StringIsNumber(value)) {
-            ParserValueListAdd(l.items, CreateParserValueNumber(strtof(value, NULL)));
-          }
-          else {
-            ParserValueListAdd(l.items, CreateParserValueString(value));
-          }
+        else if (has_value) {
+          *pv = value;
+          return 1;
         }
-        goto FunctionReturn;
+        return 0;
       }
 
       default:
@@ -295,9 +1209,96 @@ inline struct SDF_List ParseList(struct TokenIterator *ti, struct StringList *sc
     }
   }
 
+  li->done = 1;
+  return 0;
+}
+
+inline int ParseObjectEntry(struct TokenIterator *ti, struct StringList **schema, struct Arena *a, char **key, struct ParserValue *value, struct SDF_Span *span) {
+  struct SDF_ParserScratch local, *scratch = AcquireParserScratch(&local);
+  struct StringBuilder *sb = &(scratch->sb);
+  struct Token t;
+  struct SDF_Cleanup cleanup;
+  PushSDFCleanup(&cleanup, ParserScratchCleanup, scratch);
+  int opened = ParserOpenInterner(ti, scratch, a);
+  struct SDF_Interner *in = opened ? NULL : ParserInterner(ti, a); // As in ParseObject
+  *key = NULL;
+  span->start = SIZE_MAX;
+
+  while (GetNextToken(ti, &t)) {
+    if (t.type == TT_NEWLINE || t.type == TT_WHITESPACE) {
+      continue;
+    }
+    if (span->start == SIZE_MAX) {
+      span->start = t.offset;
+    }
+    switch (t.type) {
+      case TT_TEXT:
+      case TT_NUMBER:
+      case TT_STRING:
+      case TT_OTHER:
+        if (*key != NULL) {
+          InvalidTokenError(t);
+        }
+        StringBuilderAddToken(sb, &t);
+        ParseKeyText(ti, sb);
+        uint32_t hash;
+        *key = ParserKey(in, sb, a, &hash);
+        StringBuilderClear(sb);
+        break;
+
+      case TT_EQUALS:
+        if (*key == NULL) {
+          InvalidTokenError(t);
+        }
+        ParseValueText(ti, sb);
+        *value = ParserScalar(ti, StringBuilderTrimInPlace(sb), a);
+        goto FunctionReturn;
+
+      case TT_LBRACE:
+        if (*key == NULL) {
+          InvalidTokenError(t);
+        }
+        *value = CreateParserValueObject(ParseObject(ti, a));
+        goto FunctionReturn;
+
+      case TT_LBRACK:
+        if (*key == NULL) {
+          InvalidTokenError(t);
+        }
+        *value = CreateParserValueList(ParseList(ti, *schema, a));
+        goto FunctionReturn;
+
+      case TT_LPAREN:
+        *schema = NewStringList(a);
+        ParseSchema(ti, *schema, a);
+        if (*key == NULL) {
+          goto FunctionReturn;
+        }
+        break;
+
+      case TT_RBRACE:
+        goto EndOfObject;
+
+      default:
+        InvalidTokenError(t);
+    }
+  }
+
+EndOfObject:
+  if (*key != NULL) {
+    NoMatchingValueError(*key);
+  }
+  ParserCloseInterner(ti, opened);
+  PopSDFCleanup(&cleanup);
+  ReleaseParserScratch(scratch);
+  return 0;
+
 FunctionReturn:
-  free(sb.string);
-  return l;
+  span->stop = ti->offset;
+  ParserCloseInterner(ti, opened);
+  PopSDFCleanup(&cleanup);
+  ReleaseParserScratch(scratch);
+  return 1;
 }
 
 inline void ParseKeyText(struct TokenIterator *ti, struct StringBuilder *sb) {
@@ -308,7 +1309,7 @@ inline void ParseKeyText(struct TokenIterator *ti, struct StringBuilder *sb) {
       case TT_NUMBER:
       case TT_OTHER:
       case TT_WHITESPACE:
-        StringBuilderAddString(sb, t.value);
+        StringBuilderAddToken(sb, &t);
         break;
       default:
         UngetToken(ti, &t);
@@ -331,27 +1332,40 @@ inline void ParseValueText(struct TokenIterator *ti, struct StringBuilder *sb) {
       UngetToken(ti, &t);
       return;
     default:
-      StringBuilderAddString(sb, t.value);
+      StringBuilderAddToken(sb, &t);
       break;
   }
 }
 
-inline void ParseSchema(struct TokenIterator *ti, struct StringList *schema) {
-  struct StringBuilder sb = CreateStringBuilder();
+inline void ParseSchemaAddKey(struct StringList *schema, char *key, struct Token t) {
+  for (size_t i = 0; i < schema->length; i++) {
+    if (strcmp(schema->items[i], key) == 0) {
+      DuplicateKeyError(t, key);
+    }
+  }
+  StringListAdd(schema, key);
+}
+
+inline void ParseSchema(struct TokenIterator *ti, struct StringList *schema, struct Arena *a) {
+  struct SDF_ParserScratch local, *scratch = AcquireParserScratch(&local);
+  struct StringBuilder *sb = &(scratch->sb);
   struct Token t;
+  struct SDF_Cleanup cleanup;
+  PushSDFCleanup(&cleanup, ParserScratchCleanup, scratch);
   while (GetNextToken(ti, &t)) switch (t.type) {
     case TT_TEXT:
     case TT_NUMBER:
     case TT_OTHER:
     case TT_WHITESPACE:
-      StringBuilderAddString(&sb, t.value);
+      StringBuilderAddToken(sb, &t);
       break;
     case TT_NEWLINE:
     case TT_SEMICOLON: {
-      if (sb.length > 0) {
-        char *key = StringBuilderTrim(&sb);
-        StringListAdd(schema, key);
-        StringBuilderClear(&sb);
+      if (sb->length > 0) {
+        uint32_t hash;
+        char *key = ParserKey(ParserInterner(ti, a), sb, a, &hash);
+        ParseSchemaAddKey(schema, key, t);
+        StringBuilderClear(sb);
       }
       else {
         InvalidTokenError(t);
@@ -360,10 +1374,11 @@ inline void ParseSchema(struct TokenIterator *ti, struct StringList *schema) {
       break;
     }
     case TT_RPAREN: {
-      if (sb.length > 0) {
-        char *key = StringBuilderTrim(&sb);
-        StringListAdd(schema, key);
-        StringBuilderClear(&sb);
+      if (sb->length > 0) {
+        uint32_t hash;
+        char *key = ParserKey(ParserInterner(ti, a), sb, a, &hash);
+        ParseSchemaAddKey(schema, key, t);
+        StringBuilderClear(sb);
       }
       goto FunctionReturn;
     }
@@ -371,5 +1386,6 @@ inline void ParseSchema(struct TokenIterator *ti, struct StringList *schema) {
       InvalidTokenError(t);
   }
 FunctionReturn:
-  free(sb.string);
+  PopSDFCleanup(&cleanup);
+  ReleaseParserScratch(scratch);
 }
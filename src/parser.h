@@ -5,10 +5,12 @@
 #include <stdlib.h>
 #endif
 
+#include "format.h"
 #include "tokenizer.h"
 #include "util.h"
 
 #define InvalidTokenError(t)\
+  RaiseSDFError(SE_INVALID_TOKEN, t.ln, t.col, t.type, t.value, t.length);\
   fprintf(\
     stderr,\
     "Error occurred in file %s, line %d:\n"\
@@ -18,6 +20,7 @@
   exit(1);
 
 #define UndefinedKeyError(t, key)\
+  RaiseSDFError(SE_UNDEFINED_KEY, t.ln, t.col, t.type, key, strlen(key));\
   fprintf(\
     stderr,\
     "Error occurred in file %s, line %d:\n"\
@@ -26,7 +29,18 @@
   );\
   exit(1);
 
+#define DuplicateKeyError(t, key)\
+  RaiseSDFError(SE_DUPLICATE_KEY, t.ln, t.col, t.type, key, strlen(key));\
+  fprintf(\
+    stderr,\
+    "Error occurred in file %s, line %d:\n"\
+    "Duplicate key (Ln: %d, Col: %d): %s\n",\
+    __FILE__, __LINE__, t.ln, t.col, key\
+  );\
+  exit(1);
+
 #define NoMatchingValueError(key)\
+  RaiseSDFError(SE_NO_MATCHING_VALUE, 0, 0, -1, key, strlen(key));\
   fprintf(\
     stderr,\
     "Error occurred in file %s, line %d:\n"\
@@ -35,34 +49,94 @@
   );\
   exit(1);
 
+// Objects with more keys than this get a hash index for lookups
+#define SDF_OBJECT_INDEX_THRESHOLD 8
+
+struct SDF_KeySlot {
+  uint32_t hash;
+  uint32_t position; // Key position + 1, 0 for an empty slot
+};
+
+// Open addressing with linear probing, kept at most half full
+struct SDF_KeyIndex {
+  struct SDF_KeySlot *slots;
+  size_t capacity;
+};
+
 struct SDF_Object {
   struct StringList *keys;
   struct ParserValueList *values;
+  struct SDF_KeyIndex *index;
 };
 
-struct SDF_Object CreateSDFObject(void);
+struct SDF_Object CreateSDFObject(struct Arena *a);
+int SDFObjectAddKey(struct SDF_Object *o, char *key);
+struct ParserValue* SDFObjectGet(struct SDF_Object *o, char *key);
+struct ParserValue* SDFObjectGetHashed(struct SDF_Object *o, char *key, size_t length, uint32_t hash);
 void SDFObjectToString(struct SDF_Object *o, struct StringBuilder *sb);
 
+// Lists with a schema keep their rows in `table` instead of `items`
 struct SDF_List {
   struct StringList *schema;
   struct ParserValueList *items;
+  struct SDF_Table *table;
 };
 
-struct SDF_List CreateSDFList(void);
+struct SDF_List CreateSDFList(struct Arena *a);
+size_t SDFListLength(struct SDF_List *l);
+struct ParserValue SDFListGetItem(struct SDF_List *l, size_t i);
 void SDFListToString(struct SDF_List *l, struct StringBuilder *sb);
 
+enum SDF_ColumnType {
+  SCT_INTEGER,
+  SCT_DOUBLE,
+  SCT_STRING,
+  SCT_VALUE, // Mixed types
+};
+
+struct SDF_Column {
+  enum SDF_ColumnType type;
+  union {
+    int64_t *as_integer;
+    double *as_double;
+    char **as_string;
+    struct ParserValue *as_value;
+  } data;
+};
+
+/*
+  Rows of a schema list stored column by column, one column per schema field.
+  Only the last row can be short, when the list ended in the middle of it.
+*/
+struct SDF_Table {
+  struct StringList *schema;
+  struct SDF_Column *columns;
+  size_t rows, capacity, last_row_length;
+  struct Arena *arena;
+};
+
+// A row of an SDF_Table, which behaves like an object keyed by the schema
+struct SDF_Row {
+  struct SDF_Table *table;
+  size_t index;
+};
+
 enum ParserValueType {
   PVT_STRING,
-  PVT_NUMBER,
+  PVT_INTEGER,
+  PVT_DOUBLE,
   PVT_OBJECT,
   PVT_LIST,
+  PVT_ROW,
 };
 
 union ParserData {
   char *as_string;
-  float as_float;
+  int64_t as_integer;
+  double as_double;
   struct SDF_Object as_object;
   struct SDF_List as_list;
+  struct SDF_Row as_row;
 };
 
 struct ParserValue {
@@ -72,22 +146,166 @@ struct ParserValue {
 
 void ParserValueToString(struct ParserValue *pv, struct StringBuilder *sb);
 struct ParserValue CreateParserValueString(char *s);
-struct ParserValue CreateParserValueNumber(float f);
+struct ParserValue CreateParserValueInteger(int64_t i);
+struct ParserValue CreateParserValueDouble(double d);
+struct ParserValue CreateParserValueScalar(char *s);
 struct ParserValue CreateParserValueObject(struct SDF_Object o);
 struct ParserValue CreateParserValueList(struct SDF_List l);
+struct ParserValue CreateParserValueRow(struct SDF_Table *t, size_t i);
+
+struct SDF_Table* NewSDFTable(struct StringList *schema, struct Arena *a);
+void SDFTableAddRow(struct SDF_Table *t, struct SDF_Object *row);
+void SDFTableAppend(struct SDF_Table *t, struct SDF_Table *src);
+size_t SDFTableRowLength(struct SDF_Table *t, size_t row);
+int SDFTableGetField(struct SDF_Table *t, size_t row, size_t field, struct ParserValue *pv);
+long SDFTableFindField(struct SDF_Table *t, char *key, size_t length);
+void SDFRowToString(struct SDF_Row *r, struct StringBuilder *sb);
 
 struct ParserValueList {
   struct ParserValue *items;
   size_t capacity, length;
+  struct Arena *arena;
 };
 
-struct ParserValueList* NewParserValueList(void);
+struct ParserValueList* NewParserValueList(struct Arena *a);
 void ParserValueListAdd(struct ParserValueList *pvl, struct ParserValue pv);
 
+// Values up to this long that aren't numbers are interned like keys
+#define SDF_INTERN_VALUE_MAX 32
+
+/*
+  The keys of an object. Objects parsed with the same keys in the same
+  order share one shape: their `keys` and `index` point into it, and
+  SDFObjectAddKey gives an object its own copy before adding a key.
+*/
+struct SDF_ObjectShape {
+  struct StringList keys;
+  struct SDF_KeyIndex *index;
+};
+
+struct SDF_InternSlot {
+  uint32_t hash;
+  uint32_t length;
+  void *p; // NULL for an empty slot
+};
+
+// Open addressing with linear probing, kept at most half full
+struct SDF_InternMap {
+  struct SDF_InternSlot *slots;
+  size_t capacity, count;
+};
+
+/*
+  Everything shared between the objects of one parse: keys and short
+  values, stored once in the arena, object shapes and the schema of lists
+  declared without one. The maps are scratch memory, the strings and
+  shapes they point to live as long as the tree.
+*/
+struct SDF_Interner {
+  struct SDF_InternMap strings, shapes;
+  struct StringList *empty_schema;
+  struct Arena *arena;
+};
+
+/*
+  Scratch memory of one object, list or schema being parsed: builders for
+  the text of keys and values, the keys, values and key index of an object
+  until its size is known, an arena for the schema rows of a list, the
+  schema of an object parsed into events, and the interner of a document
+  when this is its outermost parse.
+*/
+struct SDF_ParserScratch {
+  struct StringBuilder sb, key;
+  struct StringList *keys;
+  struct ParserValueList *values;
+  struct SDF_KeyIndex index;
+  size_t index_slots; // Allocated for index, which uses capacity of them
+  struct Arena rows;
+  struct StringList schema;
+  struct SDF_Interner interner;
+  struct SDF_ParserContext *context;
+  struct SDF_ParserScratch *next;
+};
+
+/*
+  Keeps the scratch memory of finished parses for the next ones, so
+  parsing similar documents back to back stops allocating once the
+  buffers have grown to fit them. Each nesting level takes one scratch
+  and hands it back when it returns, also when an error trap unwinds it.
+*/
+struct SDF_ParserContext {
+  struct SDF_ParserScratch *free;
+};
+
+/*
+  While set, parses on this thread take their scratch memory from this
+  context, otherwise every parse allocates and frees its own. Threads a
+  parse starts have none.
+*/
+extern _Thread_local struct SDF_ParserContext *sdf_parser_context;
+
+struct SDF_ParserContext CreateSDFParserContext(void);
+void FreeSDFParserContext(struct SDF_ParserContext *c);
+// Sets sdf_parser_context and returns the one it replaces
+struct SDF_ParserContext* UseSDFParserContext(struct SDF_ParserContext *c);
+// Uses local when there is no context. The builders come back empty
+struct SDF_ParserScratch* AcquireParserScratch(struct SDF_ParserScratch *local);
+void ReleaseParserScratch(struct SDF_ParserScratch *s);
+// Cleanups for an SDF_ErrorTrap: releases a scratch, or restores a previous context
+void ParserScratchCleanup(void *s);
+void ParserContextCleanup(void *previous);
+/*
+  For parsers that don't keep keys, like the event parsers: remembers a
+  key of the object the scratch belongs to, copied into its `rows` arena.
+  Returns 0 if the object had the key already.
+*/
+int ParserScratchAddKeyCopy(struct SDF_ParserScratch *s, char *key);
+
 void ParseKeyText(struct TokenIterator *ti, struct StringBuilder *sb);
 void ParseValueText(struct TokenIterator *ti, struct StringBuilder *sb);
-struct SDF_Object ParseObject(struct TokenIterator *ti);
-struct SDF_List ParseList(struct TokenIterator *ti, struct StringList *schema);
-void ParseSchema(struct TokenIterator *ti, struct StringList *sl);
+/*
+  Everything a parse returns is allocated from the arena, so the whole tree
+  is released with FreeArena (or ArenaReset before parsing the next document).
+*/
+struct SDF_Object ParseObject(struct TokenIterator *ti, struct Arena *a);
+struct SDF_List ParseList(struct TokenIterator *ti, struct StringList *schema, struct Arena *a);
+void ParseSchema(struct TokenIterator *ti, struct StringList *sl, struct Arena *a);
+void ParseSchemaAddKey(struct StringList *schema, char *key, struct Token t);
+
+// Byte offsets of the first byte of something in the input and of the byte after it
+struct SDF_Span {
+  size_t start, stop;
+};
+
+/*
+  Parses the next entry of an object: a key with its value, or a schema
+  declared on its own, which leaves *key NULL. A schema replaces *schema
+  for the entries after it. Returns 0 at the end of the object. It
+  accepts and rejects the same input as ParseObject.
+*/
+int ParseObjectEntry(struct TokenIterator *ti, struct StringList **schema, struct Arena *a, char **key, struct ParserValue *value, struct SDF_Span *span);
+
+/*
+  Pulls the items of a list one at a time. OpenSDFListIterator reads the
+  leading `key (schema) [` of a document whose first value is a list, and
+  each SDFListIteratorNext reuses the memory of the item returned before it.
+  Schema rows come out as objects, with `is_row` set.
+*/
+struct SDF_ListIterator {
+  struct TokenIterator *ti;
+  struct StringList *schema;
+  struct Arena *arena, item_arena;
+  struct StringBuilder sb;
+  struct Arena *row_arena;
+  struct SDF_Object row;
+  char *key;
+  int ignore_whitespace_and_newlines, done, is_row;
+};
+
+// Leaves sb to the caller, which must give the iterator a builder before using it
+struct SDF_ListIterator CreateSDFListIterator(struct TokenIterator *ti, struct StringList *schema, struct Arena *a);
+struct SDF_ListIterator* OpenSDFListIterator(struct TokenIterator *ti);
+void CloseSDFListIterator(struct SDF_ListIterator *li);
+int SDFListIteratorNext(struct SDF_ListIterator *li, struct ParserValue *pv);
 
 #endif
@@ -0,0 +1,417 @@
+#include "push.h"
+
+static inline void EmitScalar(struct SDF_EventHandler *h, char *s) {
+  struct ParserValue pv = CreateParserValueScalar(s);
+  EmitEvent(h, value, &pv);
+}
+
+static inline void FreeSchema(struct StringList *schema) {
+  for (size_t i = 0; i < schema->length; i++) {
+    free(schema->items[i]);
+  }
+  schema->length = 0;
+}
+
+static inline struct SDF_Frame* SDFPushParserPush(struct SDF_PushParser *p, enum SDF_FrameType type) {
+  if (p->depth >= p->capacity) {
+    size_t capacity = p->capacity << 1;
+    p->frames = realloc(p->frames, sizeof(struct SDF_Frame) * capacity);
+    memset(&(p->frames[p->capacity]), 0, sizeof(struct SDF_Frame) * (capacity - p->capacity));
+    p->capacity = capacity;
+  }
+  struct SDF_Frame *parent = p->depth > 0 ? &(p->frames[p->depth - 1]) : NULL;
+  struct SDF_Frame *f = &(p->frames[p->depth++]);
+  if (f->key.string == NULL) {
+    f->key = CreateStringBuilder();
+    f->text = CreateStringBuilder();
+  }
+  f->type = type;
+  f->state = SFS_READY;
+  f->has_key = 0;
+  f->ignore_whitespace_and_newlines = 1;
+  f->fields = 0;
+
+  if (type == SFT_OBJECT) {
+    f->schema = NewStringList(NULL);
+    EmitEvent(p->h, begin_object);
+  }
+  else {
+    f->schema = parent->schema;
+    EmitEvent(p->h, begin_list);
+    if (f->schema->length > 0) {
+      EmitEvent(p->h, schema, f->schema);
+    }
+  }
+  return f;
+}
+
+static inline void SDFPushParserPop(struct SDF_PushParser *p) {
+  struct SDF_Frame *f = &(p->frames[--p->depth]);
+  if (f->type == SFT_OBJECT) {
+    if (f->has_key) {
+      NoMatchingValueError(StringBuilderTrimInPlace(&f->key));
+    }
+    EmitEvent(p->h, end_object);
+    FreeSchema(f->schema);
+    free(f->schema->items);
+    free(f->schema);
+  }
+  else {
+    EmitEvent(p->h, end_list);
+  }
+  StringBuilderClear(&f->key);
+  StringBuilderClear(&f->text);
+  if (f->seen.keys != NULL) {
+    f->seen.keys->length = 0;
+  }
+  ArenaReset(&(f->seen.rows));
+  f->schema = NULL;
+}
+
+// Ends the key being read, which the object must not have already
+static inline void SDFPushParserEndKey(struct SDF_PushParser *p, struct SDF_Frame *f) {
+  char *key = StringBuilderTrimInPlace(&f->key);
+  if (!ParserScratchAddKeyCopy(&(f->seen), key)) {
+    DuplicateKeyError(f->key_start, key);
+  }
+  EmitEvent(p->h, key, key);
+  f->has_key = 1;
+}
+
+/*
+  Adds the value of the next field of a schema row. As in ParseListEvents
+  rows are held back until they are complete, in the `key` builder list
+  frames don't otherwise use, with a '\0' after each value.
+*/
+static inline void SDFPushParserAddField(struct SDF_Frame *f, char *value) {
+  StringBuilderAddString(&f->key, value);
+  StringBuilderAddChar(&f->key, '\0');
+  f->fields += 1;
+}
+
+static inline void SDFPushParserEmitRow(struct SDF_PushParser *p, struct SDF_Frame *f) {
+  char *value = f->key.string;
+  EmitEvent(p->h, begin_object);
+  for (size_t i = 0; i < f->fields; i++) {
+    EmitEvent(p->h, key, f->schema->items[i]);
+    EmitScalar(p->h, value);
+    value += strlen(value) + 1;
+  }
+  EmitEvent(p->h, end_object);
+  StringBuilderClear(&f->key);
+  f->fields = 0;
+}
+
+// Same rules as ParseObjectEvents. Returns 0 when t must be handled again
+static inline int SDFPushParserObjectToken(struct SDF_PushParser *p, struct SDF_Frame *f, struct Token *t) {
+  switch (f->state) {
+    case SFS_KEY:
+      switch (t->type) {
+        case TT_TEXT:
+        case TT_NUMBER:
+        case TT_OTHER:
+        case TT_WHITESPACE:
+          StringBuilderAddToken(&f->key, t);
+          return 1;
+        default:
+          SDFPushParserEndKey(p, f);
+          f->state = SFS_READY;
+          return 0;
+      }
+
+    case SFS_VALUE:
+      switch (t->type) {
+        case TT_LBRACK:
+        case TT_RBRACK:
+        case TT_LBRACE:
+          InvalidTokenError((*t));
+        case TT_NEWLINE:
+        case TT_SEMICOLON:
+        case TT_RBRACE:
+          EmitScalar(p->h, StringBuilderTrimInPlace(&f->text));
+          StringBuilderClear(&f->text);
+          f->has_key = 0;
+          f->state = SFS_READY;
+          return t->type != TT_RBRACE;
+        default:
+          StringBuilderAddToken(&f->text, t);
+          return 1;
+      }
+
+    case SFS_SCHEMA:
+      switch (t->type) {
+        case TT_TEXT:
+        case TT_NUMBER:
+        case TT_OTHER:
+        case TT_WHITESPACE:
+          StringBuilderAddToken(&f->text, t);
+          return 1;
+        case TT_NEWLINE:
+        case TT_SEMICOLON:
+        case TT_RPAREN:
+          if (f->text.length > 0) {
+            ParseSchemaAddKey(f->schema, StringBuilderTrim(&f->text, NULL), *t);
+            StringBuilderClear(&f->text);
+          }
+          else if (t->type != TT_RPAREN) {
+            InvalidTokenError((*t));
+          }
+          if (t->type == TT_RPAREN) {
+            f->state = SFS_READY;
+          }
+          return 1;
+        default:
+          InvalidTokenError((*t));
+      }
+
+    case SFS_READY:
+      break;
+  }
+
+  switch (t->type) {
+    case TT_TEXT:
+    case TT_NUMBER:
+    case TT_STRING:
+    case TT_OTHER:
+      if (f->has_key) {
+        InvalidTokenError((*t));
+      }
+      StringBuilderClear(&f->key);
+      StringBuilderAddToken(&f->key, t);
+      f->key_start = *t;
+      f->state = SFS_KEY;
+      break;
+
+    case TT_EQUALS:
+      if (!f->has_key) {
+        InvalidTokenError((*t));
+      }
+      f->state = SFS_VALUE;
+      break;
+
+    case TT_LBRACE:
+    case TT_LBRACK:
+      if (!f->has_key) {
+        InvalidTokenError((*t));
+      }
+      f->has_key = 0;
+      SDFPushParserPush(p, t->type == TT_LBRACE ? SFT_OBJECT : SFT_LIST);
+      break;
+
+    case TT_LPAREN:
+      // A new schema replaces the previous one
+      FreeSchema(f->schema);
+      f->state = SFS_SCHEMA;
+      break;
+
+    case TT_NEWLINE:
+    case TT_WHITESPACE:
+      break;
+
+    case TT_RBRACE:
+      SDFPushParserPop(p);
+      break;
+
+    default:
+      InvalidTokenError((*t));
+  }
+  return 1;
+}
+
+// Same rules as ParseListEvents
+static inline void SDFPushParserListToken(struct SDF_PushParser *p, struct SDF_Frame *f, struct Token *t) {
+  if (f->ignore_whitespace_and_newlines) {
+    if (t->type == TT_NEWLINE || t->type == TT_WHITESPACE) {
+      return;
+    }
+    f->ignore_whitespace_and_newlines = 0;
+  }
+
+  switch (t->type) {
+    case TT_TEXT:
+    case TT_NUMBER:
+    case TT_STRING:
+    case TT_OTHER:
+    case TT_WHITESPACE:
+      StringBuilderAddToken(&f->text, t);
+      break;
+
+    case TT_NEWLINE:
+    case TT_SEMICOLON: {
+      char *value = StringBuilderTrimInPlace(&f->text);
+      if (f->schema->length > 0) {
+        SDFPushParserAddField(f, value);
+        if (f->fields == f->schema->length) {
+          SDFPushParserEmitRow(p, f);
+        }
+      }
+      else {
+        EmitScalar(p->h, value);
+      }
+      f->ignore_whitespace_and_newlines = 1;
+      StringBuilderClear(&f->text);
+      break;
+    }
+
+    case TT_LBRACE:
+    case TT_LBRACK:
+      f->ignore_whitespace_and_newlines = 1;
+      SDFPushParserPush(p, t->type == TT_LBRACE ? SFT_OBJECT : SFT_LIST);
+      break;
+
+    case TT_RBRACK: {
+      char *value = StringBuilderTrimInPlace(&f->text);
+      if (f->schema->length > 0) {
+        if (strlen(value) > 0) {
+          SDFPushParserAddField(f, value);
+        }
+        if (f->fields > 0) {
+          SDFPushParserEmitRow(p, f);
+        }
+      }
+      else if (strlen(value) > 0) {
+        EmitScalar(p->h, value);
+      }
+      SDFPushParserPop(p);
+      break;
+    }
+
+    default:
+      InvalidTokenError((*t));
+  }
+}
+
+// Handles every complete token in the buffer
+static inline void SDFPushParserRun(struct SDF_PushParser *p) {
+  struct Token t;
+  while (p->depth > 0 && GetNextToken(&p->ti, &t)) {
+    struct SDF_Frame *f = &(p->frames[p->depth - 1]);
+    if (f->type == SFT_LIST) {
+      SDFPushParserListToken(p, f, &t);
+      continue;
+    }
+    while (!SDFPushParserObjectToken(p, f, &t));
+  }
+}
+
+/*
+  Whether the token held back at the start of the buffer can end now
+  that bytes were added after its first `held`. Scanning goes on from its
+  last byte, which the token's scan would have passed over the same way,
+  except for the '.' of a number, which is taken as a possible end.
+*/
+static inline int SDFPushParserHeldTokenEnds(struct SDF_PushParser *p) {
+  struct TokenIterator *ti = &(p->ti);
+  char *s = ti->buffer;
+  size_t from = p->held - 1;
+  switch (CharToTokenType(s[0])) {
+    case TT_TEXT:
+      return ScanTextToken(ti, from) < ti->length;
+    case TT_NUMBER:
+      return ScanNumberToken(ti, from) < ti->length || memchr(s + from, '.', ti->length - from) != NULL;
+    case TT_WHITESPACE:
+      return ScanWhiteSpaceToken(ti, from) < ti->length;
+    case TT_NEWLINE:
+      return ScanNewLineToken(ti, from) < ti->length;
+    case TT_STRING: {
+      size_t i = from > 0 ? from : 1;
+      char *quote;
+      while ((quote = memchr(s + i, '"', ti->length - i)) != NULL) {
+        i = quote - s;
+        // As in ScanStringToken, the quote is escaped if an odd number of backslashes precede it
+        size_t backslashes = 0;
+        while (i - backslashes > 1 && s[i - backslashes - 1] == '\\') {
+          backslashes++;
+        }
+        if (backslashes % 2 == 0) {
+          return 1;
+        }
+        i++;
+      }
+      return 0;
+    }
+    default:
+      return 1;
+  }
+}
+
+inline struct SDF_PushParser CreateSDFPushParser(struct SDF_EventHandler *h) {
+  const size_t capacity = 8;
+  struct SDF_PushParser p = {
+    .h = h,
+    .buffer = CreateStringBuilder(),
+    .frames = calloc(capacity, sizeof(struct SDF_Frame)),
+    .capacity = capacity,
+  };
+  p.ti = CreateBufferTokenIterator(p.buffer.string, 0);
+  p.ti.eof = 0;
+  SDFPushParserPush(&p, SFT_OBJECT);
+  return p;
+}
+
+inline void SDFPushParserFeed(struct SDF_PushParser *p, const char *bytes, size_t length) {
+  struct TokenIterator *ti = &(p->ti);
+  // Nothing after the closing brace of the document is read
+  if (p->depth == 0 || length == 0) {
+    return;
+  }
+
+  // Keep the unfinished tail and add the new bytes after it
+  if (ti->offset > 0) {
+    p->buffer.length = ti->length - ti->offset;
+    memmove(p->buffer.string, p->buffer.string + ti->offset, p->buffer.length);
+  }
+  StringBuilderReserve(&p->buffer, length);
+  memcpy(p->buffer.string + p->buffer.length, bytes, length);
+  p->buffer.length += length;
+
+  ti->buffer = p->buffer.string;
+  ti->length = p->buffer.length;
+  ti->offset = 0;
+  ti->block = SIZE_MAX;
+  if (p->held > 0 && !SDFPushParserHeldTokenEnds(p)) {
+    p->held = ti->length;
+    return;
+  }
+  SDFPushParserRun(p);
+  p->held = ti->length - ti->offset;
+}
+
+inline void SDFPushParserFinish(struct SDF_PushParser *p) {
+  p->ti.eof = 1;
+  SDFPushParserRun(p);
+
+  // Close what is left open the way the recursive parsers do at the end of a file
+  while (p->depth > 0) {
+    struct SDF_Frame *f = &(p->frames[p->depth - 1]);
+    if (f->type == SFT_OBJECT) {
+      if (f->state == SFS_KEY) {
+        SDFPushParserEndKey(p, f);
+      }
+      else if (f->state == SFS_VALUE) {
+        EmitScalar(p->h, StringBuilderTrimInPlace(&f->text));
+        f->has_key = 0;
+      }
+    }
+    SDFPushParserPop(p);
+  }
+}
+
+inline void FreeSDFPushParser(struct SDF_PushParser *p) {
+  while (p->depth > 0) {
+    struct SDF_Frame *f = &(p->frames[--p->depth]);
+    if (f->type == SFT_OBJECT) {
+      FreeSchema(f->schema);
+      free(f->schema->items);
+      free(f->schema);
+    }
+  }
+  for (size_t i = 0; i < p->capacity; i++) {
+    free(p->frames[i].key.string);
+    free(p->frames[i].text.string);
+    ReleaseParserScratch(&(p->frames[i].seen));
+  }
+  free(p->frames);
+  free(p->buffer.string);
+  *p = (struct SDF_PushParser) {};
+}
@@ -0,0 +1,65 @@
+#ifndef PUSH_H
+#define PUSH_H
+
+#include "events.h"
+#include "parser.h"
+#include "tokenizer.h"
+#include "util.h"
+
+enum SDF_FrameType {
+  SFT_OBJECT,
+  SFT_LIST,
+};
+
+// What an object frame is in the middle of
+enum SDF_FrameState {
+  SFS_READY,
+  SFS_KEY,     // Key text, as ParseKeyText
+  SFS_VALUE,   // Text after =, as ParseValueText
+  SFS_SCHEMA,  // Keys between ( and ), as ParseSchema
+};
+
+/*
+  One open object or list. Objects own the schema their lists use, lists
+  borrow the one of the closest object. Lists keep the schema row being
+  filled in `key`. Objects remember their keys in `seen` to reject
+  duplicates. `key`, `text` and `seen` keep their allocations when the
+  frame is popped so deeper levels reuse them.
+*/
+struct SDF_Frame {
+  enum SDF_FrameType type;
+  enum SDF_FrameState state;
+  struct StringList *schema;
+  struct StringBuilder key, text;
+  struct SDF_ParserScratch seen;
+  struct Token key_start; // For errors about the key in `key`
+  int has_key;
+  int ignore_whitespace_and_newlines;
+  size_t fields;
+};
+
+/*
+  Parses a document handed over in chunks of any size, e.g. as reads from
+  a socket return, and emits the same events as ParseObjectEvents would
+  for the whole document. Every complete token is handled as soon as it
+  arrives, and a token cut by a chunk boundary is held back until the
+  rest arrives, so only that token is kept between calls. Only the bytes
+  fed after a held back token are checked for its end before it is
+  scanned again, so a long token fed a byte at a time stays linear.
+*/
+struct SDF_PushParser {
+  struct SDF_EventHandler *h;
+  struct TokenIterator ti;
+  struct StringBuilder buffer;
+  size_t held; // Bytes of the token held back by the last call
+  struct SDF_Frame *frames;
+  size_t depth, capacity;
+};
+
+struct SDF_PushParser CreateSDFPushParser(struct SDF_EventHandler *h);
+void SDFPushParserFeed(struct SDF_PushParser *p, const char *bytes, size_t length);
+// Ends the input, closing whatever is still open as the end of a file would
+void SDFPushParserFinish(struct SDF_PushParser *p);
+void FreeSDFPushParser(struct SDF_PushParser *p);
+
+#endif
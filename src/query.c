@@ -0,0 +1,142 @@
+#include "query.h"
+
+static inline void SDFPathAddStep(struct SDF_Path *path, struct SDF_PathStep step) {
+  if (path->length >= path->capacity) {
+    path->capacity = path->capacity > 0 ? path->capacity << 1 : 8;
+    path->steps = realloc(path->steps, sizeof(struct SDF_PathStep) * path->capacity);
+  }
+  path->steps[path->length] = step;
+  path->length += 1;
+}
+
+// Returns 0 if the expression is malformed
+inline int CompileSDFPath(char *expression, struct SDF_Path *path) {
+  char *s = expression;
+  *path = (struct SDF_Path) {};
+  while (*s != '\0') {
+    struct SDF_PathStep step = {};
+    if (*s == '[') {
+      s++;
+      if (*s == '*') {
+        step.type = PST_WILDCARD;
+        s++;
+      }
+      else if (CharIsDigit(*s)) {
+        step.type = PST_INDEX;
+        step.index = strtoull(s, &s, 10);
+      }
+      else {
+        goto Error;
+      }
+      if (*s != ']') {
+        goto Error;
+      }
+      s++;
+    }
+    else {
+      // Only the first step may be a key without a leading `.`
+      if ((*s == '.') != (path->length > 0)) {
+        goto Error;
+      }
+      if (*s == '.') {
+        s++;
+      }
+      size_t length = strcspn(s, ".[");
+      if (length == 0) {
+        goto Error;
+      }
+      step.type = PST_KEY;
+      step.key = malloc(length + 1);
+      memcpy(step.key, s, length);
+      step.key[length] = '\0';
+      step.length = length;
+      step.hash = HashString(s, length);
+      s += length;
+    }
+    SDFPathAddStep(path, step);
+  }
+  return 1;
+
+Error:
+  FreeSDFPath(path);
+  return 0;
+}
+
+inline void FreeSDFPath(struct SDF_Path *path) {
+  for (size_t i = 0; i < path->length; i++) {
+    free(path->steps[i].key);
+  }
+  free(path->steps);
+  *path = (struct SDF_Path) {};
+}
+
+/*
+  Walks the steps from `i` onwards. With `results` every match is collected,
+  without it the walk stops at the first match, which is stored in `match`.
+*/
+static int SDFPathWalk(struct SDF_Path *path, size_t i, struct ParserValue pv, struct ParserValueList *results, struct ParserValue *match) {
+  for (; i < path->length; i++) {
+    struct SDF_PathStep *step = &(path->steps[i]);
+    switch (step->type) {
+      case PST_KEY:
+        if (pv.type == PVT_ROW) {
+          long field = SDFTableFindField(pv.data.as_row.table, step->key, step->length);
+          if (field < 0 || !SDFTableGetField(pv.data.as_row.table, pv.data.as_row.index, field, &pv)) {
+            return 0;
+          }
+        }
+        else if (pv.type == PVT_OBJECT) {
+          struct ParserValue *value = SDFObjectGetHashed(&(pv.data.as_object), step->key, step->length, step->hash);
+          if (value == NULL) {
+            return 0;
+          }
+          pv = *value;
+        }
+        else {
+          return 0;
+        }
+        break;
+
+      case PST_INDEX:
+        if (pv.type != PVT_LIST || step->index >= SDFListLength(&(pv.data.as_list))) {
+          return 0;
+        }
+        pv = SDFListGetItem(&(pv.data.as_list), step->index);
+        break;
+
+      case PST_WILDCARD: {
+        if (pv.type != PVT_LIST) {
+          return 0;
+        }
+        int found = 0;
+        for (size_t j = 0; j < SDFListLength(&(pv.data.as_list)); j++) {
+          struct ParserValue item = SDFListGetItem(&(pv.data.as_list), j);
+          found |= SDFPathWalk(path, i + 1, item, results, match);
+          if (found && results == NULL) {
+            return 1;
+          }
+        }
+        return found;
+      }
+    }
+  }
+  if (results != NULL) {
+    ParserValueListAdd(results, pv);
+  }
+  if (match != NULL) {
+    *match = pv;
+  }
+  return 1;
+}
+
+// Returns 0 if nothing matches, otherwise stores the first match in `result`
+inline int SDFPathGet(struct SDF_Path *path, struct ParserValue *root, struct ParserValue *result) {
+  return SDFPathWalk(path, 0, *root, NULL, result);
+}
+
+// Adds every match to `results` and returns how many there were
+inline size_t SDFPathQuery(struct SDF_Path *path, struct ParserValue *root, struct ParserValueList *results) {
+  size_t length = results->length;
+  SDFPathWalk(path, 0, *root, results, NULL);
+  return results->length - length;
+}
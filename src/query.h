@@ -0,0 +1,37 @@
+#ifndef QUERY_H
+#define QUERY_H
+
+#include "parser.h"
+#include "util.h"
+
+enum SDF_PathStepType {
+  PST_KEY,      // .name
+  PST_INDEX,    // [3]
+  PST_WILDCARD, // [*]
+};
+
+struct SDF_PathStep {
+  enum SDF_PathStepType type;
+  char *key;
+  size_t length;
+  uint32_t hash;
+  size_t index;
+};
+
+/*
+  A path like `servers[*].port`, compiled once so that evaluating it
+  against many documents does no parsing or key hashing.
+  Keys run until the next `.` or `[`, and every key but a leading one
+  starts with `.`.
+*/
+struct SDF_Path {
+  struct SDF_PathStep *steps;
+  size_t capacity, length;
+};
+
+int CompileSDFPath(char *expression, struct SDF_Path *path);
+void FreeSDFPath(struct SDF_Path *path);
+int SDFPathGet(struct SDF_Path *path, struct ParserValue *root, struct ParserValue *result);
+size_t SDFPathQuery(struct SDF_Path *path, struct ParserValue *root, struct ParserValueList *results);
+
+#endif
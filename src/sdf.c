@@ -0,0 +1,69 @@
+#include "sdf.h"
+
+inline int SDFParse(char *data, size_t length, struct SDF_Tree *tree, struct SDF_Error *error) {
+  struct SDF_ErrorTrap trap;
+  struct SDF_Cleanup cleanup;
+  tree->arena = CreateArena();
+  OpenSDFErrorTrap(&trap);
+  PushSDFCleanup(&cleanup, ArenaCleanup, &(tree->arena));
+  if (setjmp(trap.env) == 0) {
+    struct TokenIterator ti = CreateBufferTokenIterator(data, length);
+    tree->root = ParseObject(&ti, &(tree->arena));
+    PopSDFCleanup(&cleanup);
+    CloseSDFErrorTrap(&trap);
+    return 1;
+  }
+  *tree = (struct SDF_Tree) {};
+  if (error != NULL) {
+    *error = trap.error;
+  }
+  return 0;
+}
+
+inline int SDFParseFile(const char *file_path, struct SDF_Tree *tree, struct SDF_Error *error) {
+  struct FileBuffer fb;
+  if (!OpenFileBuffer(file_path, &fb)) {
+    *tree = (struct SDF_Tree) {};
+    if (error != NULL) {
+      *error = (struct SDF_Error) {
+        .kind = SE_FILE,
+        .token_type = -1,
+      };
+      snprintf(error->token, SDF_ERROR_TOKEN_SIZE, "%s", file_path);
+    }
+    return 0;
+  }
+  int ok = SDFParse(fb.data, fb.length, tree, error);
+  CloseFileBuffer(&fb);
+  return ok;
+}
+
+inline void FreeSDFTree(struct SDF_Tree *tree) {
+  FreeArena(&(tree->arena));
+  *tree = (struct SDF_Tree) {};
+}
+
+inline int SDFToJSON(char *data, size_t length, struct StringBuilder *sb, struct SDF_Error *error) {
+  struct SDF_Tree tree;
+  if (!SDFParse(data, length, &tree, error)) {
+    return 0;
+  }
+  SDFObjectToString(&(tree.root), sb);
+  StringBuilderAddChar(sb, '\n');
+  FreeSDFTree(&tree);
+  return 1;
+}
+
+inline void SDFErrorToString(struct SDF_Error *e, struct StringBuilder *sb) {
+  char position[64];
+  if (e->ln > 0) {
+    snprintf(position, sizeof(position), "Ln %d, Col %d: ", e->ln, e->col);
+    StringBuilderAddString(sb, position);
+  }
+  StringBuilderAddString(sb, (char*)SDFErrorKindToString(e->kind));
+  if (e->token[0] != '\0') {
+    StringBuilderAddString(sb, " `");
+    StringBuilderAddString(sb, e->token);
+    StringBuilderAddChar(sb, '`');
+  }
+}
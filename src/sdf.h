@@ -0,0 +1,31 @@
+#ifndef SDF_H
+#define SDF_H
+
+#include "parser.h"
+#include "util.h"
+
+/*
+  libsdf, for parsing in-process. These functions never print or exit:
+  they return 1 on success, or 0 with *error filled in (when error isn't
+  NULL) and everything they allocated released. Parsing stays on the
+  calling thread. The library is every source in src except main.c and
+  the command line parts that use it, batch.c, cache.c and stats.c.
+  Point sdf_parser_context at an SDF_ParserContext (UseSDFParserContext)
+  to let the documents parsed on a thread reuse each other's scratch memory.
+*/
+
+// A parsed document. Everything in it lives in its arena
+struct SDF_Tree {
+  struct SDF_Object root;
+  struct Arena arena;
+};
+
+int SDFParse(char *data, size_t length, struct SDF_Tree *tree, struct SDF_Error *error);
+int SDFParseFile(const char *file_path, struct SDF_Tree *tree, struct SDF_Error *error);
+void FreeSDFTree(struct SDF_Tree *tree);
+// Appends the document as a line of JSON, or nothing when it fails to parse
+int SDFToJSON(char *data, size_t length, struct StringBuilder *sb, struct SDF_Error *error);
+// Like "Ln 3, Col 7: unexpected token `]`"
+void SDFErrorToString(struct SDF_Error *e, struct StringBuilder *sb);
+
+#endif
@@ -0,0 +1,201 @@
+#include <stdarg.h>
+#include <time.h>
+
+#include "stats.h"
+#include "format.h"
+#include "main.h"
+#include "parser.h"
+
+static const char *STATS_PHASE_NAMES[SP_COUNT] = {
+  [SP_READ] = "read",
+  [SP_TOKENIZE] = "tokenize",
+  [SP_PARSE] = "parse",
+  [SP_EMIT] = "emit",
+};
+
+static const char *ALLOCATION_KIND_NAMES[AK_COUNT] = {
+  [AK_STRING_BUILDER] = "StringBuilder",
+  [AK_STRING_LIST] = "StringList",
+  [AK_PARSER_VALUE_LIST] = "ParserValueList",
+};
+
+static inline uint64_t StatsNow(void) {
+  struct timespec t;
+#ifndef _WIN32
+  clock_gettime(CLOCK_MONOTONIC, &t);
+#else
+  timespec_get(&t, TIME_UTC);
+#endif
+  return (uint64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+inline void StatsBufferToFormat(char *data, size_t length, struct StringBuilder *sb, int jobs, enum SDF_OutputFormat format, struct SDF_Stats *s) {
+  struct SDF_AllocationStats *previous = sdf_allocation_stats;
+  sdf_allocation_stats = &(s->allocations);
+  s->files += 1;
+  s->bytes += length;
+
+  uint64_t start = StatsNow();
+  if (ImageToFormat(data, length, sb, format)) {
+    s->nanoseconds[SP_EMIT] += StatsNow() - start;
+    sdf_allocation_stats = previous;
+    return;
+  }
+
+  struct TokenIterator ti = CreateBufferTokenIterator(data, length);
+  struct Token t;
+  while (GetNextToken(&ti, &t)) {
+    s->tokens[t.type] += 1;
+  }
+  uint64_t tokenized = StatsNow();
+
+  ti = CreateBufferTokenIterator(data, length);
+  ti.jobs = jobs;
+  struct Arena a = CreateArena();
+  struct SDF_Object o = ParseObject(&ti, &a);
+  uint64_t parsed = StatsNow();
+
+  SDFObjectToFormat(&o, sb, format);
+  uint64_t emitted = StatsNow();
+
+  s->nanoseconds[SP_TOKENIZE] += tokenized - start;
+  s->nanoseconds[SP_PARSE] += parsed - tokenized;
+  s->nanoseconds[SP_EMIT] += emitted - parsed;
+  size_t tree_bytes = ArenaSize(&a);
+  if (tree_bytes > s->tree_bytes) {
+    s->tree_bytes = tree_bytes;
+  }
+  FreeArena(&a);
+  sdf_allocation_stats = previous;
+}
+
+inline void StatsFilePathToFormat(const char *file_path, struct StringBuilder *sb, int jobs, enum SDF_OutputFormat format, struct SDF_Stats *s) {
+  uint64_t start = StatsNow();
+  struct FileBuffer fb;
+  if (!OpenFileBuffer(file_path, &fb)) {
+    fprintf(stderr, "Error! Failed to open file: %s\n", file_path);
+    return;
+  }
+  // Touch every page, so reading from disk isn't counted as tokenizing
+  volatile char sum = 0;
+  for (size_t i = 0; i < fb.length; i += 4096) {
+    sum += fb.data[i];
+  }
+  s->nanoseconds[SP_READ] += StatsNow() - start;
+
+  StatsBufferToFormat(fb.data, fb.length, sb, jobs, format, s);
+  CloseFileBuffer(&fb);
+}
+
+// The whole stream is read before converting, unlike FileToFormat
+inline void StatsFileToFormat(FILE *f, struct StringBuilder *sb, enum SDF_OutputFormat format, struct SDF_Stats *s) {
+  uint64_t start = StatsNow();
+  struct StringBuilder in = CreateStringBuilder();
+  size_t n;
+  do {
+    StringBuilderReserve(&in, TOKEN_STREAM_BUFFER_SIZE);
+    n = fread(in.string + in.length, sizeof(char), in.capacity - in.length - 1, f);
+    in.length += n;
+  } while (n > 0);
+  s->nanoseconds[SP_READ] += StatsNow() - start;
+
+  StatsBufferToFormat(in.string, in.length, sb, 1, format, s);
+  free(in.string);
+}
+
+inline void AddSDFStats(struct SDF_Stats *total, struct SDF_Stats *s) {
+  __atomic_add_fetch(&(total->files), s->files, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&(total->bytes), s->bytes, __ATOMIC_RELAXED);
+  for (int i = 0; i < TOKEN_TYPE_COUNT; i++) {
+    __atomic_add_fetch(&(total->tokens[i]), s->tokens[i], __ATOMIC_RELAXED);
+  }
+  for (int i = 0; i < AK_COUNT; i++) {
+    __atomic_add_fetch(&(total->allocations.count[i]), s->allocations.count[i], __ATOMIC_RELAXED);
+    __atomic_add_fetch(&(total->allocations.bytes[i]), s->allocations.bytes[i], __ATOMIC_RELAXED);
+  }
+  for (int i = 0; i < SP_COUNT; i++) {
+    __atomic_add_fetch(&(total->nanoseconds[i]), s->nanoseconds[i], __ATOMIC_RELAXED);
+  }
+  size_t tree_bytes = __atomic_load_n(&(total->tree_bytes), __ATOMIC_RELAXED);
+  while (s->tree_bytes > tree_bytes
+    && !__atomic_compare_exchange_n(&(total->tree_bytes), &tree_bytes, s->tree_bytes, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+__attribute__((format(printf, 2, 3)))
+static inline void StatsAddFormat(struct StringBuilder *sb, const char *format, ...) {
+  char buffer[256];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+  StringBuilderAddString(sb, buffer);
+}
+
+static inline void StatsToText(const char *name, struct SDF_Stats *s, struct StringBuilder *sb) {
+  size_t tokens = 0;
+  for (int i = 0; i < TOKEN_TYPE_COUNT; i++) {
+    tokens += s->tokens[i];
+  }
+  if (name != NULL) {
+    StatsAddFormat(sb, "stats for %s:\n", name);
+  }
+  else {
+    StatsAddFormat(sb, "stats for %zu files:\n", s->files);
+  }
+  StatsAddFormat(sb, "  bytes        %zu\n", s->bytes);
+  StatsAddFormat(sb, "  tokens       %zu", tokens);
+  const char *separator = ": ";
+  for (int i = 0; i < TOKEN_TYPE_COUNT; i++) {
+    if (s->tokens[i] > 0) {
+      StatsAddFormat(sb, "%s%s %zu", separator, TokenTypeToString(i), s->tokens[i]);
+      separator = ", ";
+    }
+  }
+  StringBuilderAddString(sb, "\n  allocations  ");
+  for (int i = 0; i < AK_COUNT; i++) {
+    StatsAddFormat(sb, "%s%s %zu (%zu bytes)", i > 0 ? ", " : "", ALLOCATION_KIND_NAMES[i],
+      s->allocations.count[i], s->allocations.bytes[i]);
+  }
+  StatsAddFormat(sb, "\n  tree         %zu bytes\n", s->tree_bytes);
+  StringBuilderAddString(sb, "  time         ");
+  for (int i = 0; i < SP_COUNT; i++) {
+    StatsAddFormat(sb, "%s%s %.3f ms", i > 0 ? ", " : "", STATS_PHASE_NAMES[i], s->nanoseconds[i] / 1e6);
+  }
+  StringBuilderAddChar(sb, '\n');
+}
+
+static inline void StatsToJSON(const char *name, struct SDF_Stats *s, struct StringBuilder *sb) {
+  StringBuilderAddString(sb, "{\"file\":");
+  if (name != NULL) {
+    StringBuilderAddJSONString(sb, name, strlen(name));
+  }
+  else {
+    StringBuilderAddString(sb, "null");
+  }
+  StatsAddFormat(sb, ",\"files\":%zu,\"bytes\":%zu,\"tokens\":{", s->files, s->bytes);
+  for (int i = 0; i < TOKEN_TYPE_COUNT; i++) {
+    StatsAddFormat(sb, "%s\"%s\":%zu", i > 0 ? "," : "", TokenTypeToString(i), s->tokens[i]);
+  }
+  StringBuilderAddString(sb, "},\"allocations\":{");
+  for (int i = 0; i < AK_COUNT; i++) {
+    StatsAddFormat(sb, "%s\"%s\":{\"count\":%zu,\"bytes\":%zu}", i > 0 ? "," : "", ALLOCATION_KIND_NAMES[i],
+      s->allocations.count[i], s->allocations.bytes[i]);
+  }
+  StatsAddFormat(sb, "},\"tree_bytes\":%zu,\"seconds\":{", s->tree_bytes);
+  for (int i = 0; i < SP_COUNT; i++) {
+    StatsAddFormat(sb, "%s\"%s\":%.9f", i > 0 ? "," : "", STATS_PHASE_NAMES[i], s->nanoseconds[i] / 1e9);
+  }
+  StringBuilderAddString(sb, "}}\n");
+}
+
+inline void WriteSDFStats(FILE *f, const char *name, struct SDF_Stats *s, enum SDF_StatsFormat format) {
+  struct StringBuilder sb = CreateStringBuilder();
+  if (format == SF_JSON) {
+    StatsToJSON(name, s, &sb);
+  }
+  else {
+    StatsToText(name, s, &sb);
+  }
+  fwrite(sb.string, sizeof(char), sb.length, f);
+  free(sb.string);
+}
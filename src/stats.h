@@ -0,0 +1,50 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include "binary.h"
+#include "tokenizer.h"
+#include "util.h"
+
+#define TOKEN_TYPE_COUNT (TT_OTHER + 1)
+
+enum SDF_StatsFormat {
+  SF_NONE,
+  SF_TEXT,
+  SF_JSON,
+};
+
+enum SDF_StatsPhase {
+  SP_READ,
+  SP_TOKENIZE,
+  SP_PARSE,
+  SP_EMIT,
+  SP_COUNT,
+};
+
+/*
+  What converting one or more inputs took. The input is read (and paged
+  in when it is mapped) before anything else, tokenized once on its own
+  to count tokens, then parsed into a tree, which tokenizes it again,
+  and the tree is written out. tree_bytes is the arena the tree was
+  built in; for a sum over files, the largest one.
+*/
+struct SDF_Stats {
+  size_t files;
+  size_t bytes;
+  size_t tokens[TOKEN_TYPE_COUNT];
+  struct SDF_AllocationStats allocations;
+  size_t tree_bytes;
+  uint64_t nanoseconds[SP_COUNT];
+};
+
+// Converts like BufferToFormat through the tree, filling in s
+void StatsBufferToFormat(char *data, size_t length, struct StringBuilder *sb, int jobs, enum SDF_OutputFormat format, struct SDF_Stats *s);
+void StatsFilePathToFormat(const char *file_path, struct StringBuilder *sb, int jobs, enum SDF_OutputFormat format, struct SDF_Stats *s);
+void StatsFileToFormat(FILE *f, struct StringBuilder *sb, enum SDF_OutputFormat format, struct SDF_Stats *s);
+
+// Adds s to total, safe to call from several threads at once
+void AddSDFStats(struct SDF_Stats *total, struct SDF_Stats *s);
+// Writes s for the input called name, or for every input when name is NULL, in one write
+void WriteSDFStats(FILE *f, const char *name, struct SDF_Stats *s, enum SDF_StatsFormat format);
+
+#endif
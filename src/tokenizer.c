@@ -23,113 +23,235 @@ inline struct Token CreateTokenFromString(enum TokenType type, char *s) {
   return (struct Token) {
     .type = type,
     .value = s,
+    .length = strlen(s),
   };
 }
 
 inline struct TokenIterator CreateTokenIterator(FILE *f) {
   return (struct TokenIterator) {
     .f = f,
+    .buffer = malloc(TOKEN_STREAM_BUFFER_SIZE),
+    .capacity = TOKEN_STREAM_BUFFER_SIZE,
+    .block = SIZE_MAX,
     .ln = 1,
     .col = 1,
   };
 }
 
-inline int GetNextToken(struct TokenIterator *ti, struct Token *t) {
-  char c = fgetc(ti->f);
-  if (c == EOF) {
-    return 0;
-  }
-  if (c == '\r') {
-    return GetNextToken(ti, t);
-  }
-  t->ln = ti->ln;
-  t->col = ti->col;
-  if (c == '\n') {
-    ungetc(c, ti->f);
-    t->type = TT_NEWLINE;
-    t->value = ReadNewLineToken(ti->f);
-  }
-  else if (CharIsWhiteSpace(c)) {
-    ungetc(c, ti->f);
-    t->type = TT_WHITESPACE;
-    t->value = ReadWhiteSpaceToken(ti->f);
-  }
-  else if (c == '=') {
-    t->type = TT_EQUALS;
-    t->value = CharToString(c);
-  }
-  else if (c == ';') { // TODO: Add | token that works like the semicolon
-    t->type = TT_SEMICOLON;
-    t->value = CharToString(c);
-  }
-  else if (c == '{') {
-    t->type = TT_LBRACE;
-    t->value = CharToString(c);
-  }
-  else if (c == '}') {
-    t->type = TT_RBRACE;
-    t->value = CharToString(c);
-  }
-  else if (c == '[') {
-    t->type = TT_LBRACK;
-    t->value = CharToString(c);
-  }
-  else if (c == ']') {
-    t->type = TT_RBRACK;
-    t->value = CharToString(c);
+inline struct TokenIterator CreateBufferTokenIterator(char *buffer, size_t length) {
+  return (struct TokenIterator) {
+    .buffer = buffer,
+    .length = length,
+    .offset = 0,
+    .block = SIZE_MAX,
+    .ln = 1,
+    .col = 1,
+    .eof = 1,
+  };
+}
+
+inline void FreeTokenIterator(struct TokenIterator *ti) {
+  if (ti->f != NULL) {
+    free(ti->buffer);
   }
-  else if (c == '(') {
-    t->type = TT_LPAREN;
-    t->value = CharToString(c);
+  ti->buffer = NULL;
+}
+
+/*
+  Moves the bytes from ti->offset on to the front of a stream buffer and
+  reads more after them, growing the buffer when a single token fills it.
+  Returns 0 once the stream has nothing more to give.
+*/
+static inline int TokenIteratorRefill(struct TokenIterator *ti) {
+  if (ti->f == NULL || ti->eof) {
+    return 0;
   }
-  else if (c == ')') {
-    t->type = TT_RPAREN;
-    t->value = CharToString(c);
+  size_t keep = ti->length - ti->offset;
+  if (keep == ti->capacity) {
+    ti->capacity <<= 1;
+    ti->buffer = realloc(ti->buffer, ti->capacity);
+    if (ti->buffer == NULL) {
+      FatalLog("Failed to grow token buffer to %zu bytes", ti->capacity);
+    }
   }
-  else if (CharIsAlphabetic(c) || c == '_') {
-    ungetc(c, ti->f);
-    t->type = TT_TEXT;
-    t->value = ReadTextToken(ti->f);
+  else if (ti->offset > 0) {
+    memmove(ti->buffer, ti->buffer + ti->offset, keep);
   }
-  else if (c == '"') {
-    t->type = TT_STRING;
-    t->value = ReadStringToken(ti->f);
+  ti->offset = 0;
+  ti->length = keep;
+  ti->block = SIZE_MAX;
+
+  size_t want = ti->capacity - keep;
+  size_t n = fread(ti->buffer + keep, sizeof(char), want, ti->f);
+  ti->length += n;
+  // fread only comes back short at the end of the stream or on an error
+  if (n < want) {
+    ti->eof = 1;
+  }
+  return n > 0;
+}
+
+static inline size_t CountNewLines(char *s, size_t length) {
+  size_t n = 0;
+  for (size_t i = 0; i < length; i++) {
+    n += s[i] == '\n';
   }
-  else if (CharIsDigit(c)) {
-    ungetc(c, ti->f);
-    t->type = TT_NUMBER;
-    t->value = ReadNumberToken(ti->f);
+  return n;
+}
+
+// Type of the token that starts with a given character
+static const unsigned char TOKEN_TYPES[256] = {
+  ['\n'] = TT_NEWLINE,
+  [' '] = TT_WHITESPACE,
+  ['\t'] = TT_WHITESPACE,
+  ['!'] = TT_OTHER,
+  ['"'] = TT_STRING,
+  ['#' ... '\''] = TT_OTHER,
+  ['('] = TT_LPAREN,
+  [')'] = TT_RPAREN,
+  ['*' ... '/'] = TT_OTHER,
+  ['0' ... '9'] = TT_NUMBER,
+  [':'] = TT_OTHER,
+  [';'] = TT_SEMICOLON, // TODO: Add | token that works like the semicolon
+  ['<'] = TT_OTHER,
+  ['='] = TT_EQUALS,
+  ['>' ... '@'] = TT_OTHER,
+  ['A' ... 'Z'] = TT_TEXT,
+  ['['] = TT_LBRACK,
+  ['\\'] = TT_OTHER,
+  [']'] = TT_RBRACK,
+  ['^'] = TT_OTHER,
+  ['_'] = TT_TEXT,
+  ['`'] = TT_OTHER,
+  ['a' ... 'z'] = TT_TEXT,
+  ['{'] = TT_LBRACE,
+  ['|'] = TT_OTHER,
+  ['}'] = TT_RBRACE,
+  ['~'] = TT_OTHER,
+};
+
+inline enum TokenType CharToTokenType(char c) {
+  return TOKEN_TYPES[(unsigned char)c];
+}
+
+static inline uint64_t TokenIteratorMask(struct TokenIterator *ti, size_t i, enum CharClass c) {
+  size_t block = i / CLASSIFY_BLOCK_SIZE;
+  if (block != ti->block) {
+    size_t start = block * CLASSIFY_BLOCK_SIZE;
+    size_t length = ti->length - start;
+    ClassifyBlock(&(ti->buffer[start]), length < CLASSIFY_BLOCK_SIZE ? length : CLASSIFY_BLOCK_SIZE, ti->masks);
+    ti->block = block;
+  }
+  return ti->masks[c];
+}
+
+// First position from i on whose byte is not in class c
+static inline size_t SkipCharClass(struct TokenIterator *ti, size_t i, enum CharClass c) {
+  while (i < ti->length) {
+    uint64_t rest = ~TokenIteratorMask(ti, i, c) >> (i % CLASSIFY_BLOCK_SIZE);
+    if (rest != 0) {
+      i += __builtin_ctzll(rest);
+      break;
+    }
+    i = (i / CLASSIFY_BLOCK_SIZE + 1) * CLASSIFY_BLOCK_SIZE;
   }
-  else if (CharIsOther(c)) {
-    t->type = TT_OTHER;
-    t->value = CharToString(c);
+  return i < ti->length ? i : ti->length;
+}
+
+// First position from i on whose byte is in class c
+static inline size_t FindCharClass(struct TokenIterator *ti, size_t i, enum CharClass c) {
+  while (i < ti->length) {
+    uint64_t rest = TokenIteratorMask(ti, i, c) >> (i % CLASSIFY_BLOCK_SIZE);
+    if (rest != 0) {
+      i += __builtin_ctzll(rest);
+      break;
+    }
+    i = (i / CLASSIFY_BLOCK_SIZE + 1) * CLASSIFY_BLOCK_SIZE;
   }
-  else {
-    t->type = TT_UNDEFINED;
-    t->value = CharToString(c);
+  return i < ti->length ? i : ti->length;
+}
+
+inline int GetNextToken(struct TokenIterator *ti, struct Token *t) {
+  char *s;
+  size_t i, value_start, value_stop, stop;
+  enum TokenType type;
+  int scanned;
+
+  while (1) {
+    s = ti->buffer;
+    i = ti->offset;
+    while (i < ti->length && s[i] == '\r') {
+      i++;
+    }
+    if (i >= ti->length) {
+      ti->offset = i;
+      if (TokenIteratorRefill(ti)) {
+        continue;
+      }
+      return 0;
+    }
+    value_start = i;
+    value_stop = i + 1;
+    scanned = 1;
+    type = CharToTokenType(s[i]);
+    switch (type) {
+      case TT_NEWLINE:
+        value_stop = ScanNewLineToken(ti, i);
+        break;
+      case TT_WHITESPACE:
+        value_stop = ScanWhiteSpaceToken(ti, i);
+        break;
+      case TT_TEXT:
+        value_stop = ScanTextToken(ti, i);
+        break;
+      case TT_NUMBER:
+        value_stop = ScanNumberToken(ti, i);
+        break;
+      case TT_STRING:
+        value_start = i + 1;
+        value_stop = ScanStringToken(ti, value_start);
+        break;
+      default:
+        scanned = 0;
+        break;
+    }
+    stop = value_stop;
+    if (type == TT_STRING && stop < ti->length) {
+      stop += 1; // Closing quote
+    }
+    // A scanned token that reaches the end of a stream or push buffer may go on after it
+    if (scanned && value_stop >= ti->length && !ti->eof) {
+      ti->offset = i;
+      if (ti->f == NULL) {
+        return 0;
+      }
+      TokenIteratorRefill(ti);
+      continue;
+    }
+    break;
   }
+
+  t->type = type;
+  t->offset = i;
+  t->ln = ti->ln;
+  t->col = ti->col;
+  t->value = s + value_start;
+  t->length = value_stop - value_start;
+  ti->offset = stop;
   if (t->type == TT_NEWLINE) {
-    ti->ln += strlen(t->value);
+    ti->ln += CountNewLines(t->value, t->length);
     ti->col = 1;
   }
   else {
-    ti->col += strlen(t->value);
+    ti->col += stop - i;
   }
   return 1;
 }
 
 inline void UngetToken(struct TokenIterator *ti, struct Token *t) {
-  size_t length = strlen(t->value);
-  // TODO: This doesn't actually work for lines, but maybe it covers most cases?
-  if (t->type == TT_NEWLINE) {
-    ti->ln -= length;
-  }
-  else {
-    ti->col -= length;
-  }
-  for (int i = length - 1; i >= 0; i--) {
-    ungetc(t->value[i], ti->f);
-  }
+  ti->offset = t->offset;
+  ti->ln = t->ln;
+  ti->col = t->col;
 }
 
 struct TokenList Tokenize(FILE* f) {
@@ -137,122 +259,89 @@ struct TokenList Tokenize(FILE* f) {
   struct TokenIterator ti = CreateTokenIterator(f);
   struct Token t;
   while (GetNextToken(&ti, &t)) {
+    // The token text lives in the stream buffer, which is refilled, so keep a copy
+    char *value = malloc(t.length + 1);
+    memcpy(value, t.value, t.length);
+    value[t.length] = '\0';
+    t.value = value;
     TokenListAdd(&l, t);
   }
+  FreeTokenIterator(&ti);
   return l;
 }
 
-char* ReadTextToken(FILE *f) {
-  struct StringBuilder sb = CreateStringBuilder();
-  while (1) {
-    char c = fgetc(f);
-    if (CharIsAlphabetic(c) || CharIsDigit(c) || c == '_') {
-      StringBuilderAddChar(&sb, c);
-    }
-    else {
-      ungetc(c, f);
-      return sb.string;
-    }
+struct TokenList TokenizeBuffer(char *buffer, size_t length) {
+  struct TokenList l = CreateTokenList();
+  struct TokenIterator ti = CreateBufferTokenIterator(buffer, length);
+  struct Token t;
+  while (GetNextToken(&ti, &t)) {
+    TokenListAdd(&l, t);
   }
+  return l;
 }
 
-char* ReadNumberToken(FILE *f) {
-  struct StringBuilder sb = CreateStringBuilder();
-  int dot = 0;
-  while (1) {
-    char c = fgetc(f);
-    if (c == '.') {
-      if (dot) {
-        goto Return;
-      }
-      else {
-        dot = 1;
-        StringBuilderAddChar(&sb, c);
-      }
-    }
-    else if (CharIsDigit(c) || c == '_') {
-      StringBuilderAddChar(&sb, c);
-    }
-    else {
-Return:
-      ungetc(c, f);
-      return sb.string;
+inline void StringBuilderAddToken(struct StringBuilder *sb, struct Token *t) {
+  if (t->type != TT_STRING) {
+    StringBuilderAddSubString(sb, t->value, 0, t->length);
+    return;
+  }
+  size_t run = 0;
+  for (size_t i = 0; i < t->length; i++) {
+    if (t->value[i] == '\\' && i + 1 < t->length
+      && (t->value[i + 1] == '\\' || t->value[i + 1] == '"')) {
+      StringBuilderAddSubString(sb, t->value, run, i);
+      i += 1;
+      run = i;
     }
   }
+  StringBuilderAddSubString(sb, t->value, run, t->length);
 }
 
-char* ReadStringToken(FILE *f) {
-  struct StringBuilder sb = CreateStringBuilder();
-  int escape = 0;
-  while (1) {
-    char c = fgetc(f);
-    if (c == '\\') {
-      if (escape) {
-        StringBuilderAddChar(&sb, c);
-        escape = 0;
-      }
-      else {
-        escape = 1;
-      }
-    }
-    else if (c == '"') {
-      if (escape) {
-        StringBuilderAddChar(&sb, c);
-        escape = 0;
-      }
-      else {
-        return sb.string;
-      }
-    }
-    else {
-      if (escape) {
-        StringBuilderAddChar(&sb, '\\');
-        escape = 0;
-      }
-      StringBuilderAddChar(&sb, c);
-    }
-  }
+inline size_t ScanTextToken(struct TokenIterator *ti, size_t start) {
+  return SkipCharClass(ti, start, CC_WORD);
 }
 
-char* ReadWhiteSpaceToken(FILE *f) {
-  struct StringBuilder sb = CreateStringBuilder();
-  while (1) {
-    char c = fgetc(f);
-    if (CharIsWhiteSpace(c)) {
-      StringBuilderAddChar(&sb, c);
-    }
-    else {
-      ungetc(c, f);
-      return sb.string;
-    }
+inline size_t ScanNumberToken(struct TokenIterator *ti, size_t start) {
+  size_t i = SkipCharClass(ti, start, CC_DIGIT);
+  if (i < ti->length && ti->buffer[i] == '.') {
+    i = SkipCharClass(ti, i + 1, CC_DIGIT);
   }
+  return i;
 }
 
-char* ReadNewLineToken(FILE *f) {
-  struct StringBuilder sb = CreateStringBuilder();
-  while (1) {
-    char c = fgetc(f);
-    if (c == '\r') {
-      continue;
+// Returns the position of the closing quote, or the end of the buffer
+inline size_t ScanStringToken(struct TokenIterator *ti, size_t start) {
+  size_t i = start;
+  while ((i = FindCharClass(ti, i, CC_QUOTE)) < ti->length) {
+    // The quote is escaped if an odd number of backslashes precede it
+    size_t backslashes = 0;
+    while (i - backslashes > start && ti->buffer[i - backslashes - 1] == '\\') {
+      backslashes++;
     }
-    else if (c == '\n') {
-      StringBuilderAddChar(&sb, c);
-    }
-    else {
-      ungetc(c, f);
-      return sb.string;
+    if (backslashes % 2 == 0) {
+      break;
     }
+    i++;
   }
+  return i;
+}
+
+inline size_t ScanWhiteSpaceToken(struct TokenIterator *ti, size_t start) {
+  return SkipCharClass(ti, start, CC_WHITESPACE);
+}
+
+inline size_t ScanNewLineToken(struct TokenIterator *ti, size_t start) {
+  return SkipCharClass(ti, start, CC_NEWLINE);
 }
 
 char* TokenToString(struct Token t) {
   const int padding = 32;
-  char *buffer = calloc(strlen(t.value) + padding, sizeof(char));
+  char *buffer = calloc(t.length + padding, sizeof(char));
   if (t.type == TT_NEWLINE || t.type == TT_WHITESPACE) {
-    sprintf(buffer, "{%s %lld}", TokenTypeToString(t.type), strlen(t.value));
+    sprintf(buffer, "{%s %zu}", TokenTypeToString(t.type), t.length);
   }
   else {
-    sprintf(buffer, "{%s `%s`}", TokenTypeToString(t.type), t.value);
+    sprintf(buffer, "{%s `%.*s`}", TokenTypeToString(t.type), (int)t.length, t.value);
   }
   return buffer;
 }
@@ -13,6 +13,9 @@
 #include <string.h>
 #endif
 
+#include "classify.h"
+#include "util.h"
+
 enum TokenType {
   TT_UNDEFINED,   // Undefined/unconfigured tokens
   TT_TEXT,        // Alphanumeric text, underscores
@@ -33,14 +36,23 @@ enum TokenType {
 
 char* TokenTypeToString(enum TokenType t);
 
+/*
+  A token's text is a slice: `value` points at `length` bytes that are NOT
+  null-terminated. In buffer mode the slice lies inside the input buffer
+  (`offset` is where the token starts in it), in file mode it lies in the
+  iterator's scratch buffer and is only valid until the next GetNextToken.
+  String tokens hold the raw text between the quotes, escapes included.
+*/
 struct Token {
   enum TokenType type;
   char* value;
+  size_t offset, length;
   int ln, col;
 };
 
 char* TokenToString(struct Token t);
 struct Token CreateTokenFromString(enum TokenType type, char *s);
+void StringBuilderAddToken(struct StringBuilder *sb, struct Token *t);
 
 struct TokenList {
   struct Token *items;
@@ -49,22 +61,54 @@ struct TokenList {
 
 // Use TokenIterator for better performance
 struct TokenList Tokenize(FILE* f);
+struct TokenList TokenizeBuffer(char *buffer, size_t length);
 struct TokenList CreateTokenList(void);
 void TokenListAdd(struct TokenList *l, struct Token t);
 
+// Initial size of the buffer a stream is read into
+#define TOKEN_STREAM_BUFFER_SIZE 65536
+
+/*
+  Walks a contiguous buffer and hands out slices of it without allocating.
+  Token ends are found from the class bitmasks of the 64 byte block being
+  read. Buffer mode (f == NULL) walks a complete document, e.g. an mmap'd
+  file. Stream mode (f != NULL) reads the stream into an owned buffer and
+  refills it whenever a token runs into its end, keeping only the bytes of
+  that token, so memory stays bounded and pipes work. Push mode (f == NULL
+  with eof unset) is fed by SDF_PushParser: GetNextToken returns 0 for a
+  token that could go on past the end of the buffer until more bytes or
+  the end of input arrive. Outside buffer mode, slices are only valid until the next
+  GetNextToken, and only the last token can be handed back to UngetToken.
+  In buffer mode, `jobs` > 1 lets ParseList split large list bodies
+  across that many threads. `interner` is set by the outermost parse of
+  a document for the nested ones.
+*/
+struct SDF_Interner;
+
 struct TokenIterator {
   FILE *f;
+  char *buffer;
+  size_t length, offset, capacity;
+  size_t block;
+  uint64_t masks[CC_COUNT];
   size_t ln, col;
+  int eof;
+  int jobs;
+  struct SDF_Interner *interner;
 };
 
 struct TokenIterator CreateTokenIterator(FILE *f);
+struct TokenIterator CreateBufferTokenIterator(char *buffer, size_t length);
+void FreeTokenIterator(struct TokenIterator *ti);
 int GetNextToken(struct TokenIterator *ti, struct Token *t);
 void UngetToken(struct TokenIterator *ti, struct Token *t);
 
-char* ReadTextToken(FILE *f);
-char* ReadNumberToken(FILE *f);
-char* ReadStringToken(FILE *f);
-char* ReadWhiteSpaceToken(FILE *f);
-char* ReadNewLineToken(FILE *f);
+// Type of the token that starts with c
+enum TokenType CharToTokenType(char c);
+size_t ScanTextToken(struct TokenIterator *ti, size_t start);
+size_t ScanNumberToken(struct TokenIterator *ti, size_t start);
+size_t ScanStringToken(struct TokenIterator *ti, size_t start);
+size_t ScanWhiteSpaceToken(struct TokenIterator *ti, size_t start);
+size_t ScanNewLineToken(struct TokenIterator *ti, size_t start);
 
 #endif
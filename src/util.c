@@ -6,53 +6,230 @@ inline char* CharToString(char c) {
   return s;
 }
 
-inline int CharIsAlphabetic(char c) {
-  switch (c) {
-    case 'a' ... 'z':
-    case 'A' ... 'Z':
-      return 1;
-    default:
-      return 0;
+_Thread_local struct SDF_AllocationStats *sdf_allocation_stats = NULL;
+_Thread_local struct SDF_ErrorTrap *sdf_error_trap = NULL;
+
+inline void OpenSDFErrorTrap(struct SDF_ErrorTrap *trap) {
+  trap->error = (struct SDF_Error) {
+    .token_type = -1,
+  };
+  trap->cleanups = NULL;
+  trap->previous = sdf_error_trap;
+  sdf_error_trap = trap;
+}
+
+inline void CloseSDFErrorTrap(struct SDF_ErrorTrap *trap) {
+  sdf_error_trap = trap->previous;
+}
+
+inline void RaiseSDFError(enum SDF_ErrorKind kind, int ln, int col, int token_type, const char *text, size_t length) {
+  struct SDF_ErrorTrap *trap = sdf_error_trap;
+  if (trap == NULL) {
+    return;
+  }
+  if (length >= SDF_ERROR_TOKEN_SIZE) {
+    length = SDF_ERROR_TOKEN_SIZE - 1;
   }
+  trap->error = (struct SDF_Error) {
+    .kind = kind,
+    .ln = ln,
+    .col = col,
+    .token_type = token_type,
+  };
+  if (text != NULL) {
+    memcpy(trap->error.token, text, length);
+  }
+  // Innermost first, as the functions that pushed them would have
+  for (struct SDF_Cleanup *c = trap->cleanups; c != NULL; c = c->next) {
+    c->function(c->p);
+  }
+  sdf_error_trap = trap->previous;
+  longjmp(trap->env, 1);
 }
 
-inline int CharIsDigit(char c) {
-  switch (c) {
-    case '0' ... '9':
-      return 1;
-    default:
-      return 0;
+inline void PushSDFCleanup(struct SDF_Cleanup *c, void (*function)(void *p), void *p) {
+  struct SDF_ErrorTrap *trap = sdf_error_trap;
+  if (trap == NULL) {
+    return;
   }
+  *c = (struct SDF_Cleanup) {
+    .function = function,
+    .p = p,
+    .next = trap->cleanups,
+  };
+  trap->cleanups = c;
 }
 
-inline int CharIsOther(char c) {
-  switch (c) {
-    case '!' ... '/':
-    case ':':
-    case '<' ... '@':
-    case '\\':
-    case '^':
-    case '_' ... '`':
-    case '|':
-    case '~':
-      return 1;
-    default:
-      return 0;
+inline void PopSDFCleanup(struct SDF_Cleanup *c) {
+  struct SDF_ErrorTrap *trap = sdf_error_trap;
+  if (trap != NULL && trap->cleanups == c) {
+    trap->cleanups = c->next;
+  }
+}
+
+inline const char* SDFErrorKindToString(enum SDF_ErrorKind kind) {
+  switch (kind) {
+    case SE_NONE:
+      return "no error";
+    case SE_INVALID_TOKEN:
+      return "unexpected token";
+    case SE_UNDEFINED_KEY:
+      return "key not found in schema";
+    case SE_DUPLICATE_KEY:
+      return "duplicate key";
+    case SE_NO_MATCHING_VALUE:
+      return "no matching value for key";
+    case SE_FILE:
+      return "failed to read file";
+    case SE_FATAL:
+      return "fatal error";
   }
+  return "unknown error";
+}
+
+const unsigned char CHAR_CLASSES[256] = {
+  ['a' ... 'z'] = CHAR_ALPHABETIC,
+  ['A' ... 'Z'] = CHAR_ALPHABETIC,
+  ['0' ... '9'] = CHAR_DIGIT,
+  ['!' ... '/'] = CHAR_OTHER,
+  [':'] = CHAR_OTHER,
+  ['<' ... '@'] = CHAR_OTHER,
+  ['\\'] = CHAR_OTHER,
+  ['^'] = CHAR_OTHER,
+  ['_' ... '`'] = CHAR_OTHER,
+  ['|'] = CHAR_OTHER,
+  ['~'] = CHAR_OTHER,
+  [' '] = CHAR_WHITESPACE,
+  ['\t'] = CHAR_WHITESPACE,
+};
+
+inline int CharIsAlphabetic(char c) {
+  return CHAR_CLASSES[(unsigned char)c] & CHAR_ALPHABETIC;
+}
+
+inline int CharIsDigit(char c) {
+  return CHAR_CLASSES[(unsigned char)c] & CHAR_DIGIT;
+}
+
+inline int CharIsOther(char c) {
+  return CHAR_CLASSES[(unsigned char)c] & CHAR_OTHER;
 }
 
 inline int CharIsWhiteSpace(char c) {
-  switch (c) {
-    case ' ':
-    case '\t':
-      return 1;
-    default:
-      return 0;
+  return CHAR_CLASSES[(unsigned char)c] & CHAR_WHITESPACE;
+}
+
+inline struct Arena CreateArena(void) {
+  return (struct Arena) {};
+}
+
+inline void* ArenaAlloc(struct Arena *a, size_t size) {
+  if (a == NULL) {
+    return malloc(size);
   }
+  size = (size + ARENA_ALIGNMENT - 1) & ~((size_t)ARENA_ALIGNMENT - 1);
+  struct ArenaBlock *b = a->current;
+  while (b != NULL && b->length + size > b->capacity) {
+    // Blocks after the current one are left over from before ArenaReset
+    b = b->next;
+    if (b != NULL) {
+      b->length = 0;
+    }
+  }
+  if (b == NULL) {
+    size_t capacity = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+    b = malloc(sizeof(struct ArenaBlock) + capacity);
+    if (b == NULL) {
+      FatalLog("Failed to allocate arena block of %zu bytes", capacity);
+    }
+    b->capacity = capacity;
+    b->length = 0;
+    b->next = NULL;
+    if (a->current == NULL) {
+      b->next = a->head;
+      a->head = b;
+    }
+    else {
+      b->next = a->current->next;
+      a->current->next = b;
+    }
+  }
+  a->current = b;
+  void *p = &(b->data[b->length]);
+  b->length += size;
+  return p;
+}
+
+inline void* ArenaRealloc(struct Arena *a, void *p, size_t old_size, size_t new_size) {
+  if (a == NULL) {
+    return realloc(p, new_size);
+  }
+  struct ArenaBlock *b = a->current;
+  size_t aligned_old_size = (old_size + ARENA_ALIGNMENT - 1) & ~((size_t)ARENA_ALIGNMENT - 1);
+  // Grow in place when p is the most recent allocation
+  if (p != NULL && b != NULL && (char*)p + aligned_old_size == &(b->data[b->length])) {
+    size_t offset = (char*)p - b->data;
+    size_t aligned_new_size = (new_size + ARENA_ALIGNMENT - 1) & ~((size_t)ARENA_ALIGNMENT - 1);
+    if (offset + aligned_new_size <= b->capacity) {
+      b->length = offset + aligned_new_size;
+      return p;
+    }
+  }
+  void *q = ArenaAlloc(a, new_size);
+  if (p != NULL) {
+    memcpy(q, p, old_size < new_size ? old_size : new_size);
+  }
+  return q;
+}
+
+inline void ArenaReset(struct Arena *a) {
+  if (a->head != NULL) {
+    a->head->length = 0;
+  }
+  a->current = a->head;
+}
+
+// Moves the blocks of b into a, so they live until a is freed
+inline void ArenaAdopt(struct Arena *a, struct Arena *b) {
+  if (b->head == NULL) {
+    return;
+  }
+  // Blocks ahead of current are treated as full until the next reset
+  struct ArenaBlock *last = b->head;
+  while (last->next != NULL) {
+    last = last->next;
+  }
+  last->next = a->head;
+  a->head = b->head;
+  *b = (struct Arena) {};
+}
+
+// Bytes held by the blocks of a, used or not
+inline size_t ArenaSize(struct Arena *a) {
+  size_t size = 0;
+  for (struct ArenaBlock *b = a->head; b != NULL; b = b->next) {
+    size += sizeof(struct ArenaBlock) + b->capacity;
+  }
+  return size;
+}
+
+inline void ArenaCleanup(void *a) {
+  FreeArena(a);
+}
+
+inline void FreeArena(struct Arena *a) {
+  struct ArenaBlock *b = a->head;
+  while (b != NULL) {
+    struct ArenaBlock *next = b->next;
+    free(b);
+    b = next;
+  }
+  *a = (struct Arena) {};
 }
 
 inline struct StringBuilder CreateStringBuilder(void) {
   const size_t capacity = 32;
+  CountAllocation(AK_STRING_BUILDER, capacity);
   return (struct StringBuilder) {
     .capacity = capacity,
     .length = 0,
@@ -60,16 +237,50 @@ inline struct StringBuilder CreateStringBuilder(void) {
   };
 }
 
-inline void StringBuilderAddChar(struct StringBuilder *sb, char c) {
-  if (sb->length >= sb->capacity) {
-    while (sb->length >= sb->capacity) {
-      sb->capacity <<= 1;
+inline struct StringBuilder CreateFileStringBuilder(FILE *f) {
+  const size_t capacity = FILE_STRING_BUILDER_CAPACITY;
+  CountAllocation(AK_STRING_BUILDER, capacity);
+  return (struct StringBuilder) {
+    .capacity = capacity,
+    .length = 0,
+    .string = calloc(capacity, sizeof(char)),
+    .f = f,
+  };
+}
+
+inline void StringBuilderReserve(struct StringBuilder *sb, size_t n) {
+  if (sb->length + n < sb->capacity) {
+    return;
+  }
+  if (sb->f != NULL) {
+    StringBuilderFlush(sb);
+    if (n < sb->capacity) {
+      return;
     }
-    sb->string = realloc(sb->string, sizeof(char) * sb->capacity);
-    memset(&(sb->string[sb->length]), '\0', sb->capacity - sb->length);
   }
+  while (sb->length + n >= sb->capacity) {
+    sb->capacity <<= 1;
+  }
+  sb->string = realloc(sb->string, sizeof(char) * sb->capacity);
+  CountAllocation(AK_STRING_BUILDER, sb->capacity);
+}
+
+inline void StringBuilderFlush(struct StringBuilder *sb) {
+  if (sb->f == NULL || sb->length == 0) {
+    return;
+  }
+  if (fwrite(sb->string, sizeof(char), sb->length, sb->f) < sb->length) {
+    StdErrorLog("Failed to write output!");
+  }
+  sb->length = 0;
+  sb->string[0] = '\0';
+}
+
+inline void StringBuilderAddChar(struct StringBuilder *sb, char c) {
+  StringBuilderReserve(sb, 1);
   sb->string[sb->length] = c;
   sb->length += 1;
+  sb->string[sb->length] = '\0';
 }
 
 inline void StringBuilderAddString(struct StringBuilder *sb, char *s) {
@@ -77,36 +288,24 @@ inline void StringBuilderAddString(struct StringBuilder *sb, char *s) {
   if (s_length == 0) {
     return;
   }
-  if (sb->length + s_length >= sb->capacity) {
-    while (sb->length + s_length >= sb->capacity) {
-      sb->capacity <<= 1;
-    }
-    sb->string = realloc(sb->string, sizeof(char) * sb->capacity);
-    memset(&(sb->string[sb->length]), '\0', sb->capacity - sb->length);
-  }
-  strcat(sb->string, s);
+  StringBuilderReserve(sb, s_length);
+  memcpy(&(sb->string[sb->length]), s, s_length);
   sb->length += s_length;
+  sb->string[sb->length] = '\0';
 }
 
 inline void StringBuilderAddSubString(struct StringBuilder *sb, char *s, int start, int stop) {
-  size_t s_length = strlen(s);
   int sub_length = stop - start;
-  if (s_length == 0 || sub_length == 0) {
+  if (sub_length <= 0) {
     return;
   }
-  if (sb->length + sub_length >= sb->capacity) {
-    while (sb->length + sub_length >= sb->capacity) {
-      sb->capacity <<= 1;
-    }
-    sb->string = realloc(sb->string, sizeof(char) * sb->capacity);
-  }
-  for (int i = start; i < stop; i++) {
-    sb->string[sb->length] = s[i];
-    sb->length += 1;
-  }
+  StringBuilderReserve(sb, sub_length);
+  memcpy(&(sb->string[sb->length]), &(s[start]), sub_length);
+  sb->length += sub_length;
+  sb->string[sb->length] = '\0';
 }
 
-inline char* StringBuilderTrim(struct StringBuilder *sb) {
+inline char* StringBuilderTrim(struct StringBuilder *sb, struct Arena *a) {
   char *s = "";
   if (sb->length > 0) {
     size_t i, j;
@@ -122,17 +321,33 @@ inline char* StringBuilderTrim(struct StringBuilder *sb) {
         break;
       }
     }
-    s = calloc(j - i + 2, sizeof(char));
-    for (size_t si = 0, k = i; k <= j; si++, k++) {
-      s[si] = sb->string[k];
-    }
+    s = ArenaAlloc(a, j - i + 2);
+    memcpy(s, &(sb->string[i]), j - i + 1);
+    s[j - i + 1] = '\0';
   }
   return s;
 }
 
+// Trims the builder's own contents and returns a pointer into them
+inline char* StringBuilderTrimInPlace(struct StringBuilder *sb) {
+  size_t i = 0, j = sb->length;
+  while (i < j && CharIsWhiteSpace(sb->string[i])) {
+    i++;
+  }
+  while (j > i && CharIsWhiteSpace(sb->string[j - 1])) {
+    j--;
+  }
+  if (j == 0) {
+    return "";
+  }
+  sb->string[j] = '\0';
+  return &(sb->string[i]);
+}
+
+// Everything that adds to a builder terminates it, so only the first byte needs resetting
 inline void StringBuilderClear(struct StringBuilder *sb) {
   sb->length = 0;
-  memset(sb->string, '\0', sb->capacity);
+  sb->string[0] = '\0';
 }
 
 inline void StringBuilderRecreate(struct StringBuilder *sb) {
@@ -140,10 +355,20 @@ inline void StringBuilderRecreate(struct StringBuilder *sb) {
   sb->length = 0;
   sb->capacity = 32;
   sb->string = calloc(sb->capacity, sizeof(char));
+  CountAllocation(AK_STRING_BUILDER, sb->capacity);
+}
+
+inline void StringBuilderCleanup(void *sb) {
+  free(((struct StringBuilder*)sb)->string);
+}
+
+inline void PointerCleanup(void *p) {
+  free(*(void**)p);
 }
 
 inline struct StringList CreateStringList(void) {
   const size_t capacity = 32;
+  CountAllocation(AK_STRING_LIST, sizeof(char*) * capacity);
   return (struct StringList) {
     .capacity = capacity,
     .length = 0,
@@ -151,19 +376,23 @@ inline struct StringList CreateStringList(void) {
   };
 }
 
-inline struct StringList* NewStringList(void) {
+inline struct StringList* NewStringList(struct Arena *a) {
   const size_t capacity = 32;
-  struct StringList *sl = malloc(sizeof(struct StringList));
+  struct StringList *sl = ArenaAlloc(a, sizeof(struct StringList));
   sl->capacity = capacity;
   sl->length = 0;
-  sl->items = malloc(sizeof(char*) * capacity);
+  sl->items = ArenaAlloc(a, sizeof(char*) * capacity);
+  sl->arena = a;
+  sl->shared = 0;
+  CountAllocation(AK_STRING_LIST, sizeof(char*) * capacity);
   return sl;
 }
 
 inline void StringListAdd(struct StringList *sl, char *s) {
   if (sl->length >= sl->capacity) {
     sl->capacity <<= 1;
-    sl->items = realloc(sl->items, sizeof(char*) * sl->capacity);
+    sl->items = ArenaRealloc(sl->arena, sl->items, sizeof(char*) * sl->length, sizeof(char*) * sl->capacity);
+    CountAllocation(AK_STRING_LIST, sizeof(char*) * sl->capacity);
   }
   sl->items[sl->length] = s;
   sl->length += 1;
@@ -190,29 +419,245 @@ inline char* StringListToString(struct StringList *sl) {
 }
 
 inline int StringIsNumber(char *s) {
-  int is_number = 1;
-  int has_dot = 0;
+  int64_t integer;
+  double real;
+  return ParseNumber(s, &integer, &real) != NT_NONE;
+}
+
+static const double POWERS_OF_TEN[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+/*
+  Digits with `_` separators and at most one dot, in a single scan.
+  Integers that fit in an int64 come back as NT_INTEGER, everything else as
+  NT_DOUBLE. Doubles are exact without strtod when the digits fit in 53 bits
+  and there are at most 22 decimals.
+*/
+inline enum NumberType ParseNumber(char *s, int64_t *integer, double *real) {
+  uint64_t mantissa = 0;
+  size_t digits = 0, decimals = 0;
+  int has_dot = 0, overflow = 0;
+  if (*s == '_') {
+    return NT_NONE;
+  }
+  for (char *c = s; *c != '\0'; c++) {
+    if (CharIsDigit(*c)) {
+      if (mantissa > (UINT64_MAX - 9) / 10) {
+        overflow = 1;
+      }
+      mantissa = mantissa * 10 + (*c - '0');
+      digits += 1;
+      decimals += has_dot;
+    }
+    else if (*c == '.' && !has_dot) {
+      has_dot = 1;
+    }
+    else if (*c != '_') {
+      return NT_NONE;
+    }
+  }
+  if (digits == 0) {
+    return NT_NONE;
+  }
+  if (!has_dot && !overflow && mantissa <= INT64_MAX) {
+    *integer = mantissa;
+    return NT_INTEGER;
+  }
+  if (!overflow && mantissa <= ((uint64_t)1 << 53) && decimals <= 22) {
+    *real = (double)mantissa / POWERS_OF_TEN[decimals];
+    return NT_DOUBLE;
+  }
+  // Too many digits to be exact here, let strtod round them
   size_t length = strlen(s);
-  if (length == 0) {
-    is_number = 0;
+  char buffer[64];
+  char *copy = length < sizeof(buffer) ? buffer : malloc(length + 1);
+  size_t n = 0;
+  for (char *c = s; *c != '\0'; c++) {
+    if (*c != '_') {
+      copy[n++] = *c;
+    }
+  }
+  copy[n] = '\0';
+  *real = strtod(copy, NULL);
+  if (copy != buffer) {
+    free(copy);
+  }
+  return NT_DOUBLE;
+}
+
+// 32-bit FNV-1a
+inline uint32_t HashString(char *s, size_t length) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < length; i++) {
+    hash ^= (unsigned char)s[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+#define XXH_PRIME64_1 0x9E3779B185EBCA87ULL
+#define XXH_PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define XXH_PRIME64_3 0x165667B19E3779F9ULL
+#define XXH_PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define XXH_PRIME64_5 0x27D4EB2F165667C5ULL
+
+static inline uint64_t XXH64Rotate(uint64_t x, int r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t XXH64Read64(const unsigned char *p) {
+  uint64_t x;
+  memcpy(&x, p, sizeof(x));
+  return x;
+}
+
+static inline uint32_t XXH64Read32(const unsigned char *p) {
+  uint32_t x;
+  memcpy(&x, p, sizeof(x));
+  return x;
+}
+
+static inline uint64_t XXH64Round(uint64_t acc, uint64_t input) {
+  acc += input * XXH_PRIME64_2;
+  return XXH64Rotate(acc, 31) * XXH_PRIME64_1;
+}
+
+static inline uint64_t XXH64Merge(uint64_t acc, uint64_t value) {
+  acc ^= XXH64Round(0, value);
+  return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+// xxHash64 of little-endian input, four 8 byte lanes at a time
+inline uint64_t HashBytes(const void *data, size_t length, uint64_t seed) {
+  const unsigned char *p = data;
+  const unsigned char *end = p + length;
+  uint64_t h;
+
+  if (length >= 32) {
+    uint64_t v1 = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+    uint64_t v2 = seed + XXH_PRIME64_2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - XXH_PRIME64_1;
+    do {
+      v1 = XXH64Round(v1, XXH64Read64(p));
+      v2 = XXH64Round(v2, XXH64Read64(p + 8));
+      v3 = XXH64Round(v3, XXH64Read64(p + 16));
+      v4 = XXH64Round(v4, XXH64Read64(p + 24));
+      p += 32;
+    } while (end - p >= 32);
+    h = XXH64Rotate(v1, 1) + XXH64Rotate(v2, 7) + XXH64Rotate(v3, 12) + XXH64Rotate(v4, 18);
+    h = XXH64Merge(h, v1);
+    h = XXH64Merge(h, v2);
+    h = XXH64Merge(h, v3);
+    h = XXH64Merge(h, v4);
   }
   else {
-    for (size_t i = 0; i < length; i++) {
-      char c = s[i];
-      if (c == '.') {
-        if (has_dot) {
-          is_number = 0;
-          break;
-        }
-        else {
-          has_dot = 1;
-        }
-      }
-      else if (!CharIsDigit(c)) {
-        is_number = 0;
-        break;
-      }
+    h = seed + XXH_PRIME64_5;
+  }
+  h += length;
+
+  for (; end - p >= 8; p += 8) {
+    h ^= XXH64Round(0, XXH64Read64(p));
+    h = XXH64Rotate(h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+  }
+  if (end - p >= 4) {
+    h ^= XXH64Read32(p) * XXH_PRIME64_1;
+    h = XXH64Rotate(h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+    p += 4;
+  }
+  for (; p < end; p++) {
+    h ^= *p * XXH_PRIME64_5;
+    h = XXH64Rotate(h, 11) * XXH_PRIME64_1;
+  }
+
+  h ^= h >> 33;
+  h *= XXH_PRIME64_2;
+  h ^= h >> 29;
+  h *= XXH_PRIME64_3;
+  h ^= h >> 32;
+  return h;
+}
+
+#ifndef _WIN32
+static inline int ReadFileBuffer(int fd, struct FileBuffer *fb) {
+  size_t capacity = 0;
+  while (1) {
+    if (fb->length == capacity) {
+      capacity = capacity > 0 ? capacity << 1 : 65536;
+      fb->data = realloc(fb->data, capacity);
+    }
+    ssize_t n = read(fd, fb->data + fb->length, capacity - fb->length);
+    if (n == 0) {
+      return 1;
     }
+    if (n < 0 && errno != EINTR) {
+      free(fb->data);
+      *fb = (struct FileBuffer) {};
+      return 0;
+    }
+    if (n > 0) {
+      fb->length += n;
+    }
+  }
+}
+#endif
+
+inline int OpenFileBuffer(const char *file_path, struct FileBuffer *fb) {
+  *fb = (struct FileBuffer) {};
+#ifdef _WIN32
+  FILE *f = fopen(file_path, "rb");
+  if (f == NULL) {
+    return 0;
+  }
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  rewind(f);
+  if (size > 0) {
+    fb->data = malloc(size);
+    fb->length = fread(fb->data, sizeof(char), size, f);
+  }
+  fclose(f);
+  return 1;
+#else
+  int fd = open(file_path, O_RDONLY);
+  if (fd < 0) {
+    return 0;
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    close(fd);
+    return 0;
+  }
+  // Pipes, FIFOs and files like /dev/stdin report no size, so they are read to the end
+  if (!S_ISREG(st.st_mode) || st.st_size == 0) {
+    int ok = ReadFileBuffer(fd, fb);
+    close(fd);
+    return ok;
+  }
+  void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (data == MAP_FAILED) {
+    close(fd);
+    return 0;
+  }
+  madvise(data, st.st_size, MADV_SEQUENTIAL);
+  fb->data = data;
+  fb->length = st.st_size;
+  fb->is_mapped = 1;
+  close(fd);
+  return 1;
+#endif
+}
+
+inline void CloseFileBuffer(struct FileBuffer *fb) {
+#ifndef _WIN32
+  if (fb->is_mapped) {
+    munmap(fb->data, fb->length);
+    *fb = (struct FileBuffer) {};
+    return;
   }
-  return is_number;
+#endif
+  free(fb->data);
+  *fb = (struct FileBuffer) {};
 }
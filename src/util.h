@@ -17,14 +17,35 @@
 #include <errno.h>
 #endif
 
+#ifndef _INC_STDINT
+#include <stdint.h>
+#endif
+
+#ifndef _INC_INTTYPES
+#include <inttypes.h>
+#endif
+
+#ifndef _INC_SETJMP
+#include <setjmp.h>
+#endif
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #define DebugLog(FormatString, ...)\
   fprintf(stderr, "DEBUG [%s:%d %s] " FormatString "\n", __FILE__, __LINE__, __func__, ##__VA_ARGS__)
 
 #define ErrorLog(FormatString, ...)\
   fprintf(stderr, "ERROR [%s:%d %s] " FormatString "\n", __FILE__, __LINE__, __func__, ##__VA_ARGS__)
 
+// Raises SE_FATAL under an error trap, and only prints and exits without one
 #define FatalLog(FormatString, ...)\
   do {\
+    RaiseSDFError(SE_FATAL, 0, 0, -1, NULL, 0);\
     fprintf(stderr, "FATAL [%s:%d %s] " FormatString "\n", __FILE__, __LINE__, __func__, ##__VA_ARGS__);\
     exit(1);\
   } while (0)
@@ -32,35 +53,195 @@
 #define StdErrorLog(FormatString, ...)\
   fprintf(stderr, "ERROR [%s:%d %s] %d %s" FormatString "\n", __FILE__, __LINE__, __func__, errno, strerror(errno), ##__VA_ARGS__)
 
+enum SDF_ErrorKind {
+  SE_NONE,
+  SE_INVALID_TOKEN,
+  SE_UNDEFINED_KEY,
+  SE_DUPLICATE_KEY,
+  SE_NO_MATCHING_VALUE,
+  SE_FILE,
+  SE_FATAL,
+};
+
+#define SDF_ERROR_TOKEN_SIZE 128
+
+/*
+  Why a parse failed. ln and col are 0 when the error has no position and
+  token_type is the TokenType of the offending token, or -1 when there is
+  none. token holds its text, or the key for key errors, cut to fit.
+*/
+struct SDF_Error {
+  enum SDF_ErrorKind kind;
+  int ln, col;
+  int token_type;
+  char token[SDF_ERROR_TOKEN_SIZE];
+};
+
+// Something to release if an error unwinds the function that pushed it
+struct SDF_Cleanup {
+  void (*function)(void *p);
+  void *p;
+  struct SDF_Cleanup *next;
+};
+
+/*
+  Catches errors raised on this thread while it is open: instead of
+  printing and exiting, the error macros fill in `error`, run the pushed
+  cleanups, close the trap and longjmp to `env`. Used as
+
+    OpenSDFErrorTrap(&trap);
+    if (setjmp(trap.env) == 0) {
+      ...
+      CloseSDFErrorTrap(&trap);
+    }
+    else {
+      // trap.error says what went wrong
+    }
+
+  Threads started during a parse have no trap, so errors there still exit.
+*/
+struct SDF_ErrorTrap {
+  jmp_buf env;
+  struct SDF_Error error;
+  struct SDF_Cleanup *cleanups;
+  struct SDF_ErrorTrap *previous;
+};
+
+extern _Thread_local struct SDF_ErrorTrap *sdf_error_trap;
+
+void OpenSDFErrorTrap(struct SDF_ErrorTrap *trap);
+void CloseSDFErrorTrap(struct SDF_ErrorTrap *trap);
+// Returns only when no trap is open, so the caller can report the error and exit
+void RaiseSDFError(enum SDF_ErrorKind kind, int ln, int col, int token_type, const char *text, size_t length);
+void PushSDFCleanup(struct SDF_Cleanup *c, void (*function)(void *p), void *p);
+void PopSDFCleanup(struct SDF_Cleanup *c);
+const char* SDFErrorKindToString(enum SDF_ErrorKind kind);
+
+enum SDF_AllocationKind {
+  AK_STRING_BUILDER,
+  AK_STRING_LIST,
+  AK_PARSER_VALUE_LIST,
+  AK_COUNT,
+};
+
+// Buffers created or grown, and their sizes in bytes
+struct SDF_AllocationStats {
+  size_t count[AK_COUNT];
+  size_t bytes[AK_COUNT];
+};
+
+/*
+  While set, builders and lists created or grown on this thread are
+  counted here. Threads helping with the same parse share the counters,
+  so they are added atomically.
+*/
+extern _Thread_local struct SDF_AllocationStats *sdf_allocation_stats;
+
+#define CountAllocation(kind, size)\
+  do {\
+    if (sdf_allocation_stats != NULL) {\
+      __atomic_add_fetch(&(sdf_allocation_stats->count[kind]), 1, __ATOMIC_RELAXED);\
+      __atomic_add_fetch(&(sdf_allocation_stats->bytes[kind]), (size), __ATOMIC_RELAXED);\
+    }\
+  } while (0)
+
+#define ARENA_BLOCK_SIZE 65536
+#define ARENA_ALIGNMENT 16
+
+/*
+  Bump allocator that owns everything allocated during a parse session.
+  Functions taking a `struct Arena *` fall back to malloc/realloc when it is NULL.
+*/
+struct ArenaBlock {
+  struct ArenaBlock *next;
+  size_t capacity, length;
+  char data[];
+};
+
+struct Arena {
+  struct ArenaBlock *head, *current;
+};
+
+struct Arena CreateArena(void);
+void* ArenaAlloc(struct Arena *a, size_t size);
+void* ArenaRealloc(struct Arena *a, void *p, size_t old_size, size_t new_size);
+void ArenaReset(struct Arena *a);
+void FreeArena(struct Arena *a);
+void ArenaAdopt(struct Arena *a, struct Arena *b);
+size_t ArenaSize(struct Arena *a);
+void ArenaCleanup(void *a);
+
+#define FILE_STRING_BUILDER_CAPACITY 65536
+
+/*
+  When `f` is set the builder is a fixed-size output buffer: instead of
+  growing it writes its contents to `f` and starts over.
+*/
 struct StringBuilder {
   char *string;
   size_t capacity, length;
+  FILE *f;
 };
 
 struct StringBuilder CreateStringBuilder(void);
+struct StringBuilder CreateFileStringBuilder(FILE *f);
+void StringBuilderReserve(struct StringBuilder *sb, size_t n);
+void StringBuilderFlush(struct StringBuilder *sb);
 void StringBuilderAddChar(struct StringBuilder *sb, char c);
 void StringBuilderAddString(struct StringBuilder *sb, char *s);
-char* StringBuilderTrim(struct StringBuilder *sb);
+char* StringBuilderTrim(struct StringBuilder *sb, struct Arena *a);
+char* StringBuilderTrimInPlace(struct StringBuilder *sb);
 void StringBuilderClear(struct StringBuilder *sb);
 void StringBuilderRecreate(struct StringBuilder *sb);
+// Cleanups for an SDF_ErrorTrap: frees sb->string, or *p
+void StringBuilderCleanup(void *sb);
+void PointerCleanup(void *p);
 
 struct StringList {
   char **items;
   size_t capacity, length;
+  struct Arena *arena;
+  int shared; // In use by several objects, which copy it instead of adding to it
 };
 
 struct StringList CreateStringList(void);
-struct StringList* NewStringList(void);
+struct StringList* NewStringList(struct Arena *a);
 void StringListAdd(struct StringList *sl, char *s);
 void StringBuilderAddSubString(struct StringBuilder *sb, char *s, int start, int stop);
 char* StringListToString(struct StringList *sl);
 
+#define CHAR_ALPHABETIC 1
+#define CHAR_DIGIT 2
+#define CHAR_OTHER 4
+#define CHAR_WHITESPACE 8
+
+extern const unsigned char CHAR_CLASSES[256];
+
 char* CharToString(char c);
 int CharIsAlphabetic(char c);
 int CharIsDigit(char c);
 int CharIsOther(char c);
 int CharIsWhiteSpace(char c);
 
+enum NumberType {
+  NT_NONE,
+  NT_INTEGER,
+  NT_DOUBLE,
+};
+
 int StringIsNumber(char *s);
+enum NumberType ParseNumber(char *s, int64_t *integer, double *real);
+uint32_t HashString(char *s, size_t length);
+uint64_t HashBytes(const void *data, size_t length, uint64_t seed);
+
+// Whole file contents, mmap'd where available and read into memory otherwise
+struct FileBuffer {
+  char *data;
+  size_t length;
+  int is_mapped;
+};
+
+int OpenFileBuffer(const char *file_path, struct FileBuffer *fb);
+void CloseFileBuffer(struct FileBuffer *fb);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,382 @@
+#include "watch.h"
+
+inline struct SDF_Document CreateSDFDocument(void) {
+  const size_t capacity = 32;
+  return (struct SDF_Document) {
+    .entries = malloc(sizeof(struct SDF_DocumentEntry) * capacity),
+    .capacity = capacity,
+    .arena = CreateArena(),
+    .root_arena = CreateArena(),
+    .context = CreateSDFParserContext(),
+  };
+}
+
+static inline void SDFDocumentAddEntry(struct SDF_DocumentEntry **entries, size_t *count, size_t *capacity, struct SDF_DocumentEntry e) {
+  if (*count >= *capacity) {
+    *capacity <<= 1;
+    *entries = realloc(*entries, sizeof(struct SDF_DocumentEntry) * *capacity);
+  }
+  (*entries)[*count] = e;
+  *count += 1;
+}
+
+static inline int SchemaEquals(struct StringList *a, struct StringList *b) {
+  if (a->length != b->length) {
+    return 0;
+  }
+  for (size_t i = 0; i < a->length; i++) {
+    if (strcmp(a->items[i], b->items[i]) != 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+// Puts the iterator at offset, a token boundary, with the line and column the tokenizer counts there
+static inline void TokenIteratorSeek(struct TokenIterator *ti, size_t offset) {
+  struct Token t;
+  ti->offset = 0;
+  ti->ln = 1;
+  ti->col = 1;
+  while (ti->offset < offset && GetNextToken(ti, &t));
+}
+
+// Offset of the next token that isn't whitespace, which is left to be read
+static inline size_t NextEntryStart(struct TokenIterator *ti) {
+  struct Token t;
+  while (GetNextToken(ti, &t)) {
+    if (t.type != TT_NEWLINE && t.type != TT_WHITESPACE) {
+      UngetToken(ti, &t);
+      return t.offset;
+    }
+  }
+  return ti->length;
+}
+
+// An arena SDFDocumentUpdate set aside, put back if the update fails
+struct SDF_ArenaBackup {
+  struct Arena *arena, previous;
+  struct SDF_Object *root, previous_root;
+};
+
+static void ArenaBackupRestore(void *p) {
+  struct SDF_ArenaBackup *b = p;
+  FreeArena(b->arena);
+  *(b->arena) = b->previous;
+  if (b->root != NULL) {
+    *(b->root) = b->previous_root;
+  }
+}
+
+// Where the arena ended before an update, to count what a failed one left in it as garbage
+struct SDF_GarbageMark {
+  struct SDF_Document *d;
+  size_t size;
+};
+
+static void GarbageMarkCount(void *p) {
+  struct SDF_GarbageMark *m = p;
+  m->d->garbage += ArenaSize(&(m->d->arena)) - m->size;
+}
+
+static inline void SDFDocumentBuildRoot(struct SDF_Document *d, struct SDF_DocumentEntry *entries, size_t count, char *text, size_t length) {
+  struct SDF_ArenaBackup backup = {
+    .arena = &(d->root_arena),
+    .previous = d->root_arena,
+    .root = &(d->root),
+    .previous_root = d->root,
+  };
+  struct SDF_Cleanup cleanup;
+  PushSDFCleanup(&cleanup, ArenaBackupRestore, &backup);
+
+  d->root_arena = CreateArena();
+  d->root = CreateSDFObject(&(d->root_arena));
+  for (size_t i = 0; i < count; i++) {
+    struct SDF_DocumentEntry *e = &(entries[i]);
+    if (e->key == NULL) {
+      continue;
+    }
+    if (!SDFObjectAddKey(&(d->root), e->key)) {
+      struct TokenIterator ti = CreateBufferTokenIterator(text, length);
+      TokenIteratorSeek(&ti, e->span.start);
+      struct Token t = {
+        .ln = ti.ln,
+        .col = ti.col,
+      };
+      DuplicateKeyError(t, e->key);
+    }
+    ParserValueListAdd(d->root.values, e->value);
+  }
+
+  PopSDFCleanup(&cleanup);
+  FreeArena(&(backup.previous));
+}
+
+inline void SDFDocumentUpdate(struct SDF_Document *d, char *text, size_t length) {
+  size_t old_length = d->length;
+  struct SDF_DocumentEntry *old = d->entries;
+  size_t old_count = d->count;
+  struct SDF_Cleanup cleanups[4];
+  PushSDFCleanup(&cleanups[0], PointerCleanup, &text);
+  struct SDF_ParserContext *previous = UseSDFParserContext(&(d->context));
+  PushSDFCleanup(&cleanups[3], ParserContextCleanup, previous);
+
+  // Bytes the old and new text share at the start and at the end
+  size_t shortest = length < old_length ? length : old_length;
+  size_t prefix = 0;
+  while (prefix < shortest && text[prefix] == d->text[prefix]) {
+    prefix++;
+  }
+  size_t suffix = 0;
+  while (suffix < shortest - prefix && text[length - suffix - 1] == d->text[old_length - suffix - 1]) {
+    suffix++;
+  }
+
+  // Too much garbage, start over in a new arena with nothing to reuse
+  struct SDF_ArenaBackup backup = {
+    .arena = &(d->arena),
+    .previous = d->arena,
+  };
+  struct SDF_GarbageMark mark = {
+    .d = d,
+    .size = ArenaSize(&(d->arena)),
+  };
+  int compact = d->garbage > old_length;
+  if (compact) {
+    d->arena = CreateArena();
+    old_count = 0;
+    PushSDFCleanup(&cleanups[1], ArenaBackupRestore, &backup);
+  }
+  else {
+    PushSDFCleanup(&cleanups[1], GarbageMarkCount, &mark);
+  }
+
+  // Entries followed by at least one unchanged byte parse the same way
+  size_t first = 0;
+  while (first < old_count && old[first].span.stop < prefix) {
+    first++;
+  }
+
+  size_t capacity = d->capacity;
+  size_t count = 0;
+  struct SDF_DocumentEntry *entries = malloc(sizeof(struct SDF_DocumentEntry) * capacity);
+  memcpy(entries, old, sizeof(struct SDF_DocumentEntry) * first);
+  count = first;
+  PushSDFCleanup(&cleanups[2], PointerCleanup, &entries);
+
+  struct StringList *schema = first > 0 ? old[first - 1].schema : NewStringList(&(d->arena));
+  struct TokenIterator ti = CreateBufferTokenIterator(text, length);
+  TokenIteratorSeek(&ti, first > 0 ? old[first - 1].span.stop : 0);
+
+  long delta = (long)length - (long)old_length;
+  size_t k = first;
+  size_t resume = old_count;
+  size_t reparsed = 0;
+  while (1) {
+    size_t start = NextEntryStart(&ti);
+
+    // Back in step with the old parse: the rest of the old entries still hold
+    while (k < old_count && (long)old[k].span.start + delta < (long)start) {
+      k++;
+    }
+    if (k < old_count
+        && (long)old[k].span.start + delta == (long)start
+        && old[k].span.start >= old_length - suffix
+        && SchemaEquals(schema, k > 0 ? old[k - 1].schema : &(struct StringList) {})) {
+      resume = k;
+      for (; k < old_count; k++) {
+        struct SDF_DocumentEntry e = old[k];
+        e.span.start += delta;
+        e.span.stop += delta;
+        SDFDocumentAddEntry(&entries, &count, &capacity, e);
+      }
+      break;
+    }
+
+    struct SDF_DocumentEntry e;
+    if (!ParseObjectEntry(&ti, &schema, &(d->arena), &(e.key), &(e.value), &(e.span))) {
+      break;
+    }
+    e.schema = schema;
+    SDFDocumentAddEntry(&entries, &count, &capacity, e);
+    reparsed++;
+  }
+
+  SDFDocumentBuildRoot(d, entries, count, text, length);
+  PopSDFCleanup(&cleanups[2]);
+  PopSDFCleanup(&cleanups[1]);
+  PopSDFCleanup(&cleanups[3]);
+  PopSDFCleanup(&cleanups[0]);
+  UseSDFParserContext(previous);
+
+  // The old entries that were parsed again are left in the arena, roughly as big as their text
+  if (compact) {
+    FreeArena(&(backup.previous));
+    d->garbage = 0;
+  }
+  for (size_t i = first; i < resume; i++) {
+    d->garbage += old[i].span.stop - old[i].span.start;
+  }
+
+  free(d->entries);
+  free(d->text);
+  d->entries = entries;
+  d->count = count;
+  d->capacity = capacity;
+  d->text = text;
+  d->length = length;
+  d->reparsed = reparsed;
+}
+
+
+inline void FreeSDFDocument(struct SDF_Document *d) {
+  free(d->entries);
+  free(d->text);
+  FreeArena(&(d->arena));
+  FreeArena(&(d->root_arena));
+  FreeSDFParserContext(&(d->context));
+  *d = (struct SDF_Document) {};
+}
+
+// Returns the contents of file_path, or NULL if it can't be read
+static char* ReadWholeFile(const char *file_path, size_t *length) {
+  struct FileBuffer fb;
+  if (!OpenFileBuffer(file_path, &fb)) {
+    return NULL;
+  }
+  char *text = malloc(fb.length + 1);
+  memcpy(text, fb.data, fb.length);
+  text[fb.length] = '\0';
+  *length = fb.length;
+  CloseFileBuffer(&fb);
+  return text;
+}
+
+// Reparses if the file no longer matches the document. Returns 0 if it can't be read
+static int WatchReload(const char *file_path, struct SDF_Document *d, SDF_DocumentCallback callback, void *user_data) {
+  size_t length;
+  char *text = ReadWholeFile(file_path, &length);
+  if (text == NULL) {
+    return 0;
+  }
+  if (d->text != NULL && length == d->length && memcmp(text, d->text, length) == 0) {
+    free(text);
+    return 1;
+  }
+  // A save with a syntax error keeps the last good document
+  struct SDF_ErrorTrap trap;
+  OpenSDFErrorTrap(&trap);
+  if (setjmp(trap.env) == 0) {
+    SDFDocumentUpdate(d, text, length);
+    CloseSDFErrorTrap(&trap);
+    callback(d, user_data);
+  }
+  else {
+    struct StringBuilder sb = CreateStringBuilder();
+    SDFErrorToString(&(trap.error), &sb);
+    fprintf(stderr, "Error! %s: %s\n", file_path, sb.string);
+    free(sb.string);
+  }
+  return 1;
+}
+
+#ifdef __linux__
+
+inline int WatchSDFFile(const char *file_path, SDF_DocumentCallback callback, void *user_data) {
+  // Editors often save by renaming a new file over the old one, so the directory is watched
+  char *path = strdup(file_path);
+  char *slash = strrchr(path, '/');
+  const char *directory = slash != NULL ? (slash == path ? "/" : path) : ".";
+  const char *name = slash != NULL ? slash + 1 : path;
+  if (slash != NULL && slash != path) {
+    *slash = '\0';
+  }
+
+  // Watching starts before the first read, so no change can slip in between
+  int fd = inotify_init1(IN_CLOEXEC);
+  if (fd < 0 || inotify_add_watch(fd, directory, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+    StdErrorLog("Failed to watch %s", directory);
+    if (fd >= 0) {
+      close(fd);
+    }
+    free(path);
+    return 0;
+  }
+
+  struct SDF_Document d = CreateSDFDocument();
+  if (!WatchReload(file_path, &d, callback, user_data)) {
+    fprintf(stderr, "Error! Failed to open file: %s\n", file_path);
+    close(fd);
+    free(path);
+    FreeSDFDocument(&d);
+    return 0;
+  }
+
+  char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  int ok = 1;
+  while (ok) {
+    ssize_t n = read(fd, events, sizeof(events));
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      StdErrorLog("Failed to read inotify events");
+      break;
+    }
+    int changed = 0;
+    for (char *p = events; p < events + n;) {
+      struct inotify_event *event = (struct inotify_event*)p;
+      if (event->len > 0 && strcmp(event->name, name) == 0) {
+        changed = 1;
+      }
+      p += sizeof(struct inotify_event) + event->len;
+    }
+    if (changed) {
+      ok = WatchReload(file_path, &d, callback, user_data);
+    }
+  }
+
+  close(fd);
+  free(path);
+  FreeSDFDocument(&d);
+  return 1;
+}
+
+#else
+
+inline int WatchSDFFile(const char *file_path, SDF_DocumentCallback callback, void *user_data) {
+  struct stat last, st;
+  stat(file_path, &last);
+  struct SDF_Document d = CreateSDFDocument();
+  if (!WatchReload(file_path, &d, callback, user_data)) {
+    fprintf(stderr, "Error! Failed to open file: %s\n", file_path);
+    FreeSDFDocument(&d);
+    return 0;
+  }
+
+  while (1) {
+#ifdef _WIN32
+    Sleep(WATCH_POLL_INTERVAL_MS);
+#else
+    struct timespec interval = {
+      .tv_sec = WATCH_POLL_INTERVAL_MS / 1000,
+      .tv_nsec = (WATCH_POLL_INTERVAL_MS % 1000) * 1000000L,
+    };
+    nanosleep(&interval, NULL);
+#endif
+    if (stat(file_path, &st) != 0) {
+      continue;
+    }
+    if (st.st_mtime != last.st_mtime || st.st_size != last.st_size) {
+      last = st;
+      if (!WatchReload(file_path, &d, callback, user_data)) {
+        break;
+      }
+    }
+  }
+
+  FreeSDFDocument(&d);
+  return 1;
+}
+
+#endif
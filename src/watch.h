@@ -0,0 +1,72 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+#ifdef _WIN32
+#include <sys/stat.h>
+#include <windows.h>
+#endif
+
+#ifndef _INC_TIME
+#include <time.h>
+#endif
+
+#include "parser.h"
+#include "sdf.h"
+#include "tokenizer.h"
+#include "util.h"
+
+// How often the file is checked where inotify isn't available
+#define WATCH_POLL_INTERVAL_MS 250
+
+// A top-level key and its value, or a schema declared on its own (key NULL)
+struct SDF_DocumentEntry {
+  struct SDF_Span span;
+  char *key;
+  struct ParserValue value;
+  struct StringList *schema; // In effect after the entry
+};
+
+/*
+  A parsed document that follows edits to its text. SDFDocumentUpdate
+  keeps the entries before the first changed byte and, once parsing the
+  changed part reaches the start of an old entry in the unchanged tail
+  with the same schema in effect, the rest of the old entries too. Only
+  the entries in between are parsed again. Replaced values stay in the
+  arena until they add up to more than the text, when the document is
+  parsed from scratch into a new one.
+*/
+struct SDF_Document {
+  char *text;
+  size_t length;
+  struct SDF_DocumentEntry *entries;
+  size_t count, capacity;
+  struct SDF_Object root; // Rebuilt in root_arena by every update
+  struct Arena arena, root_arena;
+  struct SDF_ParserContext context;
+  size_t garbage;
+  size_t reparsed; // Entries parsed by the last update
+};
+
+struct SDF_Document CreateSDFDocument(void);
+/*
+  Takes ownership of text, which must come from malloc. Under an open
+  SDF_ErrorTrap a syntax error frees text and leaves d as it was.
+*/
+void SDFDocumentUpdate(struct SDF_Document *d, char *text, size_t length);
+void FreeSDFDocument(struct SDF_Document *d);
+
+typedef void (*SDF_DocumentCallback)(struct SDF_Document *d, void *user_data);
+
+/*
+  Parses file_path and calls callback with the document, then again after
+  every change to the file until reading it fails. Saves that replace
+  the file by renaming are followed too. Versions that fail to parse are
+  reported on stderr and skipped.
+*/
+int WatchSDFFile(const char *file_path, SDF_DocumentCallback callback, void *user_data);
+
+#endif
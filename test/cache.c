@@ -0,0 +1,156 @@
+#include <dirent.h>
+
+#include "cache.h"
+#include "main.h"
+
+/*
+  Checks when CachedFilePathToFormat reuses an entry and when it converts
+  the file again. The conversions of main.c are replaced below by ones
+  that count their calls and copy the input, so the test doesn't need
+  main.c. Build it from cache.c, the library sources and this file:
+
+    gcc -std=gnu11 -O1 -pthread -Isrc -o sdf-cache-test test/cache.c src/cache.c \
+      $(ls src/[a-z]*.c | grep -v 'main\|batch\|cache\|stats')
+
+  It works in a new directory under $TMPDIR or /tmp, prints every failing
+  check and exits with 1 if there was one.
+*/
+
+static size_t cache_conversions;
+
+void BufferToFormat(char *data, size_t length, struct StringBuilder *sb, int jobs, enum SDF_OutputFormat format) {
+  cache_conversions++;
+  StringBuilderAddString(sb, format == OF_JSON ? "json:" : "binary:");
+  StringBuilderReserve(sb, length);
+  memcpy(sb->string + sb->length, data, length);
+  sb->length += length;
+  sb->string[sb->length] = '\0';
+}
+
+void FilePathToFormat(const char *file_path, struct StringBuilder *sb, int jobs, enum SDF_OutputFormat format) {
+  cache_conversions++;
+  StringBuilderAddString(sb, "missing");
+}
+
+static char cache_dir[512], cache_file[512];
+
+// Replaces the file's contents and sets its mtime to `offset` seconds from now
+static void CacheWriteFile(const char *contents, time_t offset) {
+  FILE *f = fopen(cache_file, "wb");
+  fputs(contents, f);
+  fclose(f);
+  struct timespec times[2] = {
+    {.tv_sec = time(NULL) + offset},
+    {.tv_sec = time(NULL) + offset},
+  };
+  utimensat(AT_FDCWD, cache_file, times, 0);
+}
+
+// Sets the file's mtime without changing its contents, like touch
+static void CacheTouchFile(time_t offset) {
+  struct timespec times[2] = {
+    {.tv_sec = time(NULL) + offset},
+    {.tv_sec = time(NULL) + offset},
+  };
+  utimensat(AT_FDCWD, cache_file, times, 0);
+}
+
+static void CacheSetMTime(struct timespec *mtime) {
+  struct timespec times[2] = {*mtime, *mtime};
+  utimensat(AT_FDCWD, cache_file, times, 0);
+}
+
+static struct timespec CacheGetMTime(void) {
+  struct stat st;
+  stat(cache_file, &st);
+  return st.st_mtim;
+}
+
+// Converts the file through the cache. Returns 1 if the output or the number of conversions wasn't the expected one
+static int CacheCheck(const char *name, enum SDF_OutputFormat format, const char *output, size_t conversions) {
+  struct StringBuilder sb = CreateStringBuilder();
+  CachedFilePathToFormat(cache_dir, cache_file, &sb, 1, format);
+  int failed = strcmp(sb.string, output) != 0 || cache_conversions != conversions;
+  if (failed) {
+    printf("FAIL %s: %s after %zu conversions\n", name, sb.string, cache_conversions);
+  }
+  free(sb.string);
+  return failed;
+}
+
+static void CacheRemove(void) {
+  DIR *dir = opendir(cache_dir);
+  struct dirent *e;
+  while (dir != NULL && (e = readdir(dir)) != NULL) {
+    if (strcmp(e->d_name, ".") != 0 && strcmp(e->d_name, "..") != 0) {
+      char path[1024];
+      snprintf(path, sizeof(path), "%s/%s", cache_dir, e->d_name);
+      unlink(path);
+    }
+  }
+  if (dir != NULL) {
+    closedir(dir);
+  }
+  rmdir(cache_dir);
+  unlink(cache_file);
+}
+
+int main(void) {
+  const char *tmp = getenv("TMPDIR") != NULL ? getenv("TMPDIR") : "/tmp";
+  char root[256];
+  snprintf(root, sizeof(root), "%s/sdf-cache-XXXXXX", tmp);
+  if (mkdtemp(root) == NULL) {
+    fprintf(stderr, "Error! Failed to create a directory in %s\n", tmp);
+    return 1;
+  }
+  snprintf(cache_dir, sizeof(cache_dir), "%s/cache", root);
+  snprintf(cache_file, sizeof(cache_file), "%s/file.sdf", root);
+
+  size_t failed = 0, checks = 0;
+  // An mtime from before the entry is written is trusted
+  CacheWriteFile("a = 1\n", -100);
+  failed += CacheCheck("first conversion", OF_JSON, "json:a = 1\n", 1);
+  failed += CacheCheck("hit", OF_JSON, "json:a = 1\n", 1);
+  checks += 2;
+
+  // Same size and mtime: the entry is used without reading the file
+  struct timespec mtime = CacheGetMTime();
+  CacheWriteFile("a = 2\n", 0);
+  CacheSetMTime(&mtime);
+  failed += CacheCheck("mtime only trusted", OF_JSON, "json:a = 1\n", 1);
+  checks += 1;
+
+  // A touched file with the same contents hashes the same, and gets its new mtime stored
+  CacheWriteFile("a = 1\n", -50);
+  failed += CacheCheck("hash after a touch", OF_JSON, "json:a = 1\n", 1);
+  mtime = CacheGetMTime();
+  CacheWriteFile("a = 2\n", 0);
+  CacheSetMTime(&mtime);
+  failed += CacheCheck("mtime stored after a touch", OF_JSON, "json:a = 1\n", 1);
+  CacheTouchFile(-20);
+  failed += CacheCheck("hash changed after a touch", OF_JSON, "json:a = 2\n", 2);
+  checks += 3;
+
+  // An mtime that hasn't passed when the entry is written could belong to a later change too
+  CacheWriteFile("a = 3\n", 100);
+  failed += CacheCheck("conversion of a recent file", OF_JSON, "json:a = 3\n", 3);
+  mtime = CacheGetMTime();
+  CacheWriteFile("a = 4\n", 0);
+  CacheSetMTime(&mtime);
+  failed += CacheCheck("recent mtime not trusted", OF_JSON, "json:a = 4\n", 4);
+  checks += 2;
+
+  // Each format has its own entry
+  CacheWriteFile("a = 5\n", -10);
+  failed += CacheCheck("json entry", OF_JSON, "json:a = 5\n", 5);
+  failed += CacheCheck("msgpack entry", OF_MSGPACK, "binary:a = 5\n", 6);
+  failed += CacheCheck("json hit after msgpack", OF_JSON, "json:a = 5\n", 6);
+  failed += CacheCheck("msgpack hit after json", OF_MSGPACK, "binary:a = 5\n", 6);
+  failed += CacheCheck("cbor entry", OF_CBOR, "binary:a = 5\n", 7);
+  checks += 5;
+
+  CacheRemove();
+  rmdir(root);
+  printf("%zu of %zu checks failed\n", failed, checks);
+  return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,743 @@
+#include <float.h>
+
+#include "binary.h"
+#include "events.h"
+#include "format.h"
+#include "image.h"
+#include "push.h"
+#include "query.h"
+#include "sdf.h"
+#include "watch.h"
+
+/*
+  Inputs the ways of parsing a document once disagreed on. Every case is
+  converted to JSON by each converter below, which must all give the
+  expected output, or all fail when none is expected. Build it from
+  regress.c and the library sources, and run it without arguments:
+
+    gcc -std=gnu11 -O1 -pthread -Isrc -o sdf-regress test/regress.c \
+      $(ls src/[a-z]*.c | grep -v 'main\|batch\|cache\|stats')
+
+  It prints every failing case and exits with 1 if there was one.
+*/
+
+struct RegressCase {
+  const char *name, *input;
+  const char *json; // NULL for input that must be rejected
+};
+
+static const struct RegressCase REGRESS_CASES[] = {
+  {
+    "objects, lists and schema rows",
+    "name = Alice\nperson {\n  age = 35; city = Oslo\n}\nfruits [\n  apple\n  banana\n]\n"
+    "people (name; age) [\n  Bob; 55\n  Eve; 41\n]\n",
+    "{\"name\":\"Alice\",\"person\":{\"age\":35,\"city\":\"Oslo\"},\"fruits\":[\"apple\",\"banana\"],"
+    "\"people\":[{\"name\":\"Bob\",\"age\":55},{\"name\":\"Eve\",\"age\":41}]}\n",
+  },
+  {
+    "schema row cut by a nested value",
+    "rows (a; b) [\n 1; 2\n 3\n]\nplain [\n x\n {k = 1}\n]",
+    "{\"rows\":[{\"a\":1,\"b\":2},{\"a\":3}],\"plain\":[{\"k\":1},{\"a\":\"x\"}]}\n",
+  },
+  {
+    "schema row cut by a nested list",
+    "l (a; b) [\n 1\n [2; 3]\n 4\n]",
+    "{\"l\":[[{\"a\":2,\"b\":3}],{\"a\":1,\"b\":4}]}\n",
+  },
+  {
+    "value without a key",
+    "a = 1\n= 2\nb = 3",
+    NULL,
+  },
+  {
+    "value without a key in a nested object",
+    "o {\n a = 1\n = 2\n}",
+    NULL,
+  },
+  {
+    "duplicate key",
+    "a = 1\nb = 2\na = 3",
+    NULL,
+  },
+  {
+    "duplicate key of a nested object",
+    "o {\n a = 1\n a {b = 2}\n}",
+    NULL,
+  },
+  {
+    "same keys in sibling objects",
+    "l [\n {a = 1; b = 2}\n {b = 3; a = 4}\n]\no {a = 5}",
+    "{\"l\":[{\"a\":1,\"b\":2},{\"b\":3,\"a\":4}],\"o\":{\"a\":5}}\n",
+  },
+  {
+    "schema declared on its own",
+    "(x; y)\nl [\n 1; 2\n]",
+    "{\"l\":[{\"x\":1,\"y\":2}]}\n",
+  },
+};
+
+// Runs convert under an error trap. Returns 0 if it raised an error
+static int RegressTrap(void (*convert)(const char *input, struct StringBuilder *sb), const char *input, struct StringBuilder *sb) {
+  struct SDF_ErrorTrap trap;
+  OpenSDFErrorTrap(&trap);
+  if (setjmp(trap.env) == 0) {
+    convert(input, sb);
+    CloseSDFErrorTrap(&trap);
+    return 1;
+  }
+  return 0;
+}
+
+static void RegressTree(const char *input, struct StringBuilder *sb) {
+  struct SDF_Error error;
+  if (!SDFToJSON((char*)input, strlen(input), sb, &error)) {
+    RaiseSDFError(error.kind, error.ln, error.col, error.token_type, error.token, strlen(error.token));
+  }
+}
+
+static void RegressEvents(const char *input, struct StringBuilder *sb) {
+  struct TokenIterator ti = CreateBufferTokenIterator((char*)input, strlen(input));
+  struct JSONWriter w = CreateJSONWriter(sb);
+  struct SDF_EventHandler h = CreateJSONEventHandler(&w);
+  ParseObjectEvents(&ti, &h);
+  StringBuilderAddChar(sb, '\n');
+}
+
+static void RegressFreePushParser(void *p) {
+  FreeSDFPushParser(p);
+}
+
+// Feeds the input a byte at a time, so every token is cut by a chunk boundary
+static void RegressPush(const char *input, struct StringBuilder *sb) {
+  struct JSONWriter w = CreateJSONWriter(sb);
+  struct SDF_EventHandler h = CreateJSONEventHandler(&w);
+  struct SDF_PushParser p = CreateSDFPushParser(&h);
+  struct SDF_Cleanup cleanup;
+  PushSDFCleanup(&cleanup, RegressFreePushParser, &p);
+  for (size_t i = 0; input[i] != '\0'; i++) {
+    SDFPushParserFeed(&p, input + i, 1);
+  }
+  SDFPushParserFinish(&p);
+  PopSDFCleanup(&cleanup);
+  FreeSDFPushParser(&p);
+  StringBuilderAddChar(sb, '\n');
+}
+
+/*
+  Chunks fed to a push parser one after the other, with the JSON its
+  events must have written by then: every complete token is handled
+  right away, and only a token that could go on in the next chunk waits.
+*/
+static const struct {
+  const char *chunk, *json;
+} REGRESS_PUSH_CHUNKS[] = {
+  {"name = Al", "{\"name\":"},
+  {"ice\nlist [\n 1\n 2", "{\"name\":\"Alice\",\"list\":[1"},
+  {"3", "{\"name\":\"Alice\",\"list\":[1"},
+  {"\n]\nobj {a", "{\"name\":\"Alice\",\"list\":[1,23],\"obj\":{"},
+  {" = \"x", "{\"name\":\"Alice\",\"list\":[1,23],\"obj\":{\"a\":"},
+  {"y\"}", "{\"name\":\"Alice\",\"list\":[1,23],\"obj\":{\"a\":\"xy\"}"},
+  {"\nb = 1", "{\"name\":\"Alice\",\"list\":[1,23],\"obj\":{\"a\":\"xy\"},\"b\":"},
+};
+
+static size_t RegressPushChunks(void) {
+  size_t failed = 0;
+  struct StringBuilder sb = CreateStringBuilder();
+  struct JSONWriter w = CreateJSONWriter(&sb);
+  struct SDF_EventHandler h = CreateJSONEventHandler(&w);
+  struct SDF_PushParser p = CreateSDFPushParser(&h);
+  for (size_t i = 0; i < sizeof(REGRESS_PUSH_CHUNKS) / sizeof(REGRESS_PUSH_CHUNKS[0]); i++) {
+    SDFPushParserFeed(&p, REGRESS_PUSH_CHUNKS[i].chunk, strlen(REGRESS_PUSH_CHUNKS[i].chunk));
+    if (strcmp(sb.string, REGRESS_PUSH_CHUNKS[i].json) != 0) {
+      printf("FAIL push chunk %zu (push): %s\n", i, sb.string);
+      failed++;
+    }
+  }
+  FreeSDFPushParser(&p);
+  free(sb.string);
+  return failed;
+}
+
+static void RegressFreeDocument(void *d) {
+  FreeSDFDocument(d);
+}
+
+// Parses the input entry by entry, the way a watched file is
+static void RegressWatch(const char *input, struct StringBuilder *sb) {
+  struct SDF_Document d = CreateSDFDocument();
+  struct SDF_Cleanup cleanup;
+  PushSDFCleanup(&cleanup, RegressFreeDocument, &d);
+  size_t length = strlen(input);
+  char *text = malloc(length + 1);
+  memcpy(text, input, length + 1);
+  SDFDocumentUpdate(&d, text, length);
+  SDFObjectToString(&(d.root), sb);
+  StringBuilderAddChar(sb, '\n');
+  PopSDFCleanup(&cleanup);
+  FreeSDFDocument(&d);
+}
+
+static void RegressFreeArena(void *a) {
+  FreeArena(a);
+}
+
+static void RegressFreeBuilder(void *sb) {
+  free(((struct StringBuilder*)sb)->string);
+}
+
+// Parses the input into a tree and compiles it into an image after a few other bytes
+static void RegressCompile(const char *input, struct StringBuilder *image, size_t *start) {
+  struct TokenIterator ti = CreateBufferTokenIterator((char*)input, strlen(input));
+  struct Arena a = CreateArena();
+  struct SDF_Cleanup cleanup;
+  PushSDFCleanup(&cleanup, RegressFreeArena, &a);
+  struct SDF_Object o = ParseObject(&ti, &a);
+  PopSDFCleanup(&cleanup);
+  StringBuilderAddString(image, "abc");
+  *start = image->length;
+  CompileSDFObject(&o, image);
+  FreeArena(&a);
+}
+
+static void RegressImageToJSON(const char *data, size_t length, struct StringBuilder *sb) {
+  struct SDF_Image image;
+  struct SDF_ImageValue root;
+  if (!LoadSDFImage(data, length, &image) || !SDFImageRoot(&image, &root)) {
+    RaiseSDFError(SE_FATAL, 0, 0, -1, NULL, 0);
+    return;
+  }
+  SDFImageValueToString(&root, sb);
+  StringBuilderAddChar(sb, '\n');
+}
+
+// Compiles the input and reads it back from the image
+static void RegressImage(const char *input, struct StringBuilder *sb) {
+  struct StringBuilder image = CreateStringBuilder();
+  size_t start;
+  struct SDF_Cleanup cleanup;
+  PushSDFCleanup(&cleanup, RegressFreeBuilder, &image);
+  RegressCompile(input, &image, &start);
+  PopSDFCleanup(&cleanup);
+  RegressImageToJSON(image.string + start, image.length - start, sb);
+  free(image.string);
+}
+
+static const struct {
+  const char *name;
+  void (*convert)(const char *input, struct StringBuilder *sb);
+} REGRESS_CONVERTERS[] = {
+  {"tree", RegressTree},
+  {"events", RegressEvents},
+  {"push", RegressPush},
+  {"watch", RegressWatch},
+  {"image", RegressImage},
+};
+
+/*
+  Parsed objects with the same keys share them. Adding a key to the first
+  item of the list `l` must leave the other items as they were.
+*/
+static const struct RegressCase REGRESS_ADD_KEY_CASES[] = {
+  {
+    "objects with the same keys",
+    "l [\n {a = 1}\n {a = 2}\n]",
+    "{\"l\":[{\"a\":1,\"b\":0},{\"a\":2}]}\n",
+  },
+  {
+    "rows turned back into objects",
+    "l (a) [\n 1\n 2\n {c = 3}\n]",
+    "{\"l\":[{\"a\":1,\"b\":0},{\"a\":2},{\"c\":3}]}\n",
+  },
+};
+
+static void RegressAddKey(const char *input, struct StringBuilder *sb) {
+  struct TokenIterator ti = CreateBufferTokenIterator((char*)input, strlen(input));
+  struct Arena a = CreateArena();
+  struct SDF_Object o = ParseObject(&ti, &a);
+  struct SDF_List *l = &(SDFObjectGet(&o, "l")->data.as_list);
+  struct SDF_Object *first = &(l->items->items[0].data.as_object);
+  if (SDFObjectAddKey(first, "b")) {
+    ParserValueListAdd(first->values, CreateParserValueInteger(0));
+  }
+  SDFObjectToString(&o, sb);
+  StringBuilderAddChar(sb, '\n');
+  FreeArena(&a);
+}
+
+/*
+  Damage to the image of REGRESS_IMAGE_INPUT. The reader must refuse to
+  load it (json NULL) or give what can still be read, without reading
+  past the image.
+*/
+static const char REGRESS_IMAGE_INPUT[] = "key = value\nn = 1\nlist [\n 2\n 3\n]";
+
+// Overwrites the '\0' after the string s in the image
+static void RegressCutString(char *data, size_t length, const char *s) {
+  size_t n = strlen(s) + 1;
+  for (size_t i = 0; i + n <= length; i++) {
+    if (memcmp(data + i, s, n) == 0) {
+      data[i + n - 1] = 'x';
+      return;
+    }
+  }
+}
+
+static void RegressTruncate(char *data, size_t *length) {
+  *length -= 1;
+}
+
+static void RegressUnknownVersion(char *data, size_t *length) {
+  data[4] = 99;
+}
+
+static void RegressRootPastEnd(char *data, size_t *length) {
+  memset(data + 8, 0x7f, 4);
+}
+
+static void RegressCutValue(char *data, size_t *length) {
+  RegressCutString(data, *length, "value");
+}
+
+static void RegressCutKey(char *data, size_t *length) {
+  RegressCutString(data, *length, "list");
+}
+
+static const struct {
+  const char *name;
+  void (*damage)(char *data, size_t *length);
+  const char *json;
+} REGRESS_IMAGE_DAMAGE[] = {
+  {"truncated image", RegressTruncate, NULL},
+  {"unknown image version", RegressUnknownVersion, NULL},
+  {"root past the end of the image", RegressRootPastEnd, NULL},
+  {"string without its terminator", RegressCutValue, "{\"key\":null,\"n\":1,\"list\":[2,3]}\n"},
+  {"key without its terminator", RegressCutKey, "{\"key\":\"value\",\"n\":1}\n"},
+};
+
+static size_t regress_damage;
+
+static void RegressDamagedImage(const char *input, struct StringBuilder *sb) {
+  struct StringBuilder image = CreateStringBuilder();
+  size_t start;
+  RegressCompile(input, &image, &start);
+  // A copy of the exact size, so reading past the end is caught by sanitizers
+  size_t length = image.length - start;
+  char *data = malloc(length);
+  memcpy(data, image.string + start, length);
+  free(image.string);
+  REGRESS_IMAGE_DAMAGE[regress_damage].damage(data, &length);
+  struct SDF_Cleanup cleanup;
+  PushSDFCleanup(&cleanup, free, data);
+  RegressImageToJSON(data, length, sb);
+  PopSDFCleanup(&cleanup);
+  free(data);
+}
+
+// Integers around the edges of the two digits at a time FormatInteger writes
+static const struct {
+  int64_t value;
+  const char *text;
+} REGRESS_INTEGERS[] = {
+  {0, "0"},
+  {9, "9"},
+  {10, "10"},
+  {99, "99"},
+  {100, "100"},
+  {999, "999"},
+  {1000, "1000"},
+  {99999999, "99999999"},
+  {100000000, "100000000"},
+  {-1, "-1"},
+  {-100, "-100"},
+  {INT64_MAX, "9223372036854775807"},
+  {INT64_MIN, "-9223372036854775808"},
+};
+
+static const struct {
+  double value;
+  const char *text;
+} REGRESS_DOUBLES[] = {
+  {0.1, "0.1"},
+  {0.5, "0.5"},
+  {-0.0, "-0"},
+  {123.456, "123.456"},
+  {1.0 / 3, "0.3333333333333333"},
+  {5e-324, "5e-324"},
+  {2.2250738585072014e-308, "2.2250738585072014e-308"},
+  {DBL_MAX, "1.7976931348623157e+308"},
+  {1e20, "100000000000000000000"},
+  {1e21, "1e+21"},
+  {1.5e21, "1.5e+21"},
+  // Grisu3 gives up on this one, and Grisu2 wrote 9.999999999999999e+22
+  {1e23, "1e+23"},
+  {0.000001, "0.000001"},
+  {1e-7, "1e-7"},
+  {1.5e-7, "1.5e-7"},
+  {NAN, "null"},
+  {-INFINITY, "null"},
+};
+
+static size_t RegressFormat(void) {
+  size_t failed = 0;
+  char buffer[FORMAT_NUMBER_MAX_LENGTH + 1];
+  for (size_t i = 0; i < sizeof(REGRESS_INTEGERS) / sizeof(REGRESS_INTEGERS[0]); i++) {
+    buffer[FormatInteger(REGRESS_INTEGERS[i].value, buffer)] = '\0';
+    if (strcmp(buffer, REGRESS_INTEGERS[i].text) != 0) {
+      printf("FAIL integer %s (format): %s\n", REGRESS_INTEGERS[i].text, buffer);
+      failed++;
+    }
+  }
+  for (size_t i = 0; i < sizeof(REGRESS_DOUBLES) / sizeof(REGRESS_DOUBLES[0]); i++) {
+    buffer[FormatDouble(REGRESS_DOUBLES[i].value, buffer)] = '\0';
+    if (strcmp(buffer, REGRESS_DOUBLES[i].text) != 0) {
+      printf("FAIL double %s (format): %s\n", REGRESS_DOUBLES[i].text, buffer);
+      failed++;
+    }
+  }
+  return failed;
+}
+
+#define REGRESS_BYTES(s) s, sizeof(s) - 1
+#define REGRESS_FFFD "\xEF\xBF\xBD"
+
+// Inputs longer than 32 bytes also go through the vector scan for plain runs
+static const struct {
+  const char *input;
+  size_t length;
+  const char *json;
+} REGRESS_STRINGS[] = {
+  {REGRESS_BYTES(""), "\"\""},
+  {REGRESS_BYTES("plain"), "\"plain\""},
+  {REGRESS_BYTES("a\"b\\c"), "\"a\\\"b\\\\c\""},
+  {REGRESS_BYTES("\b\f\n\r\t"), "\"\\b\\f\\n\\r\\t\""},
+  {REGRESS_BYTES("\x01\x1F\x7F"), "\"\\u0001\\u001f\x7F\""},
+  {REGRESS_BYTES("nul\0byte"), "\"nul\\u0000byte\""},
+  {REGRESS_BYTES("0123456789abcdef0123456789abcdef0123\"\n"), "\"0123456789abcdef0123456789abcdef0123\\\"\\n\""},
+  {REGRESS_BYTES("0123456789abcdef0123456789abcdef\x01"), "\"0123456789abcdef0123456789abcdef\\u0001\""},
+  // Valid sequences of every length, and the highest code point
+  {REGRESS_BYTES("\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80\xF4\x8F\xBF\xBF"), "\"\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80\xF4\x8F\xBF\xBF\""},
+  // Truncated sequences, at the end and before other bytes
+  {REGRESS_BYTES("a\xC3"), "\"a" REGRESS_FFFD "\""},
+  {REGRESS_BYTES("\xE2\x82"), "\"" REGRESS_FFFD "\""},
+  {REGRESS_BYTES("\xF0\x9F\x98" "b"), "\"" REGRESS_FFFD "b\""},
+  {REGRESS_BYTES("\xE2\x82\""), "\"" REGRESS_FFFD "\\\"\""},
+  // Stray continuation bytes and bytes that never start a sequence
+  {REGRESS_BYTES("\x80\xBF"), "\"" REGRESS_FFFD REGRESS_FFFD "\""},
+  {REGRESS_BYTES("\xFE\xFF"), "\"" REGRESS_FFFD REGRESS_FFFD "\""},
+  // Overlong forms of '/', U+07FF and U+FFFF
+  {REGRESS_BYTES("\xC0\xAF"), "\"" REGRESS_FFFD REGRESS_FFFD "\""},
+  {REGRESS_BYTES("\xE0\x9F\xBF"), "\"" REGRESS_FFFD REGRESS_FFFD REGRESS_FFFD "\""},
+  {REGRESS_BYTES("\xF0\x8F\xBF\xBF"), "\"" REGRESS_FFFD REGRESS_FFFD REGRESS_FFFD REGRESS_FFFD "\""},
+  // Surrogates U+D800 and U+DFFF, and U+110000
+  {REGRESS_BYTES("\xED\xA0\x80"), "\"" REGRESS_FFFD REGRESS_FFFD REGRESS_FFFD "\""},
+  {REGRESS_BYTES("\xED\xBF\xBF"), "\"" REGRESS_FFFD REGRESS_FFFD REGRESS_FFFD "\""},
+  {REGRESS_BYTES("\xED\x9F\xBF"), "\"\xED\x9F\xBF\""},
+  {REGRESS_BYTES("\xF4\x90\x80\x80"), "\"" REGRESS_FFFD REGRESS_FFFD REGRESS_FFFD REGRESS_FFFD "\""},
+};
+
+static size_t RegressJSONString(void) {
+  size_t failed = 0;
+  for (size_t i = 0; i < sizeof(REGRESS_STRINGS) / sizeof(REGRESS_STRINGS[0]); i++) {
+    struct StringBuilder sb = CreateStringBuilder();
+    StringBuilderAddJSONString(&sb, REGRESS_STRINGS[i].input, REGRESS_STRINGS[i].length);
+    if (sb.length != strlen(REGRESS_STRINGS[i].json) || memcmp(sb.string, REGRESS_STRINGS[i].json, sb.length) != 0) {
+      printf("FAIL string %zu (json): %.*s\n", i, (int)sb.length, sb.string);
+      failed++;
+    }
+    free(sb.string);
+  }
+  return failed;
+}
+
+// Integers at both ends of every width, as MessagePack and CBOR bytes
+static const struct {
+  int64_t value;
+  const char *msgpack, *cbor;
+} REGRESS_BINARY_INTEGERS[] = {
+  {0, "00", "00"},
+  {23, "17", "17"},
+  {24, "18", "18 18"},
+  {127, "7f", "18 7f"},
+  {128, "cc 80", "18 80"},
+  {255, "cc ff", "18 ff"},
+  {256, "cd 01 00", "19 01 00"},
+  {65535, "cd ff ff", "19 ff ff"},
+  {65536, "ce 00 01 00 00", "1a 00 01 00 00"},
+  {4294967295, "ce ff ff ff ff", "1a ff ff ff ff"},
+  {4294967296, "cf 00 00 00 01 00 00 00 00", "1b 00 00 00 01 00 00 00 00"},
+  {INT64_MAX, "cf 7f ff ff ff ff ff ff ff", "1b 7f ff ff ff ff ff ff ff"},
+  {-1, "ff", "20"},
+  {-24, "e8", "37"},
+  {-25, "e7", "38 18"},
+  {-32, "e0", "38 1f"},
+  {-33, "d0 df", "38 20"},
+  {-128, "d0 80", "38 7f"},
+  {-129, "d1 ff 7f", "38 80"},
+  {-256, "d1 ff 00", "38 ff"},
+  {-257, "d1 fe ff", "39 01 00"},
+  {-32768, "d1 80 00", "39 7f ff"},
+  {-32769, "d2 ff ff 7f ff", "39 80 00"},
+  {-65537, "d2 ff fe ff ff", "3a 00 01 00 00"},
+  {INT32_MIN, "d2 80 00 00 00", "3a 7f ff ff ff"},
+  {INT32_MIN - 1LL, "d3 ff ff ff ff 7f ff ff ff", "3a 80 00 00 00"},
+  {INT64_MIN, "d3 80 00 00 00 00 00 00 00", "3b 7f ff ff ff ff ff ff ff"},
+};
+
+// Doubles a float holds exactly are written as float32
+static const struct {
+  double value;
+  const char *msgpack, *cbor;
+} REGRESS_BINARY_DOUBLES[] = {
+  {1.5, "ca 3f c0 00 00", "fa 3f c0 00 00"},
+  {-0.0, "ca 80 00 00 00", "fa 80 00 00 00"},
+  {3.4028234663852886e38, "ca 7f 7f ff ff", "fa 7f 7f ff ff"},
+  {1.401298464324817e-45, "ca 00 00 00 01", "fa 00 00 00 01"},
+  {0.1, "cb 3f b9 99 99 99 99 99 9a", "fb 3f b9 99 99 99 99 99 9a"},
+  {16777217.0, "cb 41 70 00 00 10 00 00 00", "fb 41 70 00 00 10 00 00 00"},
+  {1e300, "cb 7e 37 e4 3c 88 00 75 9c", "fb 7e 37 e4 3c 88 00 75 9c"},
+};
+
+// Headers of strings of each length, which are followed by that many bytes
+static const struct {
+  size_t length;
+  const char *msgpack, *cbor;
+} REGRESS_BINARY_STRINGS[] = {
+  {0, "a0", "60"},
+  {23, "b7", "77"},
+  {24, "b8", "78 18"},
+  {31, "bf", "78 1f"},
+  {32, "d9 20", "78 20"},
+  {255, "d9 ff", "78 ff"},
+  {256, "da 01 00", "79 01 00"},
+  {65535, "da ff ff", "79 ff ff"},
+  {65536, "db 00 01 00 00", "7a 00 01 00 00"},
+};
+
+// Whole documents, with nested objects, lists and schema rows
+static const struct {
+  const char *input;
+  const char *msgpack, *cbor;
+} REGRESS_BINARY_DOCUMENTS[] = {
+  {
+    "a {\n b [\n  1\n  {c = x}\n ]\n}\nd = 1.5",
+    "82 a1 61 81 a1 62 92 01 81 a1 63 a1 78 a1 64 ca 3f c0 00 00",
+    "a2 61 61 a1 61 62 82 01 a1 61 63 61 78 61 64 fa 3f c0 00 00",
+  },
+  {
+    "p (n; v) [\n x; 1\n y\n]",
+    "81 a1 70 92 82 a1 6e a1 78 a1 76 01 81 a1 6e a1 79",
+    "a1 61 70 82 a2 61 6e 61 78 61 76 01 a1 61 6e 61 79",
+  },
+  {
+    "l [\n 0\n 1\n 2\n 3\n 4\n 5\n 6\n 7\n 8\n 9\n 10\n 11\n 12\n 13\n 14\n 15\n]",
+    "81 a1 6c dc 00 10 00 01 02 03 04 05 06 07 08 09 0a 0b 0c 0d 0e 0f",
+    "a1 61 6c 90 00 01 02 03 04 05 06 07 08 09 0a 0b 0c 0d 0e 0f",
+  },
+  {
+    "s = \xFF",
+    "81 a1 73 a3 ef bf bd",
+    "a1 61 73 63 ef bf bd",
+  },
+};
+
+/*
+  Writes pv in both binary formats and compares the leading bytes with the
+  expected ones, written in hex, and the length with theirs and `tail`.
+  Returns the number of formats that failed.
+*/
+static size_t RegressBinaryCheck(const char *name, struct ParserValue *pv, const char *msgpack, const char *cbor, size_t tail) {
+  static const struct {
+    const char *name;
+    enum SDF_OutputFormat format;
+  } formats[] = {
+    {"msgpack", OF_MSGPACK},
+    {"cbor", OF_CBOR},
+  };
+  size_t failed = 0;
+  for (size_t i = 0; i < 2; i++) {
+    const char *expected = i == 0 ? msgpack : cbor;
+    size_t bytes = (strlen(expected) + 1) / 3;
+    struct StringBuilder sb = CreateStringBuilder();
+    struct StringBuilder hex = CreateStringBuilder();
+    ParserValueToBinary(pv, &sb, formats[i].format);
+    for (size_t j = 0; j < bytes && j < sb.length; j++) {
+      unsigned char c = sb.string[j];
+      StringBuilderAddChar(&hex, "0123456789abcdef"[c >> 4]);
+      StringBuilderAddChar(&hex, "0123456789abcdef"[c & 0xF]);
+      if (j + 1 < bytes) {
+        StringBuilderAddChar(&hex, ' ');
+      }
+    }
+    if (sb.length != bytes + tail || strcmp(hex.string, expected) != 0) {
+      printf("FAIL %s (%s): %s, %zu bytes\n", name, formats[i].name, hex.string, sb.length);
+      failed++;
+    }
+    free(sb.string);
+    free(hex.string);
+  }
+  return failed;
+}
+
+static size_t RegressBinary(void) {
+  size_t failed = 0;
+  char name[64];
+  for (size_t i = 0; i < sizeof(REGRESS_BINARY_INTEGERS) / sizeof(REGRESS_BINARY_INTEGERS[0]); i++) {
+    struct ParserValue pv = CreateParserValueInteger(REGRESS_BINARY_INTEGERS[i].value);
+    snprintf(name, sizeof(name), "integer %" PRId64, REGRESS_BINARY_INTEGERS[i].value);
+    failed += RegressBinaryCheck(name, &pv, REGRESS_BINARY_INTEGERS[i].msgpack, REGRESS_BINARY_INTEGERS[i].cbor, 0);
+  }
+  for (size_t i = 0; i < sizeof(REGRESS_BINARY_DOUBLES) / sizeof(REGRESS_BINARY_DOUBLES[0]); i++) {
+    struct ParserValue pv = CreateParserValueDouble(REGRESS_BINARY_DOUBLES[i].value);
+    snprintf(name, sizeof(name), "double %.17g", REGRESS_BINARY_DOUBLES[i].value);
+    failed += RegressBinaryCheck(name, &pv, REGRESS_BINARY_DOUBLES[i].msgpack, REGRESS_BINARY_DOUBLES[i].cbor, 0);
+  }
+  for (size_t i = 0; i < sizeof(REGRESS_BINARY_STRINGS) / sizeof(REGRESS_BINARY_STRINGS[0]); i++) {
+    size_t length = REGRESS_BINARY_STRINGS[i].length;
+    char *s = malloc(length + 1);
+    memset(s, 'a', length);
+    s[length] = '\0';
+    struct ParserValue pv = CreateParserValueString(s);
+    snprintf(name, sizeof(name), "string of %zu bytes", length);
+    failed += RegressBinaryCheck(name, &pv, REGRESS_BINARY_STRINGS[i].msgpack, REGRESS_BINARY_STRINGS[i].cbor, length);
+    free(s);
+  }
+  for (size_t i = 0; i < sizeof(REGRESS_BINARY_DOCUMENTS) / sizeof(REGRESS_BINARY_DOCUMENTS[0]); i++) {
+    const char *input = REGRESS_BINARY_DOCUMENTS[i].input;
+    struct TokenIterator ti = CreateBufferTokenIterator((char*)input, strlen(input));
+    struct Arena a = CreateArena();
+    struct ParserValue pv = CreateParserValueObject(ParseObject(&ti, &a));
+    snprintf(name, sizeof(name), "document %zu", i);
+    failed += RegressBinaryCheck(name, &pv, REGRESS_BINARY_DOCUMENTS[i].msgpack, REGRESS_BINARY_DOCUMENTS[i].cbor, 0);
+    FreeArena(&a);
+  }
+  return failed;
+}
+
+static const char REGRESS_QUERY_INPUT[] =
+  "name = Alice\nmatrix [\n [1; 2]\n [3; 4]\n]\npeople (name; age) [\n Bob; 55\n Eve; 41\n]\n"
+  "servers [\n {host = a; port = 80}\n {host = b}\n {host = c; port = 443}\n]\no {\n p {\n  q = deep\n }\n}";
+
+// The matches of each path in REGRESS_QUERY_INPUT, separated by spaces, or NULL for paths that don't compile
+static const struct {
+  const char *path, *matches;
+} REGRESS_QUERIES[] = {
+  {"name", "\"Alice\""},
+  {"o.p.q", "\"deep\""},
+  {"o.p", "{\"q\":\"deep\"}"},
+  {"people[1].name", "\"Eve\""},
+  {"people[*].age", "55 41"},
+  {"servers[*].port", "80 443"},
+  {"servers[1].host", "\"b\""},
+  {"matrix[*][1]", "2 4"},
+  {"matrix[1][*]", "3 4"},
+  {"servers[3]", ""},
+  {"name.first", ""},
+  {"name[0]", ""},
+  {"missing", ""},
+  {"people[1]name", NULL},
+  {".name", NULL},
+  {"name.", NULL},
+  {"o..p", NULL},
+  {"people[", NULL},
+  {"people[1", NULL},
+  {"people[x]", NULL},
+  {"people[-1]", NULL},
+  {"people[]", NULL},
+};
+
+static size_t RegressQuery(void) {
+  size_t failed = 0;
+  struct TokenIterator ti = CreateBufferTokenIterator((char*)REGRESS_QUERY_INPUT, strlen(REGRESS_QUERY_INPUT));
+  struct Arena a = CreateArena();
+  struct ParserValue root = CreateParserValueObject(ParseObject(&ti, &a));
+  for (size_t i = 0; i < sizeof(REGRESS_QUERIES) / sizeof(REGRESS_QUERIES[0]); i++) {
+    const char *expected = REGRESS_QUERIES[i].matches;
+    struct SDF_Path path;
+    if (!CompileSDFPath((char*)REGRESS_QUERIES[i].path, &path)) {
+      if (expected != NULL) {
+        printf("FAIL query %s (compile): rejected\n", REGRESS_QUERIES[i].path);
+        failed++;
+      }
+      continue;
+    }
+
+    struct StringBuilder sb = CreateStringBuilder();
+    struct ParserValueList *results = NewParserValueList(&a);
+    size_t count = SDFPathQuery(&path, &root, results);
+    for (size_t j = 0; j < count; j++) {
+      if (j > 0) {
+        StringBuilderAddChar(&sb, ' ');
+      }
+      ParserValueToString(&(results->items[j]), &sb);
+    }
+    // SDFPathGet must find the first of the matches
+    struct ParserValue first;
+    int found = SDFPathGet(&path, &root, &first);
+    int same_first = found == (count > 0);
+    if (found && count > 0) {
+      struct StringBuilder first_text = CreateStringBuilder(), match_text = CreateStringBuilder();
+      ParserValueToString(&first, &first_text);
+      ParserValueToString(&(results->items[0]), &match_text);
+      same_first = strcmp(first_text.string, match_text.string) == 0;
+      free(first_text.string);
+      free(match_text.string);
+    }
+    if (expected == NULL || strcmp(sb.string, expected) != 0 || !same_first) {
+      printf("FAIL query %s (query): %s\n", REGRESS_QUERIES[i].path, sb.string);
+      failed++;
+    }
+    free(sb.string);
+    FreeSDFPath(&path);
+  }
+  FreeArena(&a);
+  return failed;
+}
+
+// Returns 1 if the case failed
+static int RegressCheck(const struct RegressCase *c, const char *name, void (*convert)(const char *input, struct StringBuilder *sb)) {
+  struct StringBuilder sb = CreateStringBuilder();
+  int ok = RegressTrap(convert, c->input, &sb);
+  int failed = ok != (c->json != NULL) || (ok && strcmp(sb.string, c->json) != 0);
+  if (failed) {
+    printf("FAIL %s (%s): %s", c->name, name, ok ? sb.string : "rejected\n");
+  }
+  free(sb.string);
+  return failed;
+}
+
+int main(void) {
+  size_t cases = sizeof(REGRESS_CASES) / sizeof(REGRESS_CASES[0]);
+  size_t converters = sizeof(REGRESS_CONVERTERS) / sizeof(REGRESS_CONVERTERS[0]);
+  size_t add_key_cases = sizeof(REGRESS_ADD_KEY_CASES) / sizeof(REGRESS_ADD_KEY_CASES[0]);
+  size_t failed = 0;
+  for (size_t i = 0; i < cases; i++) {
+    for (size_t j = 0; j < converters; j++) {
+      failed += RegressCheck(&(REGRESS_CASES[i]), REGRESS_CONVERTERS[j].name, REGRESS_CONVERTERS[j].convert);
+    }
+  }
+  for (size_t i = 0; i < add_key_cases; i++) {
+    failed += RegressCheck(&(REGRESS_ADD_KEY_CASES[i]), "add key", RegressAddKey);
+  }
+  size_t damages = sizeof(REGRESS_IMAGE_DAMAGE) / sizeof(REGRESS_IMAGE_DAMAGE[0]);
+  for (regress_damage = 0; regress_damage < damages; regress_damage++) {
+    struct RegressCase c = {
+      .name = REGRESS_IMAGE_DAMAGE[regress_damage].name,
+      .input = REGRESS_IMAGE_INPUT,
+      .json = REGRESS_IMAGE_DAMAGE[regress_damage].json,
+    };
+    failed += RegressCheck(&c, "damaged image", RegressDamagedImage);
+  }
+  failed += RegressFormat();
+  size_t numbers = sizeof(REGRESS_INTEGERS) / sizeof(REGRESS_INTEGERS[0]) + sizeof(REGRESS_DOUBLES) / sizeof(REGRESS_DOUBLES[0]);
+  failed += RegressJSONString();
+  size_t strings = sizeof(REGRESS_STRINGS) / sizeof(REGRESS_STRINGS[0]);
+  failed += RegressBinary();
+  size_t binaries = 2 * (sizeof(REGRESS_BINARY_INTEGERS) / sizeof(REGRESS_BINARY_INTEGERS[0]) + sizeof(REGRESS_BINARY_DOUBLES) / sizeof(REGRESS_BINARY_DOUBLES[0])
+    + sizeof(REGRESS_BINARY_STRINGS) / sizeof(REGRESS_BINARY_STRINGS[0]) + sizeof(REGRESS_BINARY_DOCUMENTS) / sizeof(REGRESS_BINARY_DOCUMENTS[0]));
+  failed += RegressQuery();
+  size_t queries = sizeof(REGRESS_QUERIES) / sizeof(REGRESS_QUERIES[0]);
+  failed += RegressPushChunks();
+  size_t chunks = sizeof(REGRESS_PUSH_CHUNKS) / sizeof(REGRESS_PUSH_CHUNKS[0]);
+  printf("%zu of %zu checks failed\n", failed, cases * converters + add_key_cases + damages + numbers + strings + binaries + queries + chunks);
+  return failed > 0 ? 1 : 0;
+}